@@ -0,0 +1,372 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+static const int BINS = 16;
+static const uint32_t MAX_LEAF_SIZE = 8; // split even when SAH prefers a leaf above this
+
+static inline float halfArea(const float* min, const float* max) {
+	float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+	return dx * dy + dy * dz + dz * dx;
+}
+
+static inline void setEmpty(float* min, float* max) {
+	min[0] = min[1] = min[2] = FLT_MAX;
+	max[0] = max[1] = max[2] = -FLT_MAX;
+}
+
+static inline void grow(float* min, float* max, const AABB& box) {
+	min[0] = std::min(min[0], box.min.x); max[0] = std::max(max[0], box.max.x);
+	min[1] = std::min(min[1], box.min.y); max[1] = std::max(max[1], box.max.y);
+	min[2] = std::min(min[2], box.min.z); max[2] = std::max(max[2], box.max.z);
+}
+
+static inline void grow(float* min, float* max, const float* otherMin, const float* otherMax) {
+	for (int a = 0; a < 3; ++a) {
+		min[a] = std::min(min[a], otherMin[a]);
+		max[a] = std::max(max[a], otherMax[a]);
+	}
+}
+
+void BVH::updateNodeBounds(BVHNode& node) const {
+	setEmpty(node.min, node.max);
+	for (uint32_t i = 0; i < node.count; ++i)
+		grow(node.min, node.max, _bounds[_indices[node.leftFirst + i]]);
+}
+
+void BVH::build(const std::vector<AABB>& bounds) {
+	_bounds = bounds;
+	_nodes.clear();
+	_stats = Stats();
+
+	const uint32_t count = (uint32_t)bounds.size();
+	_refs.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		BuildRef& ref = _refs[i];
+		ref.min[0] = bounds[i].min.x; ref.min[1] = bounds[i].min.y; ref.min[2] = bounds[i].min.z;
+		ref.max[0] = bounds[i].max.x; ref.max[1] = bounds[i].max.y; ref.max[2] = bounds[i].max.z;
+		for (int a = 0; a < 3; ++a)
+			ref.c[a] = (ref.min[a] + ref.max[a]) * 0.5f;
+		ref.index = i;
+	}
+	_indices.resize(count);
+	if (count == 0)
+		return;
+
+	_nodes.reserve(2 * (size_t)count - 1); // upper bound, split() never reallocates
+	_nodes.resize(1);
+	_nodes[0].leftFirst = 0;
+	_nodes[0].count = count;
+	setEmpty(_nodes[0].min, _nodes[0].max);
+	for (const BuildRef& ref : _refs)
+		grow(_nodes[0].min, _nodes[0].max, ref.min, ref.max);
+
+	/* depth first with an explicit stack, children are appended in pairs */
+	struct Entry { uint32_t node; unsigned int depth; };
+	std::vector<Entry> stack;
+	stack.push_back({ 0, 1 });
+	while (!stack.empty()) {
+		Entry e = stack.back();
+		stack.pop_back();
+		if (e.depth < MAX_DEPTH && split(e.node)) {
+			uint32_t left = _nodes[e.node].leftFirst;
+			stack.push_back({ left + 1, e.depth + 1 });
+			stack.push_back({ left, e.depth + 1 });
+		}
+		else {
+			_stats.leaves++;
+			_stats.maxDepth = std::max(_stats.maxDepth, e.depth);
+		}
+	}
+	_stats.nodes = (unsigned int)_nodes.size();
+
+	for (uint32_t i = 0; i < count; ++i)
+		_indices[i] = _refs[i].index;
+	std::vector<BuildRef>().swap(_refs);
+}
+
+/* Binned SAH : centroids go into BINS buckets per axis, the best of the BINS - 1
+planes between buckets is taken. Returns false when the node stays a leaf. */
+bool BVH::split(uint32_t nodeIndex) {
+	const uint32_t first = _nodes[nodeIndex].leftFirst;
+	const uint32_t count = _nodes[nodeIndex].count;
+	if (count <= 2)
+		return false;
+
+	float cmin[3], cmax[3];
+	setEmpty(cmin, cmax);
+	for (uint32_t i = 0; i < count; ++i) {
+		const BuildRef& ref = _refs[first + i];
+		for (int a = 0; a < 3; ++a) {
+			cmin[a] = std::min(cmin[a], ref.c[a]);
+			cmax[a] = std::max(cmax[a], ref.c[a]);
+		}
+	}
+
+	float scale[3];
+	for (int a = 0; a < 3; ++a)
+		scale[a] = cmax[a] > cmin[a] ? BINS / (cmax[a] - cmin[a]) : 0.0f;
+
+	struct Bin {
+		float min[3], max[3];
+		uint32_t count;
+	};
+	Bin bins[3][BINS];
+	for (int a = 0; a < 3; ++a)
+		for (int b = 0; b < BINS; ++b) {
+			setEmpty(bins[a][b].min, bins[a][b].max);
+			bins[a][b].count = 0;
+		}
+
+	/* one pass over the objects fills the bins of all 3 axes */
+	for (uint32_t i = 0; i < count; ++i) {
+		const BuildRef& ref = _refs[first + i];
+		for (int a = 0; a < 3; ++a) {
+			if (scale[a] == 0.0f)
+				continue;
+			int b = std::min(BINS - 1, (int)((ref.c[a] - cmin[a]) * scale[a]));
+			grow(bins[a][b].min, bins[a][b].max, ref.min, ref.max);
+			bins[a][b].count++;
+		}
+	}
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1, bestSplit = 0;
+	for (int a = 0; a < 3; ++a) {
+		if (scale[a] == 0.0f)
+			continue;
+
+		/* sweep from the left storing prefix areas, then from the right evaluating each plane */
+		float leftArea[BINS - 1];
+		uint32_t leftCount[BINS - 1];
+		float min[3], max[3];
+		setEmpty(min, max);
+		uint32_t sum = 0;
+		for (int b = 0; b < BINS - 1; ++b) {
+			sum += bins[a][b].count;
+			if (bins[a][b].count)
+				grow(min, max, bins[a][b].min, bins[a][b].max);
+			leftCount[b] = sum;
+			leftArea[b] = sum ? halfArea(min, max) : 0.0f;
+		}
+
+		setEmpty(min, max);
+		sum = 0;
+		for (int b = BINS - 1; b > 0; --b) {
+			sum += bins[a][b].count;
+			if (bins[a][b].count)
+				grow(min, max, bins[a][b].min, bins[a][b].max);
+			if (!sum || !leftCount[b - 1])
+				continue;
+			float cost = leftCount[b - 1] * leftArea[b - 1] + sum * halfArea(min, max);
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = a;
+				bestSplit = b;
+			}
+		}
+	}
+
+	if (bestAxis < 0)
+		return false; // all centroids in one bin
+	float leafCost = count * halfArea(_nodes[nodeIndex].min, _nodes[nodeIndex].max);
+	if (bestCost >= leafCost && count <= MAX_LEAF_SIZE)
+		return false;
+
+	/* partition the range in place, same bin formula as above */
+	const float axisMin = cmin[bestAxis], axisScale = scale[bestAxis];
+	uint32_t i = first, end = first + count;
+	while (i < end) {
+		int b = std::min(BINS - 1, (int)((_refs[i].c[bestAxis] - axisMin) * axisScale));
+		if (b < bestSplit)
+			i++;
+		else
+			std::swap(_refs[i], _refs[--end]);
+	}
+	uint32_t leftCountTotal = i - first;
+	if (leftCountTotal == 0 || leftCountTotal == count)
+		return false;
+
+	uint32_t left = (uint32_t)_nodes.size();
+	_nodes.resize(_nodes.size() + 2);
+	_nodes[left].leftFirst = first;
+	_nodes[left].count = leftCountTotal;
+	_nodes[left + 1].leftFirst = first + leftCountTotal;
+	_nodes[left + 1].count = count - leftCountTotal;
+	/* the partition used the bin formula, so the child bounds are the union of their bins */
+	setEmpty(_nodes[left].min, _nodes[left].max);
+	setEmpty(_nodes[left + 1].min, _nodes[left + 1].max);
+	for (int bin = 0; bin < BINS; ++bin) {
+		const Bin& b = bins[bestAxis][bin];
+		BVHNode& child = _nodes[bin < bestSplit ? left : left + 1];
+		if (b.count)
+			grow(child.min, child.max, b.min, b.max);
+	}
+
+	_nodes[nodeIndex].leftFirst = left;
+	_nodes[nodeIndex].count = 0;
+	return true;
+}
+
+void BVH::refit() {
+	/* children always come after their parent, so a reverse walk is bottom-up */
+	for (size_t i = _nodes.size(); i-- > 0;) {
+		BVHNode& node = _nodes[i];
+		if (node.count) {
+			updateNodeBounds(node);
+			continue;
+		}
+		const BVHNode& left = _nodes[node.leftFirst];
+		const BVHNode& right = _nodes[node.leftFirst + 1];
+		for (int a = 0; a < 3; ++a) {
+			node.min[a] = std::min(left.min[a], right.min[a]);
+			node.max[a] = std::max(left.max[a], right.max[a]);
+		}
+	}
+}
+
+/* Box against the planes still set in mask. Returns false when fully outside one of them,
+clears the bits of the planes the box is fully inside of. */
+static inline bool testBox(const Frustum& frustum, const float* min, const float* max, uint32_t& mask) {
+	float c[3], h[3];
+	for (int a = 0; a < 3; ++a) {
+		c[a] = (min[a] + max[a]) * 0.5f;
+		h[a] = (max[a] - min[a]) * 0.5f;
+	}
+	for (int p = 0; p < 6; ++p) {
+		if (!(mask & (1u << p)))
+			continue;
+		const glm::vec4& plane = frustum.planes[p];
+		float d = plane.x * c[0] + plane.y * c[1] + plane.z * c[2] + plane.w;
+		float r = fabsf(plane.x) * h[0] + fabsf(plane.y) * h[1] + fabsf(plane.z) * h[2];
+		if (d < -r)
+			return false;
+		if (d >= r)
+			mask &= ~(1u << p);
+	}
+	return true;
+}
+
+CullStats BVH::cullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const {
+	visible.clear();
+	CullStats stats;
+	if (_nodes.empty())
+		return stats;
+
+	struct Entry { uint32_t node; uint32_t planeMask; };
+	Entry stack[MAX_DEPTH + 1];
+	int top = 0;
+	stack[top++] = { 0, 0x3F };
+	while (top) {
+		Entry e = stack[--top];
+		const BVHNode& node = _nodes[e.node];
+		uint32_t mask = e.planeMask;
+		if (mask && !testBox(frustum, node.min, node.max, mask))
+			continue;
+
+		if (node.count) {
+			for (uint32_t i = 0; i < node.count; ++i) {
+				uint32_t index = _indices[node.leftFirst + i];
+				uint32_t objectMask = mask;
+				if (objectMask) {
+					const AABB& box = _bounds[index];
+					float min[3] = { box.min.x, box.min.y, box.min.z };
+					float max[3] = { box.max.x, box.max.y, box.max.z };
+					if (!testBox(frustum, min, max, objectMask))
+						continue;
+				}
+				visible.push_back(index);
+			}
+		}
+		else {
+			/* mask 0 : fully inside, the subtree is walked without plane tests */
+			stack[top++] = { node.leftFirst + 1, mask };
+			stack[top++] = { node.leftFirst, mask };
+		}
+	}
+
+	stats.visible = (unsigned int)visible.size();
+	stats.culled = (unsigned int)(_bounds.size() - visible.size());
+	return stats;
+}
+
+/* Slab test, tEnter is clamped to 0 for rays starting inside the box */
+static inline bool intersectBox(const float* min, const float* max, const float* origin, const float* invDir,
+	float maxDistance, float& tEnter) {
+	float tmin = 0.0f, tmax = maxDistance;
+	for (int a = 0; a < 3; ++a) {
+		float t0 = (min[a] - origin[a]) * invDir[a];
+		float t1 = (max[a] - origin[a]) * invDir[a];
+		tmin = std::max(tmin, std::min(t0, t1));
+		tmax = std::min(tmax, std::max(t0, t1));
+	}
+	tEnter = tmin;
+	return tmin <= tmax;
+}
+
+bool BVH::raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDistance, RayHit& hit) const {
+	hit = RayHit();
+	if (_nodes.empty())
+		return false;
+
+	const float o[3] = { origin.x, origin.y, origin.z };
+	const float invDir[3] = { 1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z }; // +-inf for axis parallel rays
+	float best = maxDistance;
+
+	struct Entry { uint32_t node; float t; };
+	Entry stack[MAX_DEPTH + 1];
+	int top = 0;
+	float t;
+	if (!intersectBox(_nodes[0].min, _nodes[0].max, o, invDir, best, t))
+		return false;
+	stack[top++] = { 0, t };
+
+	while (top) {
+		Entry e = stack[--top];
+		if (e.t > best)
+			continue; // a closer hit was found since this node was pushed
+		const BVHNode& node = _nodes[e.node];
+
+		if (node.count) {
+			for (uint32_t i = 0; i < node.count; ++i) {
+				uint32_t index = _indices[node.leftFirst + i];
+				const AABB& box = _bounds[index];
+				float min[3] = { box.min.x, box.min.y, box.min.z };
+				float max[3] = { box.max.x, box.max.y, box.max.z };
+				if (intersectBox(min, max, o, invDir, best, t) && (hit.index == UINT32_MAX || t < best)) {
+					best = t;
+					hit.index = index;
+				}
+			}
+			continue;
+		}
+
+		/* near child on top of the stack so it is visited first */
+		const BVHNode& left = _nodes[node.leftFirst];
+		const BVHNode& right = _nodes[node.leftFirst + 1];
+		float tLeft, tRight;
+		bool hitLeft = intersectBox(left.min, left.max, o, invDir, best, tLeft);
+		bool hitRight = intersectBox(right.min, right.max, o, invDir, best, tRight);
+		if (hitLeft && hitRight) {
+			if (tLeft <= tRight) {
+				stack[top++] = { node.leftFirst + 1, tRight };
+				stack[top++] = { node.leftFirst, tLeft };
+			}
+			else {
+				stack[top++] = { node.leftFirst, tLeft };
+				stack[top++] = { node.leftFirst + 1, tRight };
+			}
+		}
+		else if (hitLeft)
+			stack[top++] = { node.leftFirst, tLeft };
+		else if (hitRight)
+			stack[top++] = { node.leftFirst + 1, tRight };
+	}
+
+	if (hit.index == UINT32_MAX)
+		return false;
+	hit.distance = best;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "Frustum.h"
+
+struct AABB {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+/* 32 bytes, two nodes per cache line. Children of an inner node are stored
+next to each other at leftFirst & leftFirst + 1, always after their parent. */
+struct BVHNode {
+	float min[3];
+	uint32_t leftFirst; // inner : index of the left child, leaf : first entry in the index array
+	float max[3];
+	uint32_t count; // 0 for inner nodes, number of objects for leaves
+};
+
+struct RayHit {
+	uint32_t index = UINT32_MAX; // object index as passed to build(), UINT32_MAX = no hit
+	float distance = 0.0f;
+};
+
+/* Bounding volume hierarchy over object AABBs.
+build() splits with a binned surface area heuristic, refit() only recomputes the
+bounds bottom-up so it is cheap enough to run every frame for moving objects,
+but the tree quality degrades if they move far : rebuild now and then. */
+class BVH
+{
+public:
+	struct Stats {
+		unsigned int nodes = 0;
+		unsigned int leaves = 0;
+		unsigned int maxDepth = 0;
+	};
+
+	void build(const std::vector<AABB>& bounds);
+	/* Moving objects : update bounds() in place, then refit() */
+	std::vector<AABB>& bounds() { return _bounds; }
+	void refit();
+
+	/* Appends the indices of the objects whose bounds touch the frustum to visible (cleared first).
+	Subtrees fully inside skip the plane tests. */
+	CullStats cullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	/* Nearest object whose bounds the ray hits within maxDistance. dir need not be normalized,
+	distance is then in units of dir. */
+	bool raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDistance, RayHit& hit) const;
+
+	const Stats& stats() const { return _stats; }
+	size_t size() const { return _bounds.size(); }
+
+private:
+	static const unsigned int MAX_DEPTH = 64; // deeper nodes become leaves, bounds the traversal stacks
+
+	/* build works on these, partitioned in place so every pass reads them sequentially */
+	struct BuildRef {
+		float min[3], max[3], c[3];
+		uint32_t index;
+	};
+
+	std::vector<BVHNode> _nodes;
+	std::vector<uint32_t> _indices; // leaves reference contiguous ranges of this
+	std::vector<AABB> _bounds;
+	std::vector<BuildRef> _refs; // build only
+	Stats _stats;
+
+	void updateNodeBounds(BVHNode& node) const;
+	bool split(uint32_t nodeIndex);
+};
+
+#endif
\ No newline at end of file
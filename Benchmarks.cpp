@@ -0,0 +1,1024 @@
+#include "Benchmarks.h"
+#include "BVH.h"
+#include "Frustum.h"
+#include "Camera.h"
+#include "Profiler.h"
+#include "BlockCompression.h"
+#include "TextureLoader.h"
+#include "RenderQueue.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <chrono>
+#include <filesystem>
+#include <cmath>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point begin) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+int runBVHBenchmark(unsigned int objectCount) {
+	const float worldSize = 1000.0f;
+	const int frustumQueries = 64;
+	const int rayQueries = 100000;
+
+	std::mt19937 rng(1234); // fixed seed, runs are comparable
+	std::uniform_real_distribution<float> position(-worldSize * 0.5f, worldSize * 0.5f);
+	std::uniform_real_distribution<float> halfSize(0.25f, 1.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	std::vector<glm::vec3> centers(objectCount);
+	std::vector<AABB> bounds(objectCount);
+	BoundsSoA spheres;
+	spheres.resize(objectCount);
+	for (unsigned int i = 0; i < objectCount; ++i) {
+		float h = halfSize(rng);
+		centers[i] = glm::vec3(position(rng), position(rng), position(rng));
+		bounds[i].min = centers[i] - glm::vec3(h);
+		bounds[i].max = centers[i] + glm::vec3(h);
+		spheres.set(i, centers[i], h * 1.7320508f);
+	}
+	std::cout << "BVH benchmark : " << objectCount << " objects" << std::endl;
+
+	BVH bvh;
+	Clock::time_point begin = Clock::now();
+	bvh.build(bounds);
+	double buildMs = msSince(begin);
+	std::cout << "  build   : " << buildMs << " ms (" << bvh.stats().nodes << " nodes, "
+		<< bvh.stats().leaves << " leaves, depth " << bvh.stats().maxDepth << ")" << std::endl;
+
+	/* every object moves a little, topology is kept */
+	for (unsigned int i = 0; i < objectCount; ++i) {
+		glm::vec3 offset(unit(rng), unit(rng), unit(rng));
+		bvh.bounds()[i].min += offset;
+		bvh.bounds()[i].max += offset;
+	}
+	begin = Clock::now();
+	bvh.refit();
+	std::cout << "  refit   : " << msSince(begin) << " ms" << std::endl;
+
+	/* cameras at random spots looking in random directions, compared with the flat SIMD pass */
+	Camera camera;
+	camera.zFar = worldSize * 0.25f;
+	std::vector<Frustum> frustums(frustumQueries);
+	for (Frustum& frustum : frustums) {
+		camera.Pos = glm::vec3(position(rng), position(rng), position(rng));
+		camera.Front = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)));
+		frustum = Frustum::fromCamera(camera);
+	}
+
+	std::vector<uint32_t> visible;
+	visible.reserve(objectCount);
+	unsigned long long visibleSum = 0;
+	begin = Clock::now();
+	for (const Frustum& frustum : frustums)
+		visibleSum += bvh.cullFrustum(frustum, visible).visible;
+	double bvhCullMs = msSince(begin) / frustumQueries;
+
+	begin = Clock::now();
+	for (const Frustum& frustum : frustums)
+		cullSpheres(frustum, spheres, visible);
+	double flatCullMs = msSince(begin) / frustumQueries;
+	std::cout << "  frustum : " << bvhCullMs << " ms per query (flat SIMD spheres " << flatCullMs << " ms), "
+		<< visibleSum / frustumQueries << " visible on average" << std::endl;
+
+	std::vector<glm::vec3> origins(rayQueries), dirs(rayQueries);
+	for (int i = 0; i < rayQueries; ++i) {
+		origins[i] = glm::vec3(position(rng), position(rng), position(rng));
+		dirs[i] = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)));
+	}
+	unsigned int hits = 0;
+	RayHit hit;
+	begin = Clock::now();
+	for (int i = 0; i < rayQueries; ++i)
+		hits += bvh.raycast(origins[i], dirs[i], worldSize, hit);
+	double rayMs = msSince(begin);
+	std::cout << "  rays    : " << rayMs * 1000.0 / rayQueries << " us per ray, "
+		<< hits << " / " << rayQueries << " hit" << std::endl;
+
+	return 0;
+}
+
+int runProfilerBenchmark(unsigned int zoneCount) {
+#if PROFILER_ENABLED
+	Profiler::setThreadName("Main");
+	{
+		PROFILE_ZONE("Warmup"); // registers the thread buffer outside the timed loop
+	}
+
+	/* the loop itself is timed too and subtracted, so only the zone is left */
+	volatile unsigned int sink = 0;
+	Clock::time_point begin = Clock::now();
+	for (unsigned int i = 0; i < zoneCount; ++i)
+		sink = sink + 1;
+	double loopMs = msSince(begin);
+
+	begin = Clock::now();
+	for (unsigned int i = 0; i < zoneCount; ++i) {
+		PROFILE_ZONE("Bench");
+		sink = sink + 1;
+	}
+	double zoneMs = msSince(begin);
+
+	std::cout << "Profiler benchmark : " << zoneCount << " zones, "
+		<< (zoneMs - loopMs) * 1.0e6 / zoneCount << " ns per zone" << std::endl;
+	Profiler::endFrame();
+	return 0;
+#else
+	std::cout << "Profiler benchmark : built with PROFILER_ENABLED=0, zones compile to nothing" << std::endl;
+	return 0;
+#endif
+}
+
+int runRenderQueueBenchmark(unsigned int itemCount) {
+	const int runs = 50;
+
+	std::mt19937_64 rng(1234); // fixed seed, runs are comparable
+	std::uniform_real_distribution<float> depth(0.0f, 100.0f);
+	std::uniform_int_distribution<unsigned int> material(0, 63);
+	std::vector<uint64_t> sceneKeys(itemCount), randomKeys(itemCount);
+	for (unsigned int i = 0; i < itemCount; ++i) {
+		/* a frame of main.cpp : a few programs & VAOs, one texture pair per material */
+		unsigned int pass = i % 8 == 0 ? RenderQueue::PASS_UNLIT : RenderQueue::PASS_OPAQUE;
+		sceneKeys[i] = RenderQueue::makeKey(pass, 3 + pass, 1 + pass, material(rng), depth(rng), 100.0f);
+		randomKeys[i] = rng();
+	}
+	std::cout << "Render queue benchmark : " << itemCount << " items, " << runs << " sorts" << std::endl;
+
+	const std::vector<uint64_t>* keySets[] = { &sceneKeys, &randomKeys };
+	const char* names[] = { "scene ", "random" };
+	RenderQueue queue;
+	std::vector<uint32_t> expected(itemCount);
+	for (int set = 0; set < 2; ++set) {
+		const std::vector<uint64_t>& keys = *keySets[set];
+		double totalMs = 0.0, bestMs = 1.0e9;
+		for (int run = 0; run < runs; ++run) {
+			queue.clear();
+			for (uint64_t key : keys)
+				queue.push(key);
+			queue.sort();
+			totalMs += queue.stats().sortMs;
+			bestMs = std::min(bestMs, queue.stats().sortMs);
+		}
+
+		for (unsigned int i = 0; i < itemCount; ++i)
+			expected[i] = i;
+		std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+		if (queue.order() != expected) {
+			std::cout << "ERROR::RENDER_QUEUE::WRONG_ORDER " << names[set] << " keys" << std::endl;
+			return 1;
+		}
+		std::cout << "  " << names[set] << " : " << totalMs / runs << " ms per sort (best " << bestMs << " ms)" << std::endl;
+	}
+	return 0;
+}
+
+int runCompressionBenchmark(const std::string& imagePath) {
+	int width, height, channels;
+	unsigned char* rgba = stbi_load(imagePath.c_str(), &width, &height, &channels, 4);
+	if (!rgba) {
+		std::cout << "Failed to load texture : " << imagePath << std::endl;
+		return 1;
+	}
+	const unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::cout << "Compression benchmark : " << imagePath << " " << width << "x" << height << ", "
+		<< threads << " threads, whole mip chain" << std::endl;
+
+	static const char* qualities[] = { "fast", "normal", "high" };
+	const double megapixels = width * height * (4.0 / 3.0) / 1.0e6; // with the mipmaps
+	for (BlockFormat format : { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC7 }) {
+		for (int quality = 0; quality < 3; ++quality) {
+			Clock::time_point begin = Clock::now();
+			CompressedImage image = compressMipmaps(rgba, width, height, format, (CompressionQuality)quality, threads);
+			double ms = msSince(begin);
+			std::cout << "  " << blockFormatName(format) << " " << qualities[quality] << " : " << ms << " ms ("
+				<< megapixels / (ms / 1000.0) << " Mpixel/s), " << image.data.size() / 1024 << " KiB, PSNR "
+				<< image.psnr << " dB" << std::endl;
+		}
+	}
+	stbi_image_free(rgba);
+	return 0;
+}
+
+int runTextureCacheBenchmark(const std::string& imagePath) {
+	const int hitRuns = 20;
+	const unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	/* a directory of its own, emptied around the run : the first store is always a miss */
+	std::error_code ec;
+	const std::string directory = TextureCache::directory;
+	TextureCache::directory = directory + "/bench";
+	std::filesystem::remove_all(TextureCache::directory, ec);
+	std::cout << "Texture cache benchmark : " << imagePath << ", " << threads << " encoder threads" << std::endl;
+
+	int result = 0;
+	for (BlockFormat format : { BlockFormat::None, BlockFormat::BC1, BlockFormat::BC7 }) {
+		TextureCache::enabled = false;
+		Clock::time_point begin = Clock::now();
+		TextureLoader::Image cold = TextureLoader::decode(imagePath, true, format, CompressionQuality::Normal, threads);
+		double coldMs = msSince(begin);
+		if (!cold.decoded) {
+			std::cout << "Failed to load texture : " << imagePath << std::endl;
+			result = 1;
+			break;
+		}
+		stbi_image_free(cold.pixels);
+
+		TextureCache::enabled = true;
+		begin = Clock::now();
+		TextureLoader::Image stored = TextureLoader::decode(imagePath, true, format, CompressionQuality::Normal, threads);
+		double storeMs = msSince(begin);
+		stbi_image_free(stored.pixels);
+
+		begin = Clock::now();
+		size_t bytes = 0;
+		for (int i = 0; i < hitRuns; ++i) {
+			TextureLoader::Image hit = TextureLoader::decode(imagePath, true, format, CompressionQuality::Normal, threads);
+			bytes = hit.payload.size;
+			if (!hit.cached.isOpen())
+				result = 1;
+		}
+		double hitMs = msSince(begin) / hitRuns;
+		std::cout << "  " << blockFormatName(format) << " : cold " << coldMs << " ms, miss + store " << storeMs
+			<< " ms, hit " << hitMs << " ms (" << coldMs / hitMs << "x), " << bytes / 1024 << " KiB mapped" << std::endl;
+	}
+	if (result != 0)
+		std::cout << "ERROR::TEXTURE_CACHE::BENCHMARK_MISSED" << std::endl;
+
+	std::filesystem::remove_all(TextureCache::directory, ec);
+	TextureCache::directory = directory;
+	return result;
+}
+
+int runImageLoadBenchmark(const std::string& path) {
+	const double minimumMs = 200.0; // per file and loader, small files are decoded many times
+
+	std::vector<std::string> files;
+	std::error_code ec;
+	if (std::filesystem::is_directory(path, ec)) {
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(path, ec)) {
+			if (entry.is_regular_file(ec))
+				files.push_back(entry.path().generic_string());
+		}
+		std::sort(files.begin(), files.end());
+	}
+	else
+		files.push_back(path);
+	std::cout << "Image load benchmark : stbi_load against stbi_load_mmap, " << files.size() << " files" << std::endl;
+
+	typedef stbi_uc* (*LoadFunction)(const char*, int*, int*, int*, int);
+	int result = 0;
+	for (const std::string& file : files) {
+		double megabytes = std::filesystem::file_size(file, ec) / (1024.0 * 1024.0);
+		double ms[2] = {};
+		std::vector<stbi_uc> decoded[2];
+		int width = 0, height = 0;
+		const LoadFunction loaders[2] = { stbi_load, stbi_load_mmap };
+		for (int l = 0; l < 2; ++l) {
+			int runs = 0, channels;
+			Clock::time_point begin = Clock::now();
+			do {
+				stbi_uc* pixels = loaders[l](file.c_str(), &width, &height, &channels, 0);
+				if (!pixels)
+					break;
+				if (runs++ == 0)
+					decoded[l].assign(pixels, pixels + (size_t)width * height * channels);
+				stbi_image_free(pixels);
+			} while (msSince(begin) < minimumMs);
+			ms[l] = runs > 0 ? msSince(begin) / runs : 0.0;
+		}
+		if (decoded[0].empty()) {
+			std::cout << "  " << file << " : " << stbi_failure_reason() << std::endl;
+			continue;
+		}
+		if (decoded[0] != decoded[1]) {
+			std::cout << "ERROR::BENCHMARK::IMAGE_MISMATCH " << file << std::endl;
+			result = 1;
+		}
+		std::cout << "  " << file << " (" << width << "x" << height << ", " << megabytes << " MiB) : stdio "
+			<< ms[0] << " ms, " << megabytes * 1000.0 / ms[0] << " MiB/s | mmap " << ms[1] << " ms, "
+			<< megabytes * 1000.0 / ms[1] << " MiB/s (" << ms[0] / ms[1] << "x)" << std::endl;
+	}
+	return result;
+}
+
+namespace {
+	/* Counts the calls and tags every block with its owner : a block freed through another
+	thread's allocator, or one the decoder got from elsewhere, shows up as foreign */
+	struct StressAllocator {
+		size_t allocations = 0, frees = 0, foreign = 0;
+
+		static const size_t HEADER = 16; // keeps the blocks 16-byte aligned
+
+		static void* allocate(void* user, size_t size) {
+			StressAllocator* self = (StressAllocator*)user;
+			unsigned char* block = (unsigned char*)malloc(size + HEADER);
+			if (!block)
+				return nullptr;
+			memcpy(block, &self, sizeof(self));
+			self->allocations++;
+			return block + HEADER;
+		}
+		static void release(void* user, void* p) {
+			StressAllocator* self = (StressAllocator*)user;
+			unsigned char* block = (unsigned char*)p - HEADER;
+			StressAllocator* owner;
+			memcpy(&owner, block, sizeof(owner));
+			if (owner != self) {
+				self->foreign++;
+				return; // leaked rather than freed twice
+			}
+			self->frees++;
+			free(block);
+		}
+		static void* reallocate(void* user, void* p, size_t oldSize, size_t newSize) {
+			void* moved = allocate(user, newSize);
+			if (moved && p) {
+				memcpy(moved, p, std::min(oldSize, newSize));
+				release(user, p);
+			}
+			return moved;
+		}
+	};
+
+	struct StressCase {
+		bool flip;
+		int channels; // 0 : as in the file
+		float gamma; // 0 : 8-bit load, else stbi_decoder_loadf_from_memory with this gamma
+	};
+
+	std::vector<unsigned char> decodeForStress(stbi_decoder& decoder, const std::vector<unsigned char>& file, const StressCase& test) {
+		int width, height, channels;
+		std::vector<unsigned char> pixels;
+		if (test.gamma > 0.0f) {
+			float* result = stbi_decoder_loadf_from_memory(&decoder, file.data(), (int)file.size(), &width, &height, &channels, test.channels);
+			if (result)
+				pixels.assign((unsigned char*)result, (unsigned char*)(result + (size_t)width * height * (test.channels ? test.channels : channels)));
+			stbi_decoder_image_free(&decoder, result);
+		}
+		else {
+			stbi_uc* result = stbi_decoder_load_from_memory(&decoder, file.data(), (int)file.size(), &width, &height, &channels, test.channels);
+			if (result)
+				pixels.assign(result, result + (size_t)width * height * (test.channels ? test.channels : channels));
+			stbi_decoder_image_free(&decoder, result);
+		}
+		return pixels;
+	}
+}
+
+int runStbiStressTest(unsigned int rounds) {
+	const unsigned int threadCount = std::max(8u, std::thread::hardware_concurrency());
+
+	std::vector<std::string> names;
+	std::vector<std::vector<unsigned char>> files;
+	std::error_code ec;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator("./images", ec)) {
+		std::ifstream in(entry.path(), std::ios::binary);
+		std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		if (!bytes.empty()) {
+			names.push_back(entry.path().generic_string());
+			files.push_back(std::move(bytes));
+		}
+	}
+	size_t png = std::find_if(names.begin(), names.end(), [](const std::string& name) {
+		return std::filesystem::path(name).extension() == ".png"; }) - names.begin();
+	if (png == names.size()) {
+		std::cout << "ERROR::STBI_STRESS::NO_IMAGES no png in ./images" << std::endl;
+		return 1;
+	}
+
+	/* one setting per thread, the expected pixels decoded up front on this thread alone */
+	std::vector<StressCase> cases(threadCount);
+	std::vector<std::vector<std::vector<unsigned char>>> expected(threadCount);
+	for (unsigned int t = 0; t < threadCount; ++t) {
+		cases[t] = { (t & 1) != 0, (int)(t / 2 % 5), t % 3 == 2 ? 1.0f + 0.25f * t : 0.0f };
+		for (const std::vector<unsigned char>& file : files) {
+			stbi_decoder decoder;
+			stbi_decoder_init(&decoder);
+			decoder.flip_vertically = cases[t].flip;
+			if (cases[t].gamma > 0.0f)
+				decoder.ldr_to_hdr_gamma = cases[t].gamma;
+			expected[t].push_back(decodeForStress(decoder, file, cases[t]));
+		}
+	}
+
+	std::cout << "stb_image stress : " << threadCount << " threads x " << rounds << " rounds over " << files.size()
+		<< " images, plus one thread on the process-wide API" << std::endl;
+	std::vector<std::string> errors(threadCount);
+	std::vector<StressAllocator> allocators(threadCount);
+	std::atomic<bool> running{ true };
+	std::vector<std::thread> threads;
+	Clock::time_point begin = Clock::now();
+	for (unsigned int t = 0; t < threadCount; ++t) {
+		threads.emplace_back([&, t]() {
+			stbi_decoder decoder;
+			stbi_decoder_init(&decoder);
+			decoder.flip_vertically = cases[t].flip;
+			if (cases[t].gamma > 0.0f)
+				decoder.ldr_to_hdr_gamma = cases[t].gamma;
+			decoder.allocator = { StressAllocator::allocate, StressAllocator::reallocate, StressAllocator::release, &allocators[t] };
+			/* a png with an unknown critical chunk named after the thread, right after IHDR */
+			const std::string chunk = "ZZZ" + std::string(1, (char)('A' + t % 26));
+			std::vector<unsigned char> corrupt = files[png];
+			const unsigned char header[8] = { 0, 0, 0, 0, (unsigned char)chunk[0], (unsigned char)chunk[1], (unsigned char)chunk[2], (unsigned char)chunk[3] };
+			corrupt.insert(corrupt.begin() + 33, header, header + 8);
+			corrupt.insert(corrupt.begin() + 41, 4, 0); // crc, not checked
+			for (unsigned int round = 0; round < rounds && errors[t].empty(); ++round) {
+				for (size_t f = 0; f < files.size(); ++f) {
+					if (decodeForStress(decoder, files[f], cases[t]) != expected[t][f] || decoder.failure_reason)
+						errors[t] = "MISMATCH " + names[f];
+				}
+				/* fails on this thread only : the reason stays in the decoder */
+				int width, height, channels;
+				stbi_uc* failed = stbi_decoder_load_from_memory(&decoder, corrupt.data(), (int)corrupt.size(), &width, &height, &channels, 0);
+				if (failed || !decoder.failure_reason || decoder.failure_reason != chunk + " PNG chunk not known" || stbi_failure_reason())
+					errors[t] = std::string("FAILURE_REASON ") + (decoder.failure_reason ? decoder.failure_reason : "none");
+				stbi_decoder_image_free(&decoder, failed);
+			}
+		});
+	}
+	/* the old API flipping its global flags all along, which no decoder must see */
+	std::thread legacy([&]() {
+		int flip = 0;
+		while (running) {
+			stbi_set_flip_vertically_on_load(flip ^= 1);
+			stbi_set_unpremultiply_on_load(flip);
+			stbi_ldr_to_hdr_gamma(flip ? 3.0f : 2.2f);
+			int width, height, channels;
+			stbi_image_free(stbi_load_from_memory(files[0].data(), (int)files[0].size(), &width, &height, &channels, 0));
+		}
+		stbi_set_flip_vertically_on_load(0);
+		stbi_set_unpremultiply_on_load(0);
+		stbi_ldr_to_hdr_gamma(2.2f);
+	});
+	for (std::thread& thread : threads)
+		thread.join();
+	running = false;
+	legacy.join();
+
+	int result = 0;
+	size_t allocations = 0;
+	for (unsigned int t = 0; t < threadCount; ++t) {
+		const StressAllocator& allocator = allocators[t];
+		if (errors[t].empty() && (allocator.foreign || allocator.allocations != allocator.frees || allocator.allocations == 0))
+			errors[t] = "ALLOCATOR " + std::to_string(allocator.allocations) + " allocations, " + std::to_string(allocator.frees)
+				+ " frees, " + std::to_string(allocator.foreign) + " foreign";
+		if (!errors[t].empty()) {
+			std::cout << "ERROR::STBI_STRESS::" << errors[t] << " (thread " << t << ")" << std::endl;
+			result = 1;
+		}
+		allocations += allocator.allocations;
+	}
+	std::cout << "  " << (size_t)threadCount * rounds * (files.size() + 1) << " decodes in " << msSince(begin) << " ms, "
+		<< allocations << " allocations through the decoders, " << (result ? "FAILED" : "no cross-talk") << std::endl;
+	return result;
+}
+
+namespace {
+	void putBigEndian(std::vector<unsigned char>& out, unsigned int value) {
+		for (int shift = 24; shift >= 0; shift -= 8)
+			out.push_back((unsigned char)(value >> shift));
+	}
+
+	void putChunk(std::vector<unsigned char>& png, const char* type, const std::vector<unsigned char>& data) {
+		putBigEndian(png, (unsigned int)data.size());
+		size_t start = png.size();
+		png.insert(png.end(), type, type + 4);
+		png.insert(png.end(), data.begin(), data.end());
+		unsigned int crc = 0xffffffffu;
+		for (size_t i = start; i < png.size(); ++i) {
+			crc ^= png[i];
+			for (int k = 0; k < 8; ++k)
+				crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+		}
+		putBigEndian(png, ~crc);
+	}
+
+	/* zlib stream of stored blocks : the filtered rows reach the decoder's unfilter as written */
+	std::vector<unsigned char> zlibStored(const std::vector<unsigned char>& data) {
+		std::vector<unsigned char> stream = { 0x78, 0x01 };
+		size_t at = 0;
+		do {
+			size_t size = std::min<size_t>(data.size() - at, 65535);
+			stream.push_back(at + size == data.size() ? 1 : 0);
+			stream.push_back((unsigned char)size);
+			stream.push_back((unsigned char)(size >> 8));
+			stream.push_back((unsigned char)~size);
+			stream.push_back((unsigned char)(~size >> 8));
+			stream.insert(stream.end(), data.begin() + at, data.begin() + at + size);
+			at += size;
+		} while (at < data.size());
+		unsigned int a = 1, b = 0;
+		for (unsigned char byte : data) {
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		putBigEndian(stream, b << 16 | a);
+		return stream;
+	}
+
+	int paethPredictor(int a, int b, int c) {
+		int p = a + b - c;
+		int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc)
+			return a;
+		return pb <= pc ? b : c;
+	}
+
+	/* Appends the samples of a width x height image (or Adam7 pass) as filtered rows : big endian
+	at 16 bits, msb first below 8. Every row takes the next of the 5 filters */
+	void appendFilteredRows(std::vector<unsigned char>& out, const std::vector<unsigned short>& samples, int width, int height,
+		int channels, int depth, int& filter) {
+		const size_t rowBytes = ((size_t)width * channels * depth + 7) / 8;
+		const size_t bpp = std::max(1, channels * depth / 8);
+		std::vector<unsigned char> rows(rowBytes * height, 0);
+		for (int y = 0; y < height; ++y) {
+			unsigned char* row = rows.data() + y * rowBytes;
+			for (int s = 0; s < width * channels; ++s) {
+				unsigned int value = samples[(size_t)y * width * channels + s];
+				if (depth == 16) {
+					row[s * 2] = (unsigned char)(value >> 8);
+					row[s * 2 + 1] = (unsigned char)value;
+				}
+				else
+					row[s * depth / 8] |= (unsigned char)(value << (8 - depth - s * depth % 8));
+			}
+		}
+		for (int y = 0; y < height; ++y) {
+			const unsigned char* cur = rows.data() + y * rowBytes;
+			out.push_back((unsigned char)filter);
+			for (size_t i = 0; i < rowBytes; ++i) {
+				int a = i >= bpp ? cur[i - bpp] : 0;
+				int b = y ? cur[i - rowBytes] : 0;
+				int c = y && i >= bpp ? cur[i - rowBytes - bpp] : 0;
+				const int predicted[5] = { 0, a, b, (a + b) >> 1, paethPredictor(a, b, c) };
+				out.push_back((unsigned char)(cur[i] - predicted[filter]));
+			}
+			filter = (filter + 1) % 5;
+		}
+	}
+}
+
+int runPngFilterTest() {
+	struct Format { int colorType, channels, depth; };
+	const Format formats[] = { { 0, 1, 8 }, { 4, 2, 8 }, { 2, 3, 8 }, { 6, 4, 8 },
+		{ 0, 1, 16 }, { 4, 2, 16 }, { 2, 3, 16 }, { 6, 4, 16 }, { 0, 1, 1 }, { 0, 1, 2 }, { 0, 1, 4 } };
+	const int widths[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 67, 130 };
+	const int heights[] = { 1, 6, 11 };
+
+	std::mt19937 rng(25); // fixed seed, a failure reproduces
+	int images = 0, decodes = 0, failures = 0, filter = 0;
+	for (const Format& format : formats) {
+		for (int width : widths) {
+			for (int height : heights) {
+				for (int interlace = 0; interlace < 2; ++interlace) {
+					/* random samples, with runs and flat areas for the paeth ties */
+					const int channels = format.channels, depth = format.depth;
+					const unsigned int maximum = (1u << depth) - 1;
+					std::vector<unsigned short> samples((size_t)width * height * channels);
+					for (size_t s = 0; s < samples.size(); ++s) {
+						const size_t left = s >= (size_t)channels && s / channels % width ? s - channels : s;
+						const size_t up = s >= (size_t)width * channels ? s - (size_t)width * channels : s;
+						switch (rng() % 4) {
+						case 0: samples[s] = (unsigned short)(rng() & maximum); break;
+						case 1: samples[s] = left == s ? (unsigned short)(rng() & maximum) : samples[left]; break;
+						case 2: samples[s] = up == s ? (unsigned short)(rng() & maximum) : samples[up]; break;
+						default: samples[s] = (unsigned short)(rng() % 2 ? maximum : 0); break;
+						}
+					}
+
+					std::vector<unsigned char> filtered;
+					if (!interlace)
+						appendFilteredRows(filtered, samples, width, height, channels, depth, filter);
+					else {
+						const int xorig[] = { 0,4,0,2,0,1,0 }, yorig[] = { 0,0,4,0,2,0,1 };
+						const int xspc[] = { 8,8,4,4,2,2,1 }, yspc[] = { 8,8,8,4,4,2,2 };
+						for (int p = 0; p < 7; ++p) {
+							const int passWidth = (width - xorig[p] + xspc[p] - 1) / xspc[p];
+							const int passHeight = (height - yorig[p] + yspc[p] - 1) / yspc[p];
+							if (passWidth <= 0 || passHeight <= 0)
+								continue;
+							std::vector<unsigned short> pass;
+							for (int y = 0; y < passHeight; ++y)
+								for (int x = 0; x < passWidth; ++x)
+									for (int c = 0; c < channels; ++c)
+										pass.push_back(samples[((size_t)(y * yspc[p] + yorig[p]) * width + x * xspc[p] + xorig[p]) * channels + c]);
+							appendFilteredRows(filtered, pass, passWidth, passHeight, channels, depth, filter);
+						}
+					}
+					std::vector<unsigned char> header;
+					putBigEndian(header, (unsigned int)width);
+					putBigEndian(header, (unsigned int)height);
+					header.insert(header.end(), { (unsigned char)depth, (unsigned char)format.colorType, 0, 0, (unsigned char)interlace });
+					std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+					putChunk(png, "IHDR", header);
+					putChunk(png, "IDAT", zlibStored(filtered));
+					putChunk(png, "IEND", {});
+					images++;
+
+					/* as stored, then with the opaque alpha the unfilter adds to gray and rgb, 8 and 16 bits */
+					for (int wide = 0; wide < (depth == 16 ? 2 : 1); ++wide) {
+						for (int desired = 0; desired < 2; ++desired) {
+							if (desired && channels != 1 && channels != 3)
+								continue;
+							const int outChannels = channels + desired;
+							std::vector<unsigned short> expected;
+							for (size_t s = 0; s < samples.size(); ++s) {
+								unsigned int value = samples[s];
+								if (depth == 16)
+									expected.push_back((unsigned short)(wide ? value : value >> 8));
+								else
+									expected.push_back((unsigned short)(value * (255 / maximum)));
+								if (desired && s % channels == (size_t)channels - 1)
+									expected.push_back((unsigned short)(wide ? 65535 : 255));
+							}
+							std::vector<unsigned short> decoded;
+							int decodedWidth = 0, decodedHeight = 0, fileChannels;
+							if (wide) {
+								stbi_us* pixels = stbi_load_16_from_memory(png.data(), (int)png.size(), &decodedWidth, &decodedHeight, &fileChannels, desired ? outChannels : 0);
+								if (pixels)
+									decoded.assign(pixels, pixels + expected.size());
+								stbi_image_free(pixels);
+							}
+							else {
+								stbi_uc* pixels = stbi_load_from_memory(png.data(), (int)png.size(), &decodedWidth, &decodedHeight, &fileChannels, desired ? outChannels : 0);
+								if (pixels)
+									decoded.assign(pixels, pixels + expected.size());
+								stbi_image_free(pixels);
+							}
+							decodes++;
+							if (decoded != expected || decodedWidth != width || decodedHeight != height) {
+								if (failures++ < 10)
+									std::cout << "ERROR::PNG_FILTERS::MISMATCH color type " << format.colorType << ", " << depth << " bits, "
+										<< width << "x" << height << (interlace ? " interlaced" : "") << ", loaded as " << outChannels
+										<< " x " << (wide ? 16 : 8) << " bits : " << (decoded.empty() ? stbi_failure_reason() : "wrong pixels") << std::endl;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	std::cout << "PNG filter check : " << images << " images, " << decodes << " decodes, every filter on every row kind, "
+		<< (failures ? std::to_string(failures) + " FAILED" : std::string("all identical to the encoded pixels")) << std::endl;
+	return failures ? 1 : 0;
+}
+
+namespace {
+	const unsigned short LENGTH_BASE[29] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+	const unsigned char LENGTH_EXTRA[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+	const unsigned short DISTANCE_BASE[30] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,
+		1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+	const unsigned char DISTANCE_EXTRA[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+	const unsigned char CODE_LENGTH_ORDER[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+
+	/* length 0 : a literal */
+	struct DeflateToken {
+		unsigned short length, distance;
+		unsigned char literal;
+	};
+
+	/* index of the largest base <= value, 258 gets its own code */
+	int deflateSymbol(const unsigned short* base, int count, unsigned int value) {
+		int symbol = 0;
+		while (symbol + 1 < count && base[symbol + 1] <= value)
+			symbol++;
+		return symbol;
+	}
+
+	/* DEFLATE packs from the lsb up, Huffman codes msb first */
+	struct BitWriter {
+		std::vector<unsigned char> bytes;
+		unsigned int buffer = 0;
+		int count = 0;
+
+		void put(unsigned int value, int bits) {
+			buffer |= value << count;
+			count += bits;
+			while (count >= 8) {
+				bytes.push_back((unsigned char)buffer);
+				buffer >>= 8;
+				count -= 8;
+			}
+		}
+		void putCode(unsigned int code, int length) {
+			unsigned int reversed = 0;
+			for (int i = 0; i < length; ++i)
+				reversed |= ((code >> i) & 1) << (length - 1 - i);
+			put(reversed, length);
+		}
+		void align() {
+			if (count > 0)
+				put(0, 8 - count);
+		}
+	};
+
+	/* Huffman code lengths of at most maxBits, unused symbols get 0. A tree too deep is rebuilt
+	from halved counts until it fits. */
+	std::vector<int> huffmanLengths(std::vector<unsigned int> counts, int maxBits) {
+		std::vector<int> lengths(counts.size(), 0);
+		for (;;) {
+			typedef std::pair<unsigned long long, int> Node; // weight, node
+			std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+			std::vector<int> parent(counts.size() * 2, -1);
+			for (size_t s = 0; s < counts.size(); ++s) {
+				if (counts[s])
+					queue.push({ counts[s], (int)s });
+			}
+			if (queue.empty())
+				return lengths;
+			if (queue.size() == 1) {
+				lengths[queue.top().second] = 1;
+				return lengths;
+			}
+			int next = (int)counts.size();
+			while (queue.size() > 1) {
+				Node a = queue.top();
+				queue.pop();
+				Node b = queue.top();
+				queue.pop();
+				parent[a.second] = parent[b.second] = next;
+				queue.push({ a.first + b.first, next++ });
+			}
+			int deepest = 0;
+			for (size_t s = 0; s < counts.size(); ++s) {
+				lengths[s] = 0;
+				for (int node = counts[s] ? (int)s : -1; node >= 0 && parent[node] >= 0; node = parent[node])
+					lengths[s]++;
+				deepest = std::max(deepest, lengths[s]);
+			}
+			if (deepest <= maxBits)
+				return lengths;
+			for (unsigned int& count : counts)
+				count = (count + 1) / 2; // a used symbol stays used
+		}
+	}
+
+	/* canonical codes, RFC 1951 3.2.2 */
+	std::vector<unsigned int> canonicalCodes(const std::vector<int>& lengths) {
+		int lengthCount[16] = {};
+		for (int length : lengths)
+			lengthCount[length]++;
+		lengthCount[0] = 0;
+		unsigned int nextCode[16] = {}, code = 0;
+		for (int bits = 1; bits < 16; ++bits) {
+			code = (code + lengthCount[bits - 1]) << 1;
+			nextCode[bits] = code;
+		}
+		std::vector<unsigned int> codes(lengths.size(), 0);
+		for (size_t s = 0; s < lengths.size(); ++s) {
+			if (lengths[s])
+				codes[s] = nextCode[lengths[s]]++;
+		}
+		return codes;
+	}
+
+	void putTokens(BitWriter& out, const DeflateToken* tokens, size_t count,
+		const std::vector<int>& literalLengths, const std::vector<unsigned int>& literalCodes,
+		const std::vector<int>& distanceLengths, const std::vector<unsigned int>& distanceCodes) {
+		for (size_t t = 0; t < count; ++t) {
+			const DeflateToken& token = tokens[t];
+			if (!token.length) {
+				out.putCode(literalCodes[token.literal], literalLengths[token.literal]);
+				continue;
+			}
+			int symbol = deflateSymbol(LENGTH_BASE, 29, token.length);
+			out.putCode(literalCodes[257 + symbol], literalLengths[257 + symbol]);
+			out.put(token.length - LENGTH_BASE[symbol], LENGTH_EXTRA[symbol]);
+			symbol = deflateSymbol(DISTANCE_BASE, 30, token.distance);
+			out.putCode(distanceCodes[symbol], distanceLengths[symbol]);
+			out.put(token.distance - DISTANCE_BASE[symbol], DISTANCE_EXTRA[symbol]);
+		}
+		out.putCode(literalCodes[256], literalLengths[256]);
+	}
+
+	void putFixedBlock(BitWriter& out, const DeflateToken* tokens, size_t count, bool final) {
+		std::vector<int> literalLengths(288), distanceLengths(30, 5);
+		for (int s = 0; s < 288; ++s)
+			literalLengths[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+		out.put(final ? 1 : 0, 1);
+		out.put(1, 2);
+		putTokens(out, tokens, count, literalLengths, canonicalCodes(literalLengths), distanceLengths, canonicalCodes(distanceLengths));
+	}
+
+	void putDynamicBlock(BitWriter& out, const DeflateToken* tokens, size_t count, bool final) {
+		std::vector<unsigned int> literalCounts(286, 0), distanceCounts(30, 0);
+		literalCounts[256] = 1;
+		for (size_t t = 0; t < count; ++t) {
+			if (!tokens[t].length)
+				literalCounts[tokens[t].literal]++;
+			else {
+				literalCounts[257 + deflateSymbol(LENGTH_BASE, 29, tokens[t].length)]++;
+				distanceCounts[deflateSymbol(DISTANCE_BASE, 30, tokens[t].distance)]++;
+			}
+		}
+		std::vector<int> literalLengths = huffmanLengths(literalCounts, 15);
+		std::vector<int> distanceLengths = huffmanLengths(distanceCounts, 15);
+		int literalCount = 286, distanceCount = 30;
+		while (literalCount > 257 && !literalLengths[literalCount - 1])
+			literalCount--;
+		while (distanceCount > 1 && !distanceLengths[distanceCount - 1])
+			distanceCount--;
+
+		/* both length lists as one run-length coded sequence : 16 repeats the previous
+		length 3~6 times, 17 & 18 are runs of 3~10 and 11~138 zeros */
+		std::vector<int> all(literalLengths.begin(), literalLengths.begin() + literalCount);
+		all.insert(all.end(), distanceLengths.begin(), distanceLengths.begin() + distanceCount);
+		std::vector<std::pair<int, int>> symbols; // code length symbol, extra bits value
+		for (size_t i = 0; i < all.size();) {
+			size_t run = 1;
+			while (i + run < all.size() && all[i + run] == all[i])
+				run++;
+			if (all[i] == 0 && run >= 11) {
+				run = std::min<size_t>(run, 138);
+				symbols.push_back({ 18, (int)run - 11 });
+			}
+			else if (all[i] == 0 && run >= 3)
+				symbols.push_back({ 17, (int)run - 3 });
+			else if (run >= 4) {
+				run = std::min<size_t>(run, 7);
+				symbols.push_back({ all[i], 0 });
+				symbols.push_back({ 16, (int)run - 4 });
+			}
+			else {
+				run = 1;
+				symbols.push_back({ all[i], 0 });
+			}
+			i += run;
+		}
+		std::vector<unsigned int> codeLengthCounts(19, 0);
+		for (const std::pair<int, int>& symbol : symbols)
+			codeLengthCounts[symbol.first]++;
+		std::vector<int> codeLengthLengths = huffmanLengths(codeLengthCounts, 7);
+		std::vector<unsigned int> codeLengthCodes = canonicalCodes(codeLengthLengths);
+		int codeLengthCount = 19;
+		while (codeLengthCount > 4 && !codeLengthLengths[CODE_LENGTH_ORDER[codeLengthCount - 1]])
+			codeLengthCount--;
+
+		out.put(final ? 1 : 0, 1);
+		out.put(2, 2);
+		out.put(literalCount - 257, 5);
+		out.put(distanceCount - 1, 5);
+		out.put(codeLengthCount - 4, 4);
+		for (int i = 0; i < codeLengthCount; ++i)
+			out.put(codeLengthLengths[CODE_LENGTH_ORDER[i]], 3);
+		for (const std::pair<int, int>& symbol : symbols) {
+			out.putCode(codeLengthCodes[symbol.first], codeLengthLengths[symbol.first]);
+			if (symbol.first >= 16)
+				out.put(symbol.second, symbol.first == 16 ? 2 : symbol.first == 17 ? 3 : 7);
+		}
+		putTokens(out, tokens, count, literalLengths, canonicalCodes(literalLengths), distanceLengths, canonicalCodes(distanceLengths));
+	}
+
+	void putStoredBlock(BitWriter& out, const unsigned char* data, size_t size, bool final) {
+		out.put(final ? 1 : 0, 1);
+		out.put(0, 2);
+		out.align();
+		out.put((unsigned int)size & 0xffff, 16);
+		out.put(~(unsigned int)size & 0xffff, 16);
+		out.bytes.insert(out.bytes.end(), data, data + size);
+	}
+
+	/* Random tokens over the match kinds the decoder treats apart : distance 1, 2~7, 8~15 and
+	16 or more, lengths with every count of extra bits, 258. Appends what they decode to. */
+	void randomTokens(std::mt19937& rng, size_t count, bool skewed, bool matches,
+		std::vector<DeflateToken>& tokens, std::vector<unsigned char>& data) {
+		for (size_t t = 0; t < count; ++t) {
+			DeflateToken token = { 0, 0, 0 };
+			if (matches && !data.empty() && rng() % 3 == 0) {
+				switch (rng() % 5) {
+				case 0: token.distance = 1; break;
+				case 1: token.distance = (unsigned short)(2 + rng() % 6); break;
+				case 2: token.distance = (unsigned short)(8 + rng() % 8); break;
+				case 3: token.distance = (unsigned short)(16 + rng() % 300); break;
+				default: token.distance = (unsigned short)(1 + rng() % 32768); break;
+				}
+				token.distance = (unsigned short)std::min<size_t>(token.distance, data.size());
+				switch (rng() % 4) {
+				case 0: token.length = (unsigned short)(3 + rng() % 8); break;
+				case 1: token.length = (unsigned short)(11 + rng() % 247); break;
+				case 2: token.length = 258; break;
+				default: token.length = LENGTH_BASE[rng() % 29]; break;
+				}
+				for (int i = 0; i < token.length; ++i)
+					data.push_back(data[data.size() - token.distance]);
+			}
+			else {
+				token.literal = (unsigned char)(skewed ? 'a' + rng() % 8 * (rng() % 8) : rng());
+				data.push_back(token.literal);
+			}
+			tokens.push_back(token);
+		}
+	}
+
+	unsigned int adler32(const std::vector<unsigned char>& data) {
+		unsigned int a = 1, b = 0;
+		for (unsigned char byte : data) {
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		return b << 16 | a;
+	}
+}
+
+int runInflateTest() {
+	/* block kinds of each stream : f fixed, d dynamic, s stored */
+	struct Case {
+		const char* name;
+		const char* blocks;
+		size_t tokensPerBlock;
+		bool skewed, matches;
+	};
+	const Case cases[] = {
+		{ "empty fixed", "f", 0, false, false },
+		{ "empty dynamic", "d", 0, false, false },
+		{ "one literal", "f", 1, false, false },
+		{ "fixed", "f", 4000, false, true },
+		{ "fixed skewed", "f", 4000, true, true },
+		{ "dynamic", "d", 4000, false, true },
+		{ "dynamic skewed", "d", 4000, true, true },
+		{ "dynamic literals", "d", 4000, true, false },
+		{ "short blocks", "fdfdsdf", 3, true, true },
+		{ "mixed blocks", "dsfdfsd", 1500, true, true },
+		{ "long stream", "dddddddd", 20000, true, true },
+	};
+
+	std::mt19937 rng(24); // fixed seed, a failure reproduces
+	int streams = 0, decodes = 0, truncations = 0, failures = 0;
+	for (int round = 0; round < 8; ++round) {
+		for (const Case& c : cases) {
+			std::vector<DeflateToken> tokens;
+			std::vector<unsigned char> expected;
+			BitWriter raw;
+			for (const char* block = c.blocks; *block; ++block) {
+				const bool final = block[1] == '\0';
+				if (*block == 's') {
+					size_t begin = expected.size();
+					for (size_t i = 0; i < c.tokensPerBlock; ++i)
+						expected.push_back((unsigned char)rng());
+					putStoredBlock(raw, expected.data() + begin, expected.size() - begin, final);
+					continue;
+				}
+				size_t first = tokens.size();
+				randomTokens(rng, c.tokensPerBlock, c.skewed, c.matches, tokens, expected);
+				if (*block == 'f')
+					putFixedBlock(raw, tokens.data() + first, tokens.size() - first, final);
+				else
+					putDynamicBlock(raw, tokens.data() + first, tokens.size() - first, final);
+			}
+			raw.align();
+			streams++;
+
+			std::vector<unsigned char> zlib = { 0x78, 0x01 };
+			zlib.insert(zlib.end(), raw.bytes.begin(), raw.bytes.end());
+			putBigEndian(zlib, adler32(expected));
+
+			/* the raw stream ends at the end of its allocation, the output buffer holds the data
+			and nothing more : the fast loop must hand over to the checked one at both ends.
+			The bytes after the buffer must be left alone. */
+			std::vector<unsigned char> input(raw.bytes);
+			std::vector<char> exact(expected.size() + 64, (char)0xa5);
+			int rawLength = stbi_zlib_decode_noheader_buffer(exact.data(), (int)expected.size(), (const char*)input.data(), (int)input.size());
+			bool ok = rawLength == (int)expected.size() && std::equal(expected.begin(), expected.end(), (const unsigned char*)exact.data())
+				&& std::count(exact.begin() + expected.size(), exact.end(), (char)0xa5) == 64;
+
+			/* zlib header & growing output, from one byte */
+			int zlibLength = 0;
+			char* grown = stbi_zlib_decode_malloc_guesssize_headerflag((const char*)zlib.data(), (int)zlib.size(), 1, &zlibLength, 1);
+			ok = ok && grown && zlibLength == (int)expected.size() && std::equal(expected.begin(), expected.end(), (const unsigned char*)grown);
+			stbi_image_free(grown);
+			decodes += 2;
+			if (!ok && failures++ < 10)
+				std::cout << "ERROR::INFLATE::MISMATCH " << c.name << " (round " << round << ", " << expected.size() << " bytes) : "
+					<< (rawLength < 0 || !grown ? stbi_failure_reason() : "wrong bytes") << std::endl;
+
+			/* every bit of the last byte is used, so any shorter stream reads past its end */
+			const size_t cuts = std::min<size_t>(raw.bytes.size() - 1, 16);
+			for (size_t cut = 1; cut <= cuts + 4 && cut < raw.bytes.size(); ++cut) {
+				size_t size = cut <= cuts ? raw.bytes.size() - cut : rng() % raw.bytes.size();
+				std::vector<unsigned char> truncated(raw.bytes.begin(), raw.bytes.begin() + size);
+				int length = 0;
+				char* decoded = stbi_zlib_decode_noheader_malloc((const char*)truncated.data(), (int)truncated.size(), &length);
+				truncations++;
+				if (decoded && failures++ < 10)
+					std::cout << "ERROR::INFLATE::TRUNCATION_ACCEPTED " << c.name << " (round " << round << ") cut to "
+						<< size << " of " << raw.bytes.size() << " bytes" << std::endl;
+				stbi_image_free(decoded);
+			}
+		}
+	}
+	std::cout << "Inflate check : " << streams << " fixed, dynamic & stored streams, " << decodes << " decodes, "
+		<< truncations << " truncations, " << (failures ? std::to_string(failures) + " FAILED" : std::string("all identical, every truncation rejected")) << std::endl;
+	return failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <string>
+
+/* CPU-only benchmarks run from the command line instead of the render loop,
+no window or GL context is created. They return the process exit code. */
+
+/* --bench-bvh [count] : build, refit, frustum cull & ray queries over count random boxes */
+int runBVHBenchmark(unsigned int objectCount);
+
+/* --bench-profiler [count] : cost of an empty PROFILE_ZONE, measured over count zones */
+int runProfilerBenchmark(unsigned int zoneCount);
+
+/* --bench-render-queue [count] : RenderQueue::sort over count draws, scene-like keys and random
+64-bit keys, checked against std::stable_sort */
+int runRenderQueueBenchmark(unsigned int itemCount);
+
+/* --bench-compression [path] : every block format & quality on one image, time and PSNR */
+int runCompressionBenchmark(const std::string& imagePath);
+
+/* --bench-texture-cache [path] : TextureLoader's decode thread work, cold against a cache hit */
+int runTextureCacheBenchmark(const std::string& imagePath);
+
+/* --bench-image-load [path] : stbi_load (stdio) against stbi_load_mmap, a file or every file of a directory */
+int runImageLoadBenchmark(const std::string& path);
+
+/* --stress-stbi [rounds] : threads decoding ./images at once, each with its own stbi_decoder
+(flip, channels, gamma, allocator), checked against single threaded results. Fails on any
+cross-talk : wrong pixels, a failure reason or an allocation from another thread. */
+int runStbiStressTest(unsigned int rounds);
+
+/* --verify-png-filters : PNGs written with every filter on rows of every kind (first row, Adam7
+passes, 1 to 8 byte pixels, added alpha) must decode to the pixels they were made from. Covers
+the SIMD unfilter kernels against the scalar definition of the filters. */
+int runPngFilterTest();
+
+/* --verify-inflate : zlib streams of fixed, dynamic & stored blocks from a small encoder, matches
+at distance 1, 2~7, 8~15 and beyond, every length code up to 258. Each must inflate to the bytes it
+was made from, ending exactly at the end of its input, and every truncation of it must fail. */
+int runInflateTest();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,699 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BLOCK_SSE2 1
+#endif
+
+/* One 4x4 block, the channels apart so 4 pixels load at once */
+struct Block {
+	alignas(16) float channel[4][16]; // r, g, b, a in 0~255
+};
+
+/* Interpolation weight of the second endpoint for each index */
+static const float BC1_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+static const float BC4_WEIGHTS[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static const float RGB_ERROR[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+static const float ALPHA_ERROR[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+static const float RGBA_ERROR[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+static int refineIterations(CompressionQuality quality) {
+	return quality == CompressionQuality::Fast ? 0 : quality == CompressionQuality::Normal ? 1 : 8;
+}
+
+static void loadBlock(const unsigned char* rgba, int width, int height, int blockX, int blockY, Block& block) {
+	for (int y = 0; y < 4; ++y) {
+		int sy = std::min(blockY * 4 + y, height - 1);
+		for (int x = 0; x < 4; ++x) {
+			int sx = std::min(blockX * 4 + x, width - 1);
+			const unsigned char* pixel = rgba + ((size_t)sy * width + sx) * 4;
+			for (int c = 0; c < 4; ++c)
+				block.channel[c][y * 4 + x] = pixel[c];
+		}
+	}
+}
+
+/* Nearest palette entry of every pixel, by squared distance scaled per channel.
+Returns the summed error. */
+static float fitIndices(const Block& block, const float (*palette)[4], int count, const float weights[4], uint8_t indices[16]) {
+	float total = 0.0f;
+#if defined(BLOCK_SSE2)
+	const __m128 w[4] = { _mm_set1_ps(weights[0]), _mm_set1_ps(weights[1]), _mm_set1_ps(weights[2]), _mm_set1_ps(weights[3]) };
+	for (int i = 0; i < 16; i += 4) {
+		__m128 x[4];
+		for (int c = 0; c < 4; ++c)
+			x[c] = _mm_load_ps(&block.channel[c][i]);
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i bestIndex = _mm_setzero_si128();
+		for (int p = 0; p < count; ++p) {
+			__m128 d = _mm_setzero_ps();
+			for (int c = 0; c < 4; ++c) {
+				__m128 diff = _mm_sub_ps(x[c], _mm_set1_ps(palette[p][c]));
+				d = _mm_add_ps(d, _mm_mul_ps(w[c], _mm_mul_ps(diff, diff)));
+			}
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+			best = _mm_min_ps(d, best);
+			bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+		}
+		alignas(16) int32_t lanes[4];
+		alignas(16) float errors[4];
+		_mm_store_si128((__m128i*)lanes, bestIndex);
+		_mm_store_ps(errors, best);
+		for (int lane = 0; lane < 4; ++lane) {
+			indices[i + lane] = (uint8_t)lanes[lane];
+			total += errors[lane];
+		}
+	}
+#else
+	for (int i = 0; i < 16; ++i) {
+		float best = FLT_MAX;
+		for (int p = 0; p < count; ++p) {
+			float d = 0.0f;
+			for (int c = 0; c < 4; ++c) {
+				float diff = block.channel[c][i] - palette[p][c];
+				d += weights[c] * diff * diff;
+			}
+			if (d < best) {
+				best = d;
+				indices[i] = (uint8_t)p;
+			}
+		}
+		total += best;
+	}
+#endif
+	return total;
+}
+
+/* Endpoints minimizing the squared error for the given indices, false when every
+pixel picked the same weight */
+static bool leastSquares(const Block& block, const uint8_t indices[16], const float* weights, float e0[4], float e1[4]) {
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = {}, bx[4] = {};
+	for (int i = 0; i < 16; ++i) {
+		float w1 = weights[indices[i]], w0 = 1.0f - w1;
+		aa += w0 * w0;
+		ab += w0 * w1;
+		bb += w1 * w1;
+		for (int c = 0; c < 4; ++c) {
+			ax[c] += w0 * block.channel[c][i];
+			bx[c] += w1 * block.channel[c][i];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (std::fabs(det) < 1e-6f)
+		return false;
+	for (int c = 0; c < 4; ++c) {
+		e0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / det, 0.0f, 255.0f);
+		e1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / det, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+/* Corners of the bounding box. The diagonal from min to max assumes every channel
+rises with the others, the ones falling against the widest channel swap their ends. */
+static void boundingBox(const Block& block, int channels, float e0[4], float e1[4]) {
+	float mean[4] = {};
+	int widest = 0;
+	for (int c = 0; c < channels; ++c) {
+		e0[c] = 255.0f;
+		e1[c] = 0.0f;
+		for (int i = 0; i < 16; ++i) {
+			e0[c] = std::min(e0[c], block.channel[c][i]);
+			e1[c] = std::max(e1[c], block.channel[c][i]);
+			mean[c] += block.channel[c][i] / 16.0f;
+		}
+		if (e1[c] - e0[c] > e1[widest] - e0[widest])
+			widest = c;
+	}
+	for (int c = 0; c < channels; ++c) {
+		float covariance = 0.0f;
+		for (int i = 0; i < 16; ++i)
+			covariance += (block.channel[c][i] - mean[c]) * (block.channel[widest][i] - mean[widest]);
+		if (covariance < 0.0f)
+			std::swap(e0[c], e1[c]);
+	}
+	for (int c = channels; c < 4; ++c)
+		e0[c] = e1[c] = 255.0f;
+}
+
+/* Extremes of the pixels projected on the principal axis of their covariance,
+found by power iteration from the bounding box diagonal */
+static void principalAxis(const Block& block, int channels, float e0[4], float e1[4]) {
+	boundingBox(block, channels, e0, e1);
+
+	float mean[4] = {}, covariance[4][4] = {}, axis[4] = {};
+	for (int c = 0; c < channels; ++c) {
+		for (int i = 0; i < 16; ++i)
+			mean[c] += block.channel[c][i] / 16.0f;
+		axis[c] = e1[c] - e0[c];
+	}
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < channels; ++c) {
+			for (int d = 0; d < channels; ++d)
+				covariance[c][d] += (block.channel[c][i] - mean[c]) * (block.channel[d][i] - mean[d]);
+		}
+	}
+
+	for (int iteration = 0; iteration < 8; ++iteration) {
+		float next[4] = {}, length = 0.0f;
+		for (int c = 0; c < channels; ++c) {
+			for (int d = 0; d < channels; ++d)
+				next[c] += covariance[c][d] * axis[d];
+			length += next[c] * next[c];
+		}
+		if (length < 1e-12f)
+			return; // a flat block, the box is exact
+		length = 1.0f / std::sqrt(length);
+		for (int c = 0; c < channels; ++c)
+			axis[c] = next[c] * length;
+	}
+
+	float lowest = FLT_MAX, highest = -FLT_MAX;
+	for (int i = 0; i < 16; ++i) {
+		float t = 0.0f;
+		for (int c = 0; c < channels; ++c)
+			t += (block.channel[c][i] - mean[c]) * axis[c];
+		lowest = std::min(lowest, t);
+		highest = std::max(highest, t);
+	}
+	for (int c = 0; c < channels; ++c) {
+		e0[c] = std::clamp(mean[c] + axis[c] * lowest, 0.0f, 255.0f);
+		e1[c] = std::clamp(mean[c] + axis[c] * highest, 0.0f, 255.0f);
+	}
+}
+
+static void endpoints(const Block& block, int channels, CompressionQuality quality, float e0[4], float e1[4]) {
+	if (quality == CompressionQuality::Fast)
+		boundingBox(block, channels, e0, e1);
+	else
+		principalAxis(block, channels, e0, e1);
+}
+
+/* BC1 ============================================================================= */
+
+static uint16_t to565(const float color[4]) {
+	int r = (int)std::lround(color[0] * 31.0f / 255.0f);
+	int g = (int)std::lround(color[1] * 63.0f / 255.0f);
+	int b = (int)std::lround(color[2] * 31.0f / 255.0f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void from565(uint16_t value, int color[4]) {
+	int r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+	color[3] = 255;
+}
+
+/* c0 > c1 picks the 4 color mode, c0 <= c1 the 3 color + black one */
+static void bc1Palette(uint16_t c0, uint16_t c1, bool fourColors, int palette[4][4]) {
+	from565(c0, palette[0]);
+	from565(c1, palette[1]);
+	for (int c = 0; c < 4; ++c) {
+		if (fourColors || c0 > c1) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = c == 3 ? 255 : 0;
+		}
+	}
+}
+
+struct ColorFit {
+	uint16_t c0 = 0, c1 = 0;
+	uint8_t indices[16] = {};
+	float error = FLT_MAX;
+};
+
+/* Quantized, ordered for the 4 color mode, then indexed */
+static ColorFit fitColor(const Block& block, const float e0[4], const float e1[4]) {
+	ColorFit fit;
+	fit.c0 = to565(e0);
+	fit.c1 = to565(e1);
+	if (fit.c0 < fit.c1)
+		std::swap(fit.c0, fit.c1);
+
+	int colors[4][4];
+	bc1Palette(fit.c0, fit.c1, true, colors);
+	float palette[4][4];
+	for (int p = 0; p < 4; ++p) {
+		for (int c = 0; c < 4; ++c)
+			palette[p][c] = (float)colors[p][c];
+	}
+	/* equal endpoints read as the 3 color mode, where only index 0 is safe :
+	the palette is flat then and the strict comparison keeps index 0 */
+	fit.error = fitIndices(block, palette, 4, RGB_ERROR, fit.indices);
+	return fit;
+}
+
+static void encodeColor(const Block& block, CompressionQuality quality, unsigned char* out) {
+	float e0[4], e1[4];
+	endpoints(block, 3, quality, e0, e1);
+	ColorFit best = fitColor(block, e1, e0);
+
+	for (int iteration = refineIterations(quality); iteration > 0; --iteration) {
+		if (!leastSquares(block, best.indices, BC1_WEIGHTS, e0, e1))
+			break;
+		ColorFit fit = fitColor(block, e0, e1);
+		if (fit.error >= best.error)
+			break;
+		best = fit;
+	}
+
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; ++i)
+		bits |= (uint32_t)best.indices[i] << (i * 2);
+	out[0] = (unsigned char)(best.c0 & 0xFF);
+	out[1] = (unsigned char)(best.c0 >> 8);
+	out[2] = (unsigned char)(best.c1 & 0xFF);
+	out[3] = (unsigned char)(best.c1 >> 8);
+	memcpy(out + 4, &bits, 4); // little endian, like the format
+}
+
+static void decodeColor(const unsigned char* in, bool fourColors, unsigned char pixels[16][4]) {
+	uint16_t c0 = (uint16_t)(in[0] | (in[1] << 8));
+	uint16_t c1 = (uint16_t)(in[2] | (in[3] << 8));
+	int palette[4][4];
+	bc1Palette(c0, c1, fourColors, palette);
+	uint32_t bits;
+	memcpy(&bits, in + 4, 4);
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < 4; ++c)
+			pixels[i][c] = (unsigned char)palette[(bits >> (i * 2)) & 3][c];
+	}
+}
+
+/* BC3 alpha (BC4) ================================================================= */
+
+/* a0 > a1 : 6 levels between them, the 8 level mode. a0 <= a1 : 4 levels + 0 & 255. */
+static void alphaPalette(int a0, int a1, int palette[8]) {
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1) {
+		for (int i = 2; i < 8; ++i)
+			palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+	}
+	else {
+		for (int i = 2; i < 6; ++i)
+			palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+struct AlphaFit {
+	int a0 = 255, a1 = 255;
+	uint8_t indices[16] = {};
+	float error = FLT_MAX;
+};
+
+static AlphaFit fitAlpha(const Block& block, int a0, int a1) {
+	AlphaFit fit;
+	fit.a0 = a0;
+	fit.a1 = a1;
+	int levels[8];
+	alphaPalette(a0, a1, levels);
+	float palette[8][4] = {};
+	for (int p = 0; p < 8; ++p)
+		palette[p][3] = (float)levels[p];
+	fit.error = fitIndices(block, palette, 8, ALPHA_ERROR, fit.indices);
+	return fit;
+}
+
+static void encodeAlpha(const Block& block, CompressionQuality quality, unsigned char* out) {
+	const float* alpha = block.channel[3];
+	int lowest = 255, highest = 0;
+	for (int i = 0; i < 16; ++i) {
+		lowest = std::min(lowest, (int)alpha[i]);
+		highest = std::max(highest, (int)alpha[i]);
+	}
+	/* equal endpoints : the 4 level mode, every index 0 */
+	AlphaFit best = fitAlpha(block, highest, lowest);
+
+	for (int iteration = refineIterations(quality); iteration > 0 && highest > lowest; --iteration) {
+		float e0[4], e1[4];
+		if (!leastSquares(block, best.indices, BC4_WEIGHTS, e0, e1))
+			break;
+		int a0 = (int)std::lround(e0[3]), a1 = (int)std::lround(e1[3]);
+		if (a0 <= a1)
+			break; // would switch to the 4 level mode
+		AlphaFit fit = fitAlpha(block, a0, a1);
+		if (fit.error >= best.error)
+			break;
+		best = fit;
+	}
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 16; ++i)
+		bits |= (uint64_t)best.indices[i] << (i * 3);
+	out[0] = (unsigned char)best.a0;
+	out[1] = (unsigned char)best.a1;
+	for (int i = 0; i < 6; ++i)
+		out[2 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+static void decodeAlpha(const unsigned char* in, unsigned char pixels[16][4]) {
+	int palette[8];
+	alphaPalette(in[0], in[1], palette);
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; ++i)
+		bits |= (uint64_t)in[2 + i] << (i * 8);
+	for (int i = 0; i < 16; ++i)
+		pixels[i][3] = (unsigned char)palette[(bits >> (i * 3)) & 7];
+}
+
+/* BC7 mode 6 ====================================================================== */
+
+/* 7 bits per channel, the p-bit shared by the 4 channels of an endpoint is the low bit */
+struct Endpoint {
+	int q[4] = {};
+	int p = 0;
+	int value(int c) const { return (q[c] << 1) | p; }
+};
+
+static Endpoint quantize(const float color[4], int p) {
+	Endpoint endpoint;
+	endpoint.p = p;
+	for (int c = 0; c < 4; ++c)
+		endpoint.q[c] = std::clamp((int)std::lround((color[c] - p) * 0.5f), 0, 127);
+	return endpoint;
+}
+
+static Endpoint quantizeBestP(const float color[4]) {
+	Endpoint best;
+	float bestError = FLT_MAX;
+	for (int p = 0; p < 2; ++p) {
+		Endpoint endpoint = quantize(color, p);
+		float error = 0.0f;
+		for (int c = 0; c < 4; ++c)
+			error += (endpoint.value(c) - color[c]) * (endpoint.value(c) - color[c]);
+		if (error < bestError) {
+			bestError = error;
+			best = endpoint;
+		}
+	}
+	return best;
+}
+
+static void mode6Palette(const Endpoint& e0, const Endpoint& e1, int palette[16][4]) {
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < 4; ++c)
+			palette[i][c] = ((64 - BC7_WEIGHTS[i]) * e0.value(c) + BC7_WEIGHTS[i] * e1.value(c) + 32) >> 6;
+	}
+}
+
+struct Mode6Fit {
+	Endpoint e0, e1;
+	uint8_t indices[16] = {};
+	float error = FLT_MAX;
+};
+
+static Mode6Fit fitMode6(const Block& block, const Endpoint& e0, const Endpoint& e1) {
+	Mode6Fit fit;
+	fit.e0 = e0;
+	fit.e1 = e1;
+	int levels[16][4];
+	mode6Palette(e0, e1, levels);
+	float palette[16][4];
+	for (int p = 0; p < 16; ++p) {
+		for (int c = 0; c < 4; ++c)
+			palette[p][c] = (float)levels[p][c];
+	}
+	fit.error = fitIndices(block, palette, 16, RGBA_ERROR, fit.indices);
+	return fit;
+}
+
+/* High quality tries the 4 p-bit pairs, the others round each endpoint on its own */
+static Mode6Fit fitMode6(const Block& block, const float e0[4], const float e1[4], CompressionQuality quality) {
+	if (quality != CompressionQuality::High)
+		return fitMode6(block, quantizeBestP(e0), quantizeBestP(e1));
+	Mode6Fit best;
+	for (int pair = 0; pair < 4; ++pair) {
+		Mode6Fit fit = fitMode6(block, quantize(e0, pair & 1), quantize(e1, pair >> 1));
+		if (fit.error < best.error)
+			best = fit;
+	}
+	return best;
+}
+
+/* Bits from the lowest of the 128, like the format */
+struct BitWriter {
+	uint64_t words[2] = {};
+	int position = 0;
+
+	void write(uint32_t value, int count) {
+		for (int i = 0; i < count; ++i, ++position)
+			words[position >> 6] |= (uint64_t)((value >> i) & 1) << (position & 63);
+	}
+};
+
+struct BitReader {
+	uint64_t words[2] = {};
+	int position = 0;
+
+	uint32_t read(int count) {
+		uint32_t value = 0;
+		for (int i = 0; i < count; ++i, ++position)
+			value |= (uint32_t)((words[position >> 6] >> (position & 63)) & 1) << i;
+		return value;
+	}
+};
+
+static void encodeMode6(const Block& block, CompressionQuality quality, unsigned char* out) {
+	float e0[4], e1[4];
+	endpoints(block, 4, quality, e0, e1);
+	Mode6Fit best = fitMode6(block, e0, e1, quality);
+
+	float weights[16];
+	for (int i = 0; i < 16; ++i)
+		weights[i] = BC7_WEIGHTS[i] / 64.0f;
+	for (int iteration = refineIterations(quality); iteration > 0; --iteration) {
+		if (!leastSquares(block, best.indices, weights, e0, e1))
+			break;
+		Mode6Fit fit = fitMode6(block, e0, e1, quality);
+		if (fit.error >= best.error)
+			break;
+		best = fit;
+	}
+
+	/* the top bit of the first index is implied 0 : swap the ends when it is set,
+	the weights are symmetric so index i becomes 15 - i exactly */
+	if (best.indices[0] >= 8) {
+		std::swap(best.e0, best.e1);
+		for (int i = 0; i < 16; ++i)
+			best.indices[i] = (uint8_t)(15 - best.indices[i]);
+	}
+
+	BitWriter bits;
+	bits.write(1 << 6, 7); // mode 6
+	for (int c = 0; c < 4; ++c) {
+		bits.write(best.e0.q[c], 7);
+		bits.write(best.e1.q[c], 7);
+	}
+	bits.write(best.e0.p, 1);
+	bits.write(best.e1.p, 1);
+	bits.write(best.indices[0], 3);
+	for (int i = 1; i < 16; ++i)
+		bits.write(best.indices[i], 4);
+	memcpy(out, bits.words, 16);
+}
+
+static void decodeMode6(const unsigned char* in, unsigned char pixels[16][4]) {
+	if ((in[0] & 0x7F) != 0x40) {
+		for (int i = 0; i < 16; ++i) {
+			pixels[i][0] = pixels[i][2] = pixels[i][3] = 255;
+			pixels[i][1] = 0;
+		}
+		return;
+	}
+	BitReader bits;
+	memcpy(bits.words, in, 16);
+	bits.read(7);
+	Endpoint e0, e1;
+	for (int c = 0; c < 4; ++c) {
+		e0.q[c] = (int)bits.read(7);
+		e1.q[c] = (int)bits.read(7);
+	}
+	e0.p = (int)bits.read(1);
+	e1.p = (int)bits.read(1);
+	int palette[16][4];
+	mode6Palette(e0, e1, palette);
+	for (int i = 0; i < 16; ++i) {
+		int index = (int)bits.read(i == 0 ? 3 : 4);
+		for (int c = 0; c < 4; ++c)
+			pixels[i][c] = (unsigned char)palette[index][c];
+	}
+}
+
+/* Images ========================================================================== */
+
+const char* blockFormatName(BlockFormat format) {
+	switch (format) {
+	case BlockFormat::BC1: return "BC1";
+	case BlockFormat::BC3: return "BC3";
+	case BlockFormat::BC7: return "BC7";
+	default: return "uncompressed";
+	}
+}
+
+static size_t blockBytes(BlockFormat format) {
+	return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t compressedSize(int width, int height, BlockFormat format) {
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+bool hasTransparency(const unsigned char* rgba, size_t pixelCount) {
+	for (size_t i = 0; i < pixelCount; ++i) {
+		if (rgba[i * 4 + 3] != 255)
+			return true;
+	}
+	return false;
+}
+
+static void encodeBlock(const Block& block, BlockFormat format, CompressionQuality quality, unsigned char* out) {
+	switch (format) {
+	case BlockFormat::BC1:
+		encodeColor(block, quality, out);
+		break;
+	case BlockFormat::BC3:
+		encodeAlpha(block, quality, out);
+		encodeColor(block, quality, out + 8);
+		break;
+	case BlockFormat::BC7:
+		encodeMode6(block, quality, out);
+		break;
+	default:
+		break;
+	}
+}
+
+void compressImage(const unsigned char* rgba, int width, int height, BlockFormat format,
+	CompressionQuality quality, unsigned int threadCount, unsigned char* out) {
+	const int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	const size_t bytes = blockBytes(format);
+	auto compressRows = [&](int begin, int end) {
+		Block block;
+		for (int y = begin; y < end; ++y) {
+			for (int x = 0; x < blocksX; ++x) {
+				loadBlock(rgba, width, height, x, y, block);
+				encodeBlock(block, format, quality, out + ((size_t)y * blocksX + x) * bytes);
+			}
+		}
+	};
+
+	/* contiguous runs of block rows, the calling thread takes the first */
+	int threads = (int)std::clamp(threadCount, 1u, (unsigned int)blocksY);
+	std::vector<std::thread> helpers;
+	for (int t = 1; t < threads; ++t)
+		helpers.emplace_back(compressRows, blocksY * t / threads, blocksY * (t + 1) / threads);
+	compressRows(0, blocksY / threads);
+	for (std::thread& helper : helpers)
+		helper.join();
+}
+
+void decompressImage(const unsigned char* blocks, int width, int height, BlockFormat format, unsigned char* rgba) {
+	const int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	const size_t bytes = blockBytes(format);
+	unsigned char pixels[16][4];
+	for (int by = 0; by < blocksY; ++by) {
+		for (int bx = 0; bx < blocksX; ++bx) {
+			const unsigned char* in = blocks + ((size_t)by * blocksX + bx) * bytes;
+			if (format == BlockFormat::BC1)
+				decodeColor(in, false, pixels);
+			else if (format == BlockFormat::BC3) {
+				decodeColor(in + 8, true, pixels); // always the 4 color mode in BC3
+				decodeAlpha(in, pixels);
+			}
+			else
+				decodeMode6(in, pixels);
+
+			for (int y = 0; y < 4 && by * 4 + y < height; ++y) {
+				for (int x = 0; x < 4 && bx * 4 + x < width; ++x)
+					memcpy(rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, pixels[y * 4 + x], 4);
+			}
+		}
+	}
+}
+
+double psnr(const unsigned char* a, const unsigned char* b, size_t pixelCount, int channels) {
+	double sum = 0.0;
+	for (size_t i = 0; i < pixelCount; ++i) {
+		for (int c = 0; c < channels; ++c) {
+			double diff = (double)a[i * 4 + c] - b[i * 4 + c];
+			sum += diff * diff;
+		}
+	}
+	if (sum == 0.0)
+		return 100.0;
+	double mse = sum / ((double)pixelCount * channels);
+	return std::min(10.0 * std::log10(255.0 * 255.0 / mse), 100.0);
+}
+
+/* Odd sizes drop their last row / column, like most glGenerateMipmap */
+void downsample(const unsigned char* pixels, int width, int height, int channels, std::vector<unsigned char>& out) {
+	const int w = std::max(width / 2, 1), h = std::max(height / 2, 1);
+	out.resize((size_t)w * h * channels);
+	for (int y = 0; y < h; ++y) {
+		const unsigned char* row0 = pixels + (size_t)std::min(y * 2, height - 1) * width * channels;
+		const unsigned char* row1 = pixels + (size_t)std::min(y * 2 + 1, height - 1) * width * channels;
+		for (int x = 0; x < w; ++x) {
+			int x0 = std::min(x * 2, width - 1) * channels, x1 = std::min(x * 2 + 1, width - 1) * channels;
+			for (int c = 0; c < channels; ++c) {
+				int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+				out[((size_t)y * w + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+CompressedImage compressMipmaps(const unsigned char* rgba, int width, int height, BlockFormat format,
+	CompressionQuality quality, unsigned int threadCount) {
+	CompressedImage image;
+	image.format = format;
+
+	size_t total = 0;
+	for (int w = width, h = height; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1)) {
+		CompressedLevel level;
+		level.width = w;
+		level.height = h;
+		level.offset = total;
+		level.size = compressedSize(w, h, format);
+		image.levels.push_back(level);
+		total += level.size;
+		if (w == 1 && h == 1)
+			break;
+	}
+	image.data.resize(total);
+
+	std::vector<unsigned char> current, next;
+	const unsigned char* source = rgba;
+	for (size_t i = 0; i < image.levels.size(); ++i) {
+		const CompressedLevel& level = image.levels[i];
+		compressImage(source, level.width, level.height, format, quality, threadCount, image.data.data() + level.offset);
+		if (i == 0) {
+			std::vector<unsigned char> decoded((size_t)width * height * 4);
+			decompressImage(image.data.data(), width, height, format, decoded.data());
+			image.psnr = psnr(rgba, decoded.data(), (size_t)width * height, format == BlockFormat::BC1 ? 3 : 4);
+		}
+		if (i + 1 < image.levels.size()) {
+			downsample(source, level.width, level.height, 4, next);
+			current.swap(next);
+			source = current.data();
+		}
+	}
+	return image;
+}
\ No newline at end of file
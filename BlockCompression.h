@@ -0,0 +1,59 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <cstddef>
+#include <vector>
+
+/* CPU encoder for the block-compressed texture formats, from 8-bit RGBA.
+Every format stores 4x4 pixel blocks : two endpoint colors and an index per pixel
+picking a point on the segment between them.
+	BC1 : 8 bytes, RGB 565 endpoints, 4 colors (no alpha)
+	BC3 : 16 bytes, BC1 color + 8 alpha levels between two 8-bit endpoints
+	BC7 : 16 bytes, only mode 6 is written : RGBA 7777 + p-bit endpoints, 16 levels
+The nearest index search runs 4 pixels at a time with SSE2, the block rows of an
+image are split over threads. No GL here, see TextureLoader for the upload. */
+
+enum class BlockFormat { None, BC1, BC3, BC7 };
+
+/* Fast   : bounding box endpoints
+Normal : principal axis endpoints, refined once by least squares
+High   : refined until the error stops dropping, BC7 also tries every p-bit pair */
+enum class CompressionQuality { Fast, Normal, High };
+
+struct CompressedLevel {
+	int width = 0, height = 0;
+	size_t offset = 0, size = 0; // bytes in CompressedImage::data
+};
+
+struct CompressedImage {
+	BlockFormat format = BlockFormat::None;
+	std::vector<unsigned char> data; // every level, largest first
+	std::vector<CompressedLevel> levels;
+	double psnr = 0.0; // level 0 against the source
+};
+
+const char* blockFormatName(BlockFormat format);
+size_t compressedSize(int width, int height, BlockFormat format);
+bool hasTransparency(const unsigned char* rgba, size_t pixelCount); // some alpha below 255
+
+/* rgba : width x height, 4 bytes per pixel. The partial blocks of the right & bottom
+edges repeat their last column / row. out holds compressedSize() bytes. */
+void compressImage(const unsigned char* rgba, int width, int height, BlockFormat format,
+	CompressionQuality quality, unsigned int threadCount, unsigned char* out);
+
+/* Back to RGBA, for the error metric. Only the BC7 mode the encoder writes is read,
+blocks of other modes come out magenta. */
+void decompressImage(const unsigned char* blocks, int width, int height, BlockFormat format, unsigned char* rgba);
+
+/* Peak signal to noise ratio in dB over the first `channels` of two RGBA images,
+100 when they are identical */
+double psnr(const unsigned char* a, const unsigned char* b, size_t pixelCount, int channels);
+
+/* 2x2 box filter down to max(width / 2, 1) x max(height / 2, 1), any channel count */
+void downsample(const unsigned char* pixels, int width, int height, int channels, std::vector<unsigned char>& out);
+
+/* The whole mip chain down to 1x1, each level a 2x2 box filter of the previous one */
+CompressedImage compressMipmaps(const unsigned char* rgba, int width, int height, BlockFormat format,
+	CompressionQuality quality, unsigned int threadCount);
+
+#endif
\ No newline at end of file
@@ -17,6 +17,9 @@ public:
 	float yaw = -90.0f;
 	float pitch = 0.0f;
 	float fov = 45.0f; // field of view. fov gets smaller, then zooming in.
+	float aspect = 800.0f / 600.0f;
+	float zNear = 0.1f;
+	float zFar = 100.0f;
 
 	float sensitivity = 0.1f;
 	float speedCoeff = 2.5f;
@@ -29,6 +32,9 @@ public:
 	inline glm::vec3 getFront() { return Front; }
 	inline glm::vec3 getUp() { return Up; }
 	inline float getFOV() { return fov;	}
+
+	inline glm::mat4 getView() { return glm::lookAt(Pos, Pos + Front, Up); }
+	inline glm::mat4 getProjection() { return glm::perspective(glm::radians(fov), aspect, zNear, zFar); }
 };
 
 #endif
\ No newline at end of file
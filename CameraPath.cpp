@@ -0,0 +1,114 @@
+#include "CameraPath.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+namespace {
+	const char PATH_MAGIC[4] = { 'C', 'A', 'M', 'P' };
+	const uint32_t PATH_VERSION = 1;
+
+	struct PathHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t sampleSize; // sizeof(CameraSample), rejects files from a different layout
+		uint32_t sampleCount;
+	};
+
+	inline float lerp(float a, float b, float t) {
+		return a + (b - a) * t;
+	}
+}
+
+void CameraPath::record(float time, Camera& camera) {
+	CameraSample sample;
+	sample.time = _samples.empty() ? time : std::max(time, _samples.back().time);
+	glm::vec3 pos = camera.getPos();
+	glm::vec3 front = camera.getFront();
+	sample.pos[0] = pos.x; sample.pos[1] = pos.y; sample.pos[2] = pos.z;
+	sample.front[0] = front.x; sample.front[1] = front.y; sample.front[2] = front.z;
+	sample.yaw = camera.yaw;
+	sample.pitch = camera.pitch;
+	sample.fov = camera.fov;
+	_samples.push_back(sample);
+}
+
+bool CameraPath::save(const std::string& path) const {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cout << "ERROR::CAMERA_PATH::FILE_NOT_WRITABLE " << path << std::endl;
+		return false;
+	}
+
+	PathHeader header;
+	memcpy(header.magic, PATH_MAGIC, sizeof(PATH_MAGIC));
+	header.version = PATH_VERSION;
+	header.sampleSize = sizeof(CameraSample);
+	header.sampleCount = (uint32_t)_samples.size();
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)_samples.data(), _samples.size() * sizeof(CameraSample));
+	return (bool)out;
+}
+
+bool CameraPath::load(const std::string& path) {
+	_samples.clear();
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		std::cout << "ERROR::CAMERA_PATH::FILE_NOT_READABLE " << path << std::endl;
+		return false;
+	}
+
+	PathHeader header;
+	if (!in.read((char*)&header, sizeof(header))
+		|| memcmp(header.magic, PATH_MAGIC, sizeof(PATH_MAGIC)) != 0
+		|| header.version != PATH_VERSION || header.sampleSize != sizeof(CameraSample)) {
+		std::cout << "ERROR::CAMERA_PATH::INVALID_FILE " << path << std::endl;
+		return false;
+	}
+
+	/* the count is checked against the file before anything is allocated for it */
+	std::error_code ec;
+	uintmax_t fileSize = std::filesystem::file_size(path, ec);
+	if (ec || header.sampleCount > (fileSize - sizeof(header)) / sizeof(CameraSample)) {
+		std::cout << "ERROR::CAMERA_PATH::TRUNCATED_FILE " << path << std::endl;
+		return false;
+	}
+
+	_samples.resize(header.sampleCount);
+	if (!in.read((char*)_samples.data(), _samples.size() * sizeof(CameraSample))) {
+		std::cout << "ERROR::CAMERA_PATH::TRUNCATED_FILE " << path << std::endl;
+		_samples.clear();
+		return false;
+	}
+	return true;
+}
+
+void CameraPath::apply(float time, Camera& camera) const {
+	if (_samples.empty())
+		return;
+
+	/* first sample after time, the pose is blended with the one before it */
+	auto next = std::upper_bound(_samples.begin(), _samples.end(), time,
+		[](float t, const CameraSample& sample) { return t < sample.time; });
+	const CameraSample& b = next == _samples.end() ? _samples.back() : *next;
+	const CameraSample& a = next == _samples.begin() ? _samples.front() : *(next - 1);
+	float span = b.time - a.time;
+	float t = span > 0.0f ? std::min(std::max((time - a.time) / span, 0.0f), 1.0f) : 0.0f;
+
+	camera.Pos = glm::vec3(lerp(a.pos[0], b.pos[0], t), lerp(a.pos[1], b.pos[1], t), lerp(a.pos[2], b.pos[2], t));
+	camera.Front = glm::normalize(glm::vec3(lerp(a.front[0], b.front[0], t),
+		lerp(a.front[1], b.front[1], t), lerp(a.front[2], b.front[2], t)));
+	camera.yaw = lerp(a.yaw, b.yaw, t);
+	camera.pitch = lerp(a.pitch, b.pitch, t);
+	camera.fov = lerp(a.fov, b.fov, t);
+}
+
+uint64_t CameraPath::hashPose(uint64_t hash, Camera& camera) {
+	glm::vec3 pos = camera.getPos();
+	glm::vec3 front = camera.getFront();
+	float pose[7] = { pos.x, pos.y, pos.z, front.x, front.y, front.z, camera.fov };
+	return hashBytes(hash, pose, sizeof(pose));
+}
\ No newline at end of file
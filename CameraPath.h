@@ -0,0 +1,46 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "Camera.h"
+
+/* One camera pose, written as is (40 bytes) after the file header */
+struct CameraSample {
+	float time; // seconds since the recording started
+	float pos[3];
+	float front[3];
+	float yaw, pitch, fov;
+};
+
+/* Recorded camera path. Recording stores the live camera pose once per frame;
+replay resamples it at a fixed simulated time step, so a replayed run renders
+exactly the same frames every time, whatever the frame rate of the recording.
+Poses are stored rather than input events : the replay does not depend on the
+camera's input handling or on the delta time of the recording. */
+class CameraPath
+{
+public:
+	void clear() { _samples.clear(); }
+	void record(float time, Camera& camera); // times must not decrease
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+
+	/* Interpolated pose at time, clamped to the ends of the path */
+	void apply(float time, Camera& camera) const;
+
+	float duration() const { return _samples.empty() ? 0.0f : _samples.back().time; }
+	size_t size() const { return _samples.size(); }
+
+	/* FNV-1a over the bits of the pose (Hash.h), chain it from HASH_SEED over the frames to compare runs */
+	static uint64_t hashPose(uint64_t hash, Camera& camera);
+
+private:
+	std::vector<CameraSample> _samples;
+};
+
+#endif
\ No newline at end of file
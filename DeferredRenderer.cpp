@@ -0,0 +1,139 @@
+#include "DeferredRenderer.h"
+#include "FrameData.h"
+#include "LightClusters.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+
+#include <iostream>
+#include <stdexcept>
+
+const char* gbufferFragmentPath = "./shaders/gbufferFragment.glsl";
+const char* deferredVertexPath = "./shaders/deferredVertex.glsl";
+const char* deferredFragmentPath = "./shaders/deferredFragment.glsl";
+const char* lightVolumeVertexPath = "./shaders/lightVolumeVertex.glsl";
+const char* lightVolumeFragmentPath = "./shaders/lightVolumeFragment.glsl";
+
+DeferredRenderer::DeferredRenderer(const char* vertexPath, const char* instancedVertexPath)
+	: geometryShader(vertexPath, gbufferFragmentPath),
+	instancedGeometryShader(instancedVertexPath, gbufferFragmentPath),
+	_directionalShader(deferredVertexPath, deferredFragmentPath),
+	_volumeShader(lightVolumeVertexPath, lightVolumeFragmentPath)
+{
+}
+
+void DeferredRenderer::setSamplers(Shader& shader, float shininess) {
+	shader.use();
+	shader.setInt("gNormal", GBUFFER_UNIT + NORMAL);
+	shader.setInt("gDiffuse", GBUFFER_UNIT + DIFFUSE);
+	shader.setInt("gSpecular", GBUFFER_UNIT + SPECULAR);
+	shader.setInt("gDepth", GBUFFER_UNIT + DEPTH);
+	shader.setInt("lightData", LightClusters::LIGHT_DATA_UNIT);
+	shader.setFloat("shininess", shininess);
+}
+
+void DeferredRenderer::init(float shininess) {
+	_directionalShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+	_volumeShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+	geometryShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+	instancedGeometryShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+
+	setSamplers(_directionalShader, shininess);
+	setSamplers(_volumeShader, shininess);
+	resolveUniforms();
+
+	glGenFramebuffers(1, &_fbo);
+	glGenTextures(TEXTURE_COUNT, _textures);
+	glGenVertexArrays(1, &_emptyVAO);
+}
+
+void DeferredRenderer::resolveUniforms() {
+	_directionalInverse = _directionalShader.uniform("inverseViewProjection");
+	_volumeInverse = _volumeShader.uniform("inverseViewProjection");
+}
+
+void DeferredRenderer::resize(int width, int height) {
+	if (width == _width && height == _height)
+		return;
+	_width = width;
+	_height = height;
+
+	/* normals need the precision, the material texels are 8-bit to begin with */
+	const GLenum internalFormats[TEXTURE_COUNT] = { GL_RGBA16F, GL_RGBA8, GL_RGBA8, GL_DEPTH24_STENCIL8 };
+	const GLenum formats[TEXTURE_COUNT] = { GL_RGBA, GL_RGBA, GL_RGBA, GL_DEPTH_STENCIL };
+	const GLenum types[TEXTURE_COUNT] = { GL_FLOAT, GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE, GL_UNSIGNED_INT_24_8 };
+
+	glState.bindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	for (unsigned int i = 0; i < TEXTURE_COUNT; ++i) {
+		glState.bindTexture(GBUFFER_UNIT + i, GL_TEXTURE_2D, _textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], width, height, 0, formats[i], types[i], NULL);
+		/* read with texelFetch only, but a mipmapped filter would leave the texture incomplete */
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		GLenum attachment = i == DEPTH ? GL_DEPTH_STENCIL_ATTACHMENT : GL_COLOR_ATTACHMENT0 + i;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, _textures[i], 0);
+	}
+	const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glDrawBuffers(3, drawBuffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::DEFERRED::GBUFFER_INCOMPLETE " << width << "x" << height << std::endl;
+		throw std::runtime_error("Failed to create the G-buffer");
+	}
+}
+
+void DeferredRenderer::beginGeometryPass() {
+	glState.bindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void DeferredRenderer::lightPass(unsigned int outputFBO, unsigned int lightVAO, unsigned int lightCount,
+	const glm::mat4& viewProjection) {
+	GPU_SCOPE("Lighting");
+	const glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+
+	/* the volumes are depth tested against the scene, and so are the forward passes after this */
+	glState.bindFramebuffer(GL_READ_FRAMEBUFFER, _fbo);
+	glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFBO);
+	glBlitFramebuffer(0, 0, _width, _height, 0, 0, _width, _height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glState.bindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+
+	for (unsigned int i = 0; i < TEXTURE_COUNT; ++i)
+		glState.bindTexture(GBUFFER_UNIT + i, GL_TEXTURE_2D, _textures[i]);
+
+	/* directional & spot light over every covered pixel, background pixels are discarded */
+	glState.disable(GL_DEPTH_TEST);
+	_directionalShader.use();
+	_directionalShader.setMat4(_directionalInverse, inverseViewProjection);
+	glState.bindVertexArray(_emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	/* Point lights, added on top. Only back faces are drawn, with GL_GEQUAL : a pixel is
+	shaded once per light, when its surface is in front of the volume's far side, even
+	with the camera inside the volume. Depth clamping keeps back faces past the far
+	plane, which the large scene lights have. */
+	if (lightCount > 0) {
+		glState.enable(GL_DEPTH_TEST);
+		glDepthFunc(GL_GEQUAL);
+		glDepthMask(GL_FALSE);
+		glState.enable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+		glState.enable(GL_CULL_FACE);
+		glCullFace(GL_FRONT);
+		glState.enable(GL_DEPTH_CLAMP);
+
+		_volumeShader.use();
+		_volumeShader.setMat4(_volumeInverse, inverseViewProjection);
+		glState.bindVertexArray(lightVAO);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 36, lightCount);
+
+		glState.disable(GL_DEPTH_CLAMP);
+		glCullFace(GL_BACK);
+		glState.disable(GL_CULL_FACE);
+		glState.disable(GL_BLEND);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+	}
+	glState.enable(GL_DEPTH_TEST);
+}
\ No newline at end of file
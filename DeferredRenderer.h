@@ -0,0 +1,55 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+/* Deferred shading path, the alternative to the clustered forward shader.
+The opaque pass writes the G-buffer (world normal, diffuse & specular texels,
+depth) with the geometry shaders below, then lightPass() shades each pixel
+once : a full-screen triangle for the directional & spot light, then one
+instanced draw of the light cube (lightVAO) for the point lights. Each instance
+reads its light from the LightClusters light buffer by gl_InstanceID and is
+scaled to enclose the sphere of influence, so a point light only costs the
+pixels it covers, however many surfaces were drawn over each other. */
+class DeferredRenderer
+{
+public:
+	/* G-buffer textures : normal, diffuse, specular, depth on 4 units from here,
+	after the material maps and the light cluster buffers */
+	static const unsigned int GBUFFER_UNIT = 5;
+
+	DeferredRenderer(const char* vertexPath, const char* instancedVertexPath);
+
+	/* geometry pass programs, same vertex shaders as the forward path */
+	Shader geometryShader;
+	Shader instancedGeometryShader;
+
+	void init(float shininess); // once the shaders are built
+	void resolveUniforms(); // again after a hot reload replaced a program
+	void resize(int width, int height); // reallocates the G-buffer when the size changed
+
+	void beginGeometryPass(); // bind & clear the G-buffer
+	/* shades into outputFBO, whose depth is replaced with the G-buffer's so later
+	forward passes are depth tested against the scene */
+	void lightPass(unsigned int outputFBO, unsigned int lightVAO, unsigned int lightCount,
+		const glm::mat4& viewProjection);
+
+private:
+	enum { NORMAL, DIFFUSE, SPECULAR, DEPTH, TEXTURE_COUNT };
+
+	Shader _directionalShader; // full-screen : directional & spot light
+	Shader _volumeShader; // instanced point light volumes
+	Uniform _directionalInverse, _volumeInverse; // inverseViewProjection
+
+	unsigned int _fbo = 0;
+	unsigned int _textures[TEXTURE_COUNT] = { 0, 0, 0, 0 };
+	unsigned int _emptyVAO = 0; // the full-screen triangle has no attributes, core still needs a VAO
+	int _width = 0, _height = 0;
+
+	void setSamplers(Shader& shader, float shininess);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "DepthPrepass.h"
+#include "FrameData.h"
+
+const char* depthVertexPath = "./shaders/depthVertex.glsl";
+const char* depthInstancedVertexPath = "./shaders/depthInstancedVertex.glsl";
+const char* depthFragmentPath = "./shaders/depthFragment.glsl";
+
+DepthPrepass::DepthPrepass()
+	: shader(depthVertexPath, depthFragmentPath),
+	instancedShader(depthInstancedVertexPath, depthFragmentPath)
+{
+}
+
+void DepthPrepass::init() {
+	shader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+	instancedShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+	for (Frame& frame : _frames)
+		glGenQueries(2, frame.queries);
+}
+
+void DepthPrepass::collect(Frame& frame) {
+	/* the shading query ended last, once it is ready both are */
+	int ready = 0;
+	glGetQueryObjectiv(frame.queries[1], GL_QUERY_RESULT_AVAILABLE, &ready);
+	if (!ready)
+		return; // dropped, stats keep the previous frame
+
+	GLuint64 depth = 0, shaded = 0;
+	glGetQueryObjectui64v(frame.queries[0], GL_QUERY_RESULT, &depth);
+	glGetQueryObjectui64v(frame.queries[1], GL_QUERY_RESULT, &shaded);
+	_last.depthSamples = depth;
+	_last.shadedSamples = shaded;
+	_total.depthSamples += depth;
+	_total.shadedSamples += shaded;
+	_collected++;
+}
+
+void DepthPrepass::beginDepthPass() {
+	/* this slot was last used FRAME_LATENCY frames ago */
+	Frame& frame = _frames[_frameIndex % FRAME_LATENCY];
+	if (frame.pending)
+		collect(frame);
+	frame.pending = false;
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glBeginQuery(GL_SAMPLES_PASSED, frame.queries[0]);
+	_active = true;
+}
+
+void DepthPrepass::beginShadingPass() {
+	if (!_active)
+		return;
+	Frame& frame = _frames[_frameIndex % FRAME_LATENCY];
+	glEndQuery(GL_SAMPLES_PASSED);
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthFunc(GL_EQUAL);
+	glDepthMask(GL_FALSE);
+	glBeginQuery(GL_SAMPLES_PASSED, frame.queries[1]);
+}
+
+void DepthPrepass::end() {
+	if (!_active)
+		return;
+	glEndQuery(GL_SAMPLES_PASSED);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+
+	_frames[_frameIndex % FRAME_LATENCY].pending = true;
+	_frameIndex++;
+	_active = false;
+}
\ No newline at end of file
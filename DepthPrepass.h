@@ -0,0 +1,63 @@
+#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+#include "Shader.h"
+
+/* Optional depth-only pass before forward shading.
+The opaque items are drawn first with the trivial programs below and color
+writes masked, then shaded with GL_EQUAL and depth writes off, so the lighting
+shader runs once per visible pixel instead of once per fragment that passed
+the depth test at the time it was drawn.
+
+Both passes are wrapped in GL_SAMPLES_PASSED queries : the pre-pass count is
+what shading would have cost without it (same draw order, GL_LESS), the
+shading count what it costs now. Like GPUProfiler the results are read back
+FRAME_LATENCY frames late and never waited for. */
+class DepthPrepass
+{
+public:
+	static const unsigned int FRAME_LATENCY = 4;
+
+	struct Stats {
+		uint64_t depthSamples = 0; // fragments passing GL_LESS in the pre-pass
+		uint64_t shadedSamples = 0; // fragments shaded after it
+		uint64_t savedSamples() const { return depthSamples > shadedSamples ? depthSamples - shadedSamples : 0; }
+		double savedFraction() const { return depthSamples ? (double)savedSamples() / depthSamples : 0.0; }
+	};
+
+	DepthPrepass();
+
+	/* same vertex transforms as vertexShader.glsl / instancedVertex.glsl, empty fragment shader */
+	Shader shader;
+	Shader instancedShader;
+
+	void init(); // once the shaders are built
+
+	void beginDepthPass(); // reads back an older frame, masks color writes
+	void beginShadingPass(); // GL_EQUAL, depth writes off
+	void end(); // back to GL_LESS with depth writes
+
+	bool available() const { return _collected > 0; }
+	const Stats& lastFrame() const { return _last; } // newest frame read back
+	const Stats& total() const { return _total; } // every frame read back so far
+
+private:
+	struct Frame {
+		unsigned int queries[2] = { 0, 0 }; // depth, shading
+		bool pending = false;
+	};
+
+	Frame _frames[FRAME_LATENCY];
+	uint64_t _frameIndex = 0;
+	uint64_t _collected = 0;
+	Stats _last, _total;
+	bool _active = false;
+
+	void collect(Frame& frame);
+};
+
+#endif
\ No newline at end of file
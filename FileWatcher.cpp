@@ -0,0 +1,101 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static std::filesystem::file_time_type lastWriteTime(const std::string& path) {
+	std::error_code error; // a file being replaced may be missing for a moment
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+	return error ? std::filesystem::file_time_type::min() : time;
+}
+
+static void addChanged(std::vector<std::string>& changed, const std::string& path) {
+	if (std::find(changed.begin(), changed.end(), path) == changed.end())
+		changed.push_back(path);
+}
+
+FileWatcher::FileWatcher() {
+	_lastPoll = std::chrono::steady_clock::now();
+#ifdef __linux__
+	_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_fd < 0)
+		std::cout << "ERROR::FILE_WATCHER::INOTIFY_INIT_FAILED, polling modification times" << std::endl;
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+	if (_fd >= 0)
+		close(_fd);
+#endif
+}
+
+void FileWatcher::watch(const std::string& path) {
+	if (_files.count(path))
+		return;
+	_files[path] = lastWriteTime(path);
+
+#ifdef __linux__
+	if (_fd < 0)
+		return;
+	std::string directory = std::filesystem::path(path).parent_path().generic_string();
+	if (directory.empty())
+		directory = ".";
+	for (const auto& watched : _directories) {
+		if (watched.second == directory)
+			return;
+	}
+	/* IN_CLOSE_WRITE : written in place, IN_MOVED_TO : renamed over */
+	int wd = inotify_add_watch(_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd < 0)
+		std::cout << "ERROR::FILE_WATCHER::WATCH_FAILED " << directory << std::endl;
+	else
+		_directories[wd] = directory;
+#endif
+}
+
+bool FileWatcher::poll(std::vector<std::string>& changed) {
+	changed.clear();
+#ifdef __linux__
+	if (_fd >= 0) {
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(_fd, buffer, sizeof(buffer))) > 0) {
+			for (char* p = buffer; p < buffer + length; ) {
+				const inotify_event* event = (const inotify_event*)p;
+				p += sizeof(inotify_event) + event->len;
+
+				auto directory = _directories.find(event->wd);
+				if (event->len == 0 || directory == _directories.end())
+					continue;
+				std::string path = (std::filesystem::path(directory->second) / event->name).lexically_normal().generic_string();
+				if (_files.count(path))
+					addChanged(changed, path);
+			}
+		}
+		return !changed.empty();
+	}
+#endif
+	return pollModificationTimes(changed);
+}
+
+bool FileWatcher::pollModificationTimes(std::vector<std::string>& changed) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - _lastPoll < POLL_INTERVAL)
+		return false;
+	_lastPoll = now;
+
+	for (auto& file : _files) {
+		std::filesystem::file_time_type time = lastWriteTime(file.first);
+		if (time != file.second && time != std::filesystem::file_time_type::min()) {
+			file.second = time;
+			addChanged(changed, file.first);
+		}
+	}
+	return !changed.empty();
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Reports the watched files written since the last poll(), without blocking.
+On Linux through inotify on their directories, not the files : editors often save
+by writing a new file and renaming it over the old one. Elsewhere the modification
+times are compared, at most every POLL_INTERVAL. */
+class FileWatcher
+{
+public:
+	static constexpr std::chrono::milliseconds POLL_INTERVAL{ 250 };
+
+	FileWatcher();
+	~FileWatcher();
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	void watch(const std::string& path); // normalized, see ShaderPreprocessor::normalizePath()
+	bool poll(std::vector<std::string>& changed); // false when nothing changed
+
+private:
+	std::unordered_map<std::string, std::filesystem::file_time_type> _files; // path -> last write
+	std::chrono::steady_clock::time_point _lastPoll;
+#ifdef __linux__
+	int _fd = -1; // inotify instance, -1 : falls back to polling
+	std::unordered_map<int, std::string> _directories; // watch descriptor -> directory
+#endif
+
+	bool pollModificationTimes(std::vector<std::string>& changed);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef FRAME_DATA_H
+#define FRAME_DATA_H
+
+#include <glm/glm.hpp>
+#include <cstddef>
+
+/* CPU mirror of the std140 uniform block "FrameData" declared in shaders/frameData.glsl.
+Written once per frame with glBufferSubData and shared by every program through
+binding point FRAME_DATA_BINDING.
+std140 rules : vec3 is aligned to 16 bytes, structs & arrays round up to 16 bytes,
+so explicit padding floats keep the C++ offsets identical to the GLSL ones. */
+
+#define FRAME_DATA_BINDING 0
+
+struct DirLightStd140 {
+	glm::vec3 direction; float _pad0;
+	glm::vec3 ambient;   float _pad1;
+	glm::vec3 diffuse;   float _pad2;
+	glm::vec3 specular;  float _pad3;
+};
+
+struct PointLightStd140 {
+	glm::vec3 position;  float _pad0;
+	glm::vec3 direction; // For Spotlight
+	float cutOff;        // packed into the 4th component of direction
+	float outerCutOff;
+	float constant;
+	float linear;
+	float quadratic;
+	glm::vec3 ambient;   float _pad1;
+	glm::vec3 diffuse;   float _pad2;
+	glm::vec3 specular;  float _pad3;
+};
+
+struct FrameData {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 viewPos; float _pad0;
+	DirLightStd140 dirLight;
+	PointLightStd140 spotLight;
+	/* point lights come from the cluster texture buffers, see LightClusters.h */
+	glm::vec4 clusterScale; // tile = gl_FragCoord.xy * xy, slice = log(view depth) * z + w
+	unsigned int clusterGrid[4]; // uvec4 : grid x, y, z, point light count
+};
+
+static_assert(sizeof(DirLightStd140) == 64, "DirLight must match std140 layout");
+static_assert(sizeof(PointLightStd140) == 96, "PointLight must match std140 layout");
+static_assert(offsetof(PointLightStd140, cutOff) == 28, "PointLight must match std140 layout");
+static_assert(offsetof(PointLightStd140, ambient) == 48, "PointLight must match std140 layout");
+static_assert(offsetof(FrameData, dirLight) == 144, "FrameData must match std140 layout");
+static_assert(offsetof(FrameData, spotLight) == 208, "FrameData must match std140 layout");
+static_assert(offsetof(FrameData, clusterScale) == 304, "FrameData must match std140 layout");
+static_assert(sizeof(FrameData) == 336, "FrameData must match std140 layout");
+
+#endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+#include <cstdio>
+
+static std::string jsonString(const std::string& text) {
+	std::string out = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		}
+		else if ((unsigned char)c < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out += escaped;
+		}
+		else
+			out += c;
+	}
+	return out + "\"";
+}
+
+static std::string jsonNumber(double value) {
+	char text[32];
+	snprintf(text, sizeof(text), "%.4f", std::isfinite(value) ? value : 0.0);
+	return text;
+}
+
+void FrameStats::reserve(const std::string& series, size_t count) {
+	_series[series].reserve(count);
+}
+
+void FrameStats::add(const std::string& series, double ms) {
+	_series[series].push_back(ms);
+}
+
+void FrameStats::setInfo(const std::string& key, const std::string& value) {
+	_info.emplace_back(key, jsonString(value));
+}
+
+void FrameStats::setInfo(const std::string& key, double value) {
+	char text[32];
+	snprintf(text, sizeof(text), "%.10g", std::isfinite(value) ? value : 0.0); // counts stay integers
+	_info.emplace_back(key, text);
+}
+
+FrameStats::Summary FrameStats::summary(const std::string& series) const {
+	Summary summary;
+	auto found = _series.find(series);
+	if (found == _series.end() || found->second.empty())
+		return summary;
+
+	std::vector<double> sorted = found->second;
+	std::sort(sorted.begin(), sorted.end());
+	size_t n = sorted.size();
+	auto percentile = [&](double p) {
+		size_t rank = (size_t)std::ceil(p / 100.0 * n);
+		return sorted[std::min(n, std::max<size_t>(rank, 1)) - 1];
+	};
+
+	double sum = 0.0;
+	for (double ms : sorted)
+		sum += ms;
+	summary.samples = (unsigned int)n;
+	summary.mean = sum / n;
+	summary.p50 = percentile(50.0);
+	summary.p95 = percentile(95.0);
+	summary.p99 = percentile(99.0);
+	summary.min = sorted.front();
+	summary.max = sorted.back();
+	return summary;
+}
+
+bool FrameStats::writeJSON(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "ERROR::FRAME_STATS::FILE_NOT_WRITABLE " << path << std::endl;
+		return false;
+	}
+
+	std::vector<std::string> entries;
+	for (const auto& info : _info)
+		entries.push_back(jsonString(info.first) + ": " + info.second);
+	for (const auto& series : _series) {
+		Summary s = summary(series.first);
+		entries.push_back(jsonString(series.first) + ": { \"samples\": " + std::to_string(s.samples)
+			+ ", \"mean\": " + jsonNumber(s.mean) + ", \"p50\": " + jsonNumber(s.p50)
+			+ ", \"p95\": " + jsonNumber(s.p95) + ", \"p99\": " + jsonNumber(s.p99)
+			+ ", \"min\": " + jsonNumber(s.min) + ", \"max\": " + jsonNumber(s.max) + " }");
+	}
+
+	file << "{\n";
+	for (size_t i = 0; i < entries.size(); ++i)
+		file << "\t" << entries[i] << (i + 1 < entries.size() ? ",\n" : "\n");
+	file << "}\n";
+	return (bool)file;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+/* Collects per-frame timings in named series ("frame_ms", ...) plus a few info
+fields, and writes them summarized as JSON for the perf gates :
+	{ "info key" : value, ..., "series" : { "mean", "p50", "p95", "p99", "min", "max", "samples" } } */
+class FrameStats
+{
+public:
+	struct Summary {
+		unsigned int samples = 0;
+		double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, min = 0.0, max = 0.0;
+	};
+
+	void reserve(const std::string& series, size_t count);
+	void add(const std::string& series, double ms);
+	void setInfo(const std::string& key, const std::string& value);
+	void setInfo(const std::string& key, double value);
+
+	Summary summary(const std::string& series) const; // nearest-rank percentiles
+	bool writeJSON(const std::string& path) const;
+
+private:
+	std::map<std::string, std::vector<double>> _series;
+	std::vector<std::pair<std::string, std::string>> _info; // value already JSON encoded, kept in insertion order
+};
+
+#endif
\ No newline at end of file
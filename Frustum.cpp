@@ -0,0 +1,131 @@
+#include "Frustum.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_SSE2 1
+#endif
+
+static glm::vec4 makePlane(const glm::vec3& normal, const glm::vec3& point) {
+	glm::vec3 n = glm::normalize(normal);
+	return glm::vec4(n, -glm::dot(n, point));
+}
+
+Frustum Frustum::fromCamera(Camera& camera) {
+	glm::vec3 pos = camera.getPos();
+	glm::vec3 front = glm::normalize(camera.getFront());
+	glm::vec3 right = glm::normalize(glm::cross(front, camera.getUp())); // same basis as glm::lookAt
+	glm::vec3 up = glm::cross(right, front);
+
+	float tanV = tanf(glm::radians(camera.getFOV()) * 0.5f);
+	float tanH = tanV * camera.aspect;
+
+	Frustum frustum;
+	/* side planes go through the eye, built from the edge directions of the view volume */
+	frustum.planes[LEFT] = makePlane(glm::cross(front - right * tanH, up), pos);
+	frustum.planes[RIGHT] = makePlane(glm::cross(up, front + right * tanH), pos);
+	frustum.planes[BOTTOM] = makePlane(glm::cross(right, front - up * tanV), pos);
+	frustum.planes[TOP] = makePlane(glm::cross(front + up * tanV, right), pos);
+	frustum.planes[NEAR_PLANE] = makePlane(front, pos + front * camera.zNear);
+	frustum.planes[FAR_PLANE] = makePlane(-front, pos + front * camera.zFar);
+	return frustum;
+}
+
+void BoundsSoA::resize(size_t n) {
+	count = n;
+	size_t padded = (n + 7) & ~(size_t)7;
+	x.assign(padded, 0.0f);
+	y.assign(padded, 0.0f);
+	z.assign(padded, 0.0f);
+	radius.assign(padded, 0.0f);
+}
+
+void BoundsSoA::set(size_t i, const glm::vec3& center, float r) {
+	x[i] = center.x;
+	y[i] = center.y;
+	z[i] = center.z;
+	radius[i] = r;
+}
+
+/* Push the set bits of a lane mask as indices */
+static inline void emitVisible(unsigned int mask, uint32_t base, std::vector<uint32_t>& visible) {
+	while (mask) {
+		unsigned int lane = 0;
+		while (!(mask & (1u << lane)))
+			lane++;
+		visible.push_back(base + lane);
+		mask &= mask - 1;
+	}
+}
+
+CullStats cullSpheres(const Frustum& frustum, const BoundsSoA& bounds, std::vector<uint32_t>& visible) {
+	visible.clear();
+	const size_t count = bounds.count;
+	size_t i = 0;
+
+#if defined(FRUSTUM_AVX)
+	__m256 px[6], py[6], pz[6], pw[6];
+	for (int p = 0; p < 6; ++p) {
+		px[p] = _mm256_set1_ps(frustum.planes[p].x);
+		py[p] = _mm256_set1_ps(frustum.planes[p].y);
+		pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+		pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+	for (; i + 8 <= count; i += 8) {
+		__m256 x = _mm256_loadu_ps(&bounds.x[i]);
+		__m256 y = _mm256_loadu_ps(&bounds.y[i]);
+		__m256 z = _mm256_loadu_ps(&bounds.z[i]);
+		__m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&bounds.radius[i]));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p) {
+			/* signed distance of the center, culled when below -radius */
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, px[p]), _mm256_mul_ps(y, py[p])),
+				_mm256_add_ps(_mm256_mul_ps(z, pz[p]), pw[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+		}
+		emitVisible((unsigned int)_mm256_movemask_ps(inside), (uint32_t)i, visible);
+	}
+#elif defined(FRUSTUM_SSE2)
+	__m128 px[6], py[6], pz[6], pw[6];
+	for (int p = 0; p < 6; ++p) {
+		px[p] = _mm_set1_ps(frustum.planes[p].x);
+		py[p] = _mm_set1_ps(frustum.planes[p].y);
+		pz[p] = _mm_set1_ps(frustum.planes[p].z);
+		pw[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(&bounds.x[i]);
+		__m128 y = _mm_loadu_ps(&bounds.y[i]);
+		__m128 z = _mm_loadu_ps(&bounds.z[i]);
+		__m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i]));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p) {
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, px[p]), _mm_mul_ps(y, py[p])),
+				_mm_add_ps(_mm_mul_ps(z, pz[p]), pw[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+		}
+		emitVisible((unsigned int)_mm_movemask_ps(inside), (uint32_t)i, visible);
+	}
+#endif
+
+	/* scalar tail (and the whole range without SIMD) */
+	for (; i < count; ++i) {
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; ++p) {
+			const glm::vec4& plane = frustum.planes[p];
+			float d = plane.x * bounds.x[i] + plane.y * bounds.y[i] + plane.z * bounds.z[i] + plane.w;
+			inside = d >= -bounds.radius[i];
+		}
+		if (inside)
+			visible.push_back((uint32_t)i);
+	}
+
+	CullStats stats;
+	stats.visible = (unsigned int)visible.size();
+	stats.culled = (unsigned int)(count - visible.size());
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "Camera.h"
+
+/* View frustum as 6 planes, normals pointing inside : dot(n, p) + w >= 0 is inside */
+struct Frustum {
+	enum { LEFT, RIGHT, BOTTOM, TOP, NEAR_PLANE, FAR_PLANE };
+	glm::vec4 planes[6];
+
+	static Frustum fromCamera(Camera& camera);
+};
+
+/* Bounding spheres in structure-of-arrays form so the culling pass can load
+4 or 8 of them per instruction. Arrays are padded to a multiple of 8. */
+struct BoundsSoA {
+	std::vector<float> x, y, z, radius;
+	size_t count = 0;
+
+	void resize(size_t n);
+	void set(size_t i, const glm::vec3& center, float r);
+};
+
+struct CullStats {
+	unsigned int visible = 0;
+	unsigned int culled = 0;
+};
+
+/* Appends the indices of the spheres intersecting the frustum to visible (cleared first).
+Uses AVX when compiled with it, SSE2 otherwise on x86, scalar elsewhere. */
+CullStats cullSpheres(const Frustum& frustum, const BoundsSoA& bounds, std::vector<uint32_t>& visible);
+
+#endif
\ No newline at end of file
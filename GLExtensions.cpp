@@ -0,0 +1,49 @@
+#include "GLExtensions.h"
+
+#include <cstring>
+
+GLExtensions GLExt;
+
+bool hasGLExtension(const char* name) {
+	int count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (int i = 0; i < count; ++i) {
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+static bool versionAtLeast(int major, int minor) {
+	return GLExt.major > major || (GLExt.major == major && GLExt.minor >= minor);
+}
+
+void loadGLExtensions(GLADloadproc load) {
+	glGetIntegerv(GL_MAJOR_VERSION, &GLExt.major);
+	glGetIntegerv(GL_MINOR_VERSION, &GLExt.minor);
+
+	/* Program binaries ================================================================ */
+	if (versionAtLeast(4, 1) || hasGLExtension("GL_ARB_get_program_binary")) {
+		GLExt.GetProgramBinary = (PFN_GETPROGRAMBINARY)load("glGetProgramBinary");
+		GLExt.ProgramBinary = (PFN_PROGRAMBINARY)load("glProgramBinary");
+		GLExt.ProgramParameteri = (PFN_PROGRAMPARAMETERI)load("glProgramParameteri");
+
+		int formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		// some drivers expose the entry points but accept no format at all
+		GLExt.programBinary = GLExt.GetProgramBinary && GLExt.ProgramBinary
+			&& GLExt.ProgramParameteri && formats > 0;
+	}
+
+	/* Parallel shader compile ========================================================= */
+	if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+		GLExt.MaxShaderCompilerThreads = (PFN_MAXSHADERCOMPILERTHREADS)load("glMaxShaderCompilerThreadsKHR");
+	else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+		GLExt.MaxShaderCompilerThreads = (PFN_MAXSHADERCOMPILERTHREADS)load("glMaxShaderCompilerThreadsARB");
+	GLExt.parallelShaderCompile = GLExt.MaxShaderCompilerThreads != nullptr;
+
+	/* Texture compression =========================================================== */
+	GLExt.textureCompressionS3TC = hasGLExtension("GL_EXT_texture_compression_s3tc");
+	GLExt.textureCompressionBPTC = versionAtLeast(4, 2) || hasGLExtension("GL_ARB_texture_compression_bptc");
+}
\ No newline at end of file
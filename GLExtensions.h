@@ -0,0 +1,60 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+/* glad.c is generated for the 4.0 core profile only, so the entry points we use
+from newer versions / extensions are loaded here by hand. Check the flag before
+calling any of the function pointers. */
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+typedef void (APIENTRYP PFN_GETPROGRAMBINARY)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFN_PROGRAMBINARY)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFN_PROGRAMPARAMETERI)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFN_MAXSHADERCOMPILERTHREADS)(GLuint count);
+
+struct GLExtensions {
+	int major = 0, minor = 0; // context version
+
+	/* GL 4.1 / ARB_get_program_binary */
+	bool programBinary = false;
+	PFN_GETPROGRAMBINARY GetProgramBinary = nullptr;
+	PFN_PROGRAMBINARY ProgramBinary = nullptr;
+	PFN_PROGRAMPARAMETERI ProgramParameteri = nullptr;
+
+	/* KHR_parallel_shader_compile (or the ARB twin, same tokens) */
+	bool parallelShaderCompile = false;
+	PFN_MAXSHADERCOMPILERTHREADS MaxShaderCompilerThreads = nullptr;
+
+	/* Compressed texture formats, uploaded with the core glCompressedTexImage2D */
+	bool textureCompressionS3TC = false; // EXT_texture_compression_s3tc : BC1 ~ BC3
+	bool textureCompressionBPTC = false; // GL 4.2 / ARB_texture_compression_bptc : BC7
+};
+
+extern GLExtensions GLExt;
+
+void loadGLExtensions(GLADloadproc load); // call once right after gladLoadGLLoader
+bool hasGLExtension(const char* name);
+
+#endif
\ No newline at end of file
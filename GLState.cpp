@@ -0,0 +1,203 @@
+#include "GLState.h"
+
+GLState glState;
+
+GLState::GLState() {
+	invalidate();
+}
+
+int GLState::bufferSlot(GLenum target) {
+	switch (target) {
+	case GL_ARRAY_BUFFER: return ARRAY_BUFFER;
+	case GL_ELEMENT_ARRAY_BUFFER: return ELEMENT_ARRAY_BUFFER;
+	case GL_UNIFORM_BUFFER: return UNIFORM_BUFFER;
+	case GL_PIXEL_UNPACK_BUFFER: return PIXEL_UNPACK_BUFFER;
+	case GL_TEXTURE_BUFFER: return TEXTURE_BUFFER;
+	default: return -1; // not tracked, always forwarded
+	}
+}
+
+int GLState::textureSlot(GLenum target) {
+	switch (target) {
+	case GL_TEXTURE_2D: return TEXTURE_2D;
+	case GL_TEXTURE_BUFFER: return TEXTURE_BUFFER_TARGET;
+	case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP;
+	case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY;
+	default: return -1;
+	}
+}
+
+int GLState::capSlot(GLenum cap) {
+	switch (cap) {
+	case GL_DEPTH_TEST: return DEPTH_TEST;
+	case GL_BLEND: return BLEND;
+	case GL_CULL_FACE: return CULL_FACE;
+	case GL_STENCIL_TEST: return STENCIL_TEST;
+	case GL_SCISSOR_TEST: return SCISSOR_TEST;
+	case GL_DEPTH_CLAMP: return DEPTH_CLAMP;
+	default: return -1;
+	}
+}
+
+void GLState::useProgram(unsigned int program) {
+	if (_program == program) {
+		_frame.elided++;
+		return;
+	}
+	glUseProgram(program);
+	_program = program;
+	_frame.issued++;
+}
+
+void GLState::bindVertexArray(unsigned int vao) {
+	if (_vao == vao) {
+		_frame.elided++;
+		return;
+	}
+	glBindVertexArray(vao);
+	_vao = vao;
+	_buffers[ELEMENT_ARRAY_BUFFER] = UNKNOWN; // the element buffer binding belongs to the VAO
+	_frame.issued++;
+}
+
+void GLState::bindBuffer(GLenum target, unsigned int buffer) {
+	int slot = bufferSlot(target);
+	if (slot >= 0 && _buffers[slot] == buffer) {
+		_frame.elided++;
+		return;
+	}
+	glBindBuffer(target, buffer);
+	if (slot >= 0)
+		_buffers[slot] = buffer;
+	_frame.issued++;
+}
+
+void GLState::bindBufferBase(GLenum target, unsigned int index, unsigned int buffer) {
+	/* indexed bindings are set up once, not worth tracking; the generic binding changes too */
+	glBindBufferBase(target, index, buffer);
+	int slot = bufferSlot(target);
+	if (slot >= 0)
+		_buffers[slot] = buffer;
+	_frame.issued++;
+}
+
+void GLState::bindFramebuffer(GLenum target, unsigned int framebuffer) {
+	bool draw = target != GL_READ_FRAMEBUFFER;
+	bool read = target != GL_DRAW_FRAMEBUFFER;
+	if ((!draw || _drawFramebuffer == framebuffer) && (!read || _readFramebuffer == framebuffer)) {
+		_frame.elided++;
+		return;
+	}
+	glBindFramebuffer(target, framebuffer);
+	if (draw)
+		_drawFramebuffer = framebuffer;
+	if (read)
+		_readFramebuffer = framebuffer;
+	_frame.issued++;
+}
+
+void GLState::activeTexture(unsigned int unit) {
+	if (_activeUnit == unit) {
+		_frame.elided++;
+		return;
+	}
+	glActiveTexture(GL_TEXTURE0 + unit);
+	_activeUnit = unit;
+	_frame.issued++;
+}
+
+void GLState::bindTexture(unsigned int unit, GLenum target, unsigned int texture) {
+	int slot = textureSlot(target);
+	if (unit < MAX_TEXTURE_UNITS && slot >= 0 && _textures[unit][slot] == texture) {
+		_frame.elided++;
+		return;
+	}
+	activeTexture(unit);
+	glBindTexture(target, texture);
+	if (unit < MAX_TEXTURE_UNITS && slot >= 0)
+		_textures[unit][slot] = texture;
+	_frame.issued++;
+}
+
+void GLState::setEnabled(GLenum cap, bool enabled) {
+	int slot = capSlot(cap);
+	unsigned int value = enabled ? 1 : 0;
+	if (slot >= 0 && _caps[slot] == value) {
+		_frame.elided++;
+		return;
+	}
+	if (enabled)
+		glEnable(cap);
+	else
+		glDisable(cap);
+	if (slot >= 0)
+		_caps[slot] = value;
+	_frame.issued++;
+}
+
+void GLState::enable(GLenum cap) {
+	setEnabled(cap, true);
+}
+
+void GLState::disable(GLenum cap) {
+	setEnabled(cap, false);
+}
+
+void GLState::deleteProgram(unsigned int program) {
+	glDeleteProgram(program);
+	if (_program == program)
+		_program = UNKNOWN; // stays current until another program is used
+}
+
+void GLState::deleteVertexArray(unsigned int vao) {
+	glDeleteVertexArrays(1, &vao);
+	if (_vao == vao)
+		_vao = 0;
+}
+
+void GLState::deleteBuffer(unsigned int buffer) {
+	glDeleteBuffers(1, &buffer);
+	for (unsigned int& bound : _buffers) {
+		if (bound == buffer)
+			bound = 0;
+	}
+}
+
+void GLState::deleteTexture(unsigned int texture) {
+	glDeleteTextures(1, &texture);
+	for (auto& unit : _textures) {
+		for (unsigned int& bound : unit) {
+			if (bound == texture)
+				bound = 0;
+		}
+	}
+}
+
+void GLState::deleteFramebuffer(unsigned int framebuffer) {
+	glDeleteFramebuffers(1, &framebuffer);
+	if (_drawFramebuffer == framebuffer)
+		_drawFramebuffer = 0; // falls back to the default framebuffer
+	if (_readFramebuffer == framebuffer)
+		_readFramebuffer = 0;
+}
+
+void GLState::invalidate() {
+	_program = UNKNOWN;
+	_vao = UNKNOWN;
+	_activeUnit = UNKNOWN;
+	_drawFramebuffer = UNKNOWN;
+	_readFramebuffer = UNKNOWN;
+	for (unsigned int& bound : _buffers)
+		bound = UNKNOWN;
+	for (auto& unit : _textures) {
+		for (unsigned int& bound : unit)
+			bound = UNKNOWN;
+	}
+	for (unsigned int& cap : _caps)
+		cap = UNKNOWN;
+}
+
+void GLState::beginFrame() {
+	_lastFrame = _frame;
+	_frame = Counters();
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+/* Thin shadow of the GL binding state : remembers the bound program, VAO, buffers, framebuffers,
+textures per unit and enable flags, and drops calls that would not change anything.
+Everything that binds at runtime must go through here, otherwise the shadow goes
+stale; call invalidate() after code that talks to GL directly. */
+class GLState
+{
+public:
+	static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+	struct Counters {
+		unsigned int issued = 0; // calls forwarded to GL
+		unsigned int elided = 0; // redundant calls dropped
+	};
+
+	GLState();
+
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vao);
+	void bindBuffer(GLenum target, unsigned int buffer);
+	void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+	void bindFramebuffer(GLenum target, unsigned int framebuffer); // GL_FRAMEBUFFER sets both draw & read
+	void activeTexture(unsigned int unit);
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+	void enable(GLenum cap);
+	void disable(GLenum cap);
+	void setEnabled(GLenum cap, bool enabled);
+
+	/* Deleting a bound object unbinds it in GL, and its name may be recycled */
+	void deleteProgram(unsigned int program);
+	void deleteVertexArray(unsigned int vao);
+	void deleteBuffer(unsigned int buffer);
+	void deleteTexture(unsigned int texture);
+	void deleteFramebuffer(unsigned int framebuffer);
+
+	void invalidate(); // forget everything, next call of each kind is always issued
+
+	void beginFrame(); // latch the counters of the previous frame and reset them
+	const Counters& frameCounters() const { return _lastFrame; }
+
+private:
+	static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+
+	enum BufferSlot { ARRAY_BUFFER, ELEMENT_ARRAY_BUFFER, UNIFORM_BUFFER, PIXEL_UNPACK_BUFFER,
+		TEXTURE_BUFFER, BUFFER_SLOTS };
+	enum TextureSlot { TEXTURE_2D, TEXTURE_BUFFER_TARGET, TEXTURE_CUBE_MAP, TEXTURE_2D_ARRAY, TEXTURE_SLOTS };
+	enum CapSlot { DEPTH_TEST, BLEND, CULL_FACE, STENCIL_TEST, SCISSOR_TEST, DEPTH_CLAMP, CAP_SLOTS };
+
+	unsigned int _program;
+	unsigned int _vao;
+	unsigned int _activeUnit;
+	unsigned int _drawFramebuffer, _readFramebuffer;
+	unsigned int _buffers[BUFFER_SLOTS];
+	unsigned int _textures[MAX_TEXTURE_UNITS][TEXTURE_SLOTS];
+	unsigned int _caps[CAP_SLOTS]; // 0, 1 or UNKNOWN
+
+	Counters _frame, _lastFrame;
+
+	static int bufferSlot(GLenum target);
+	static int textureSlot(GLenum target);
+	static int capSlot(GLenum cap);
+};
+
+extern GLState glState;
+
+#endif
\ No newline at end of file
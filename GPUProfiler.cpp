@@ -0,0 +1,120 @@
+#include "GPUProfiler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+
+GPUProfiler gpuProfiler;
+
+GPUProfiler::Scope::Scope(const char* name) : _index(gpuProfiler.beginScope(name)) {}
+
+GPUProfiler::Scope::~Scope() {
+	gpuProfiler.endScope(_index);
+}
+
+void GPUProfiler::init() {
+	/* ARB_timer_query is core in 3.3, but a driver may still report a 0 bit counter */
+	int bits = 0;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+	_available = bits > 0;
+	if (!_available) {
+		std::cout << "GPU timer queries unavailable, GPU scopes are disabled" << std::endl;
+		return;
+	}
+
+	for (Frame& frame : _frames)
+		glGenQueries(MAX_SCOPES * 2, frame.queries);
+	std::cout << "GPU timer queries : " << bits << " bit timestamps, read back "
+		<< FRAME_LATENCY << " frames late" << std::endl;
+}
+
+bool GPUProfiler::beginFrame() {
+	if (!_available)
+		return false;
+
+	/* this slot was last used FRAME_LATENCY frames ago */
+	_current = &_frames[_frameIndex % FRAME_LATENCY];
+	bool collected = _current->pending && collect(*_current);
+	_current->pending = false;
+	_current->scopeCount = 0;
+	_current->lastQuery = 0;
+	return collected;
+}
+
+void GPUProfiler::endFrame() {
+	if (!_available || !_current)
+		return;
+	_current->pending = _current->lastQuery != 0; // at least one scope was closed
+	_current = nullptr;
+	_frameIndex++;
+}
+
+int GPUProfiler::beginScope(const char* name) {
+	if (!_current || _current->scopeCount == MAX_SCOPES)
+		return -1;
+	int index = (int)_current->scopeCount++;
+	_current->names[index] = name;
+	glQueryCounter(_current->queries[index * 2], GL_TIMESTAMP);
+	return index;
+}
+
+void GPUProfiler::endScope(int scope) {
+	if (!_current || scope < 0)
+		return;
+	_current->lastQuery = _current->queries[scope * 2 + 1];
+	glQueryCounter(_current->lastQuery, GL_TIMESTAMP);
+}
+
+const GPUProfiler::ScopeStats* GPUProfiler::find(const char* name) const {
+	for (const ScopeStats& stats : _stats) {
+		if (strcmp(stats.name, name) == 0)
+			return &stats;
+	}
+	return nullptr;
+}
+
+bool GPUProfiler::collect(Frame& frame) {
+	/* queries complete in order : the last one issued being ready means all are.
+	If even that is still pending the frame is dropped rather than waited for. */
+	int ready = 0;
+	glGetQueryObjectiv(frame.lastQuery, GL_QUERY_RESULT_AVAILABLE, &ready);
+	if (!ready) {
+		_dropped++;
+		return false;
+	}
+
+	const size_t slot = _collected % WINDOW_FRAMES;
+	for (ScopeHistory& history : _history)
+		history.frameMs[slot] = 0.0;
+
+	for (unsigned int i = 0; i < frame.scopeCount; ++i) {
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+		auto found = std::find_if(_history.begin(), _history.end(),
+			[&](const ScopeHistory& history) { return strcmp(history.name, frame.names[i]) == 0; });
+		if (found == _history.end()) {
+			_history.push_back(ScopeHistory()); // zeroed window
+			_history.back().name = frame.names[i];
+			found = _history.end() - 1;
+		}
+		found->frameMs[slot] += end > begin ? (end - begin) / 1.0e6 : 0.0; // ns
+	}
+	_collected++;
+
+	const size_t filled = (size_t)std::min<uint64_t>(_collected, WINDOW_FRAMES);
+	_stats.resize(_history.size());
+	for (size_t s = 0; s < _history.size(); ++s) {
+		double sum = 0.0, maxMs = 0.0;
+		for (size_t f = 0; f < filled; ++f) {
+			sum += _history[s].frameMs[f];
+			maxMs = std::max(maxMs, _history[s].frameMs[f]);
+		}
+		_stats[s].name = _history[s].name;
+		_stats[s].lastMs = _history[s].frameMs[slot];
+		_stats[s].avgMs = sum / filled;
+		_stats[s].maxMs = maxMs;
+	}
+	return true;
+}
\ No newline at end of file
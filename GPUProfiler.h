@@ -0,0 +1,85 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+
+/* GPU time per scope from GL_TIMESTAMP queries.
+Each scope writes a timestamp query at its start and end. Timestamps, unlike
+GL_TIME_ELAPSED, may nest and overlap. The queries of a frame are read back
+FRAME_LATENCY frames later, when the GPU has long finished them, so reading
+never stalls the pipeline. The published numbers are therefore a few frames
+old. Without timer query support (0 counter bits) every call is a no-op and
+available() is false. */
+class GPUProfiler
+{
+public:
+	static const unsigned int FRAME_LATENCY = 4; // frames in flight before their queries are read
+	static const unsigned int MAX_SCOPES = 16; // per frame, further scopes are not timed
+	static const unsigned int WINDOW_FRAMES = 120;
+
+	struct ScopeStats {
+		const char* name = nullptr;
+		double lastMs = 0.0; // newest frame read back
+		double avgMs = 0.0; // per frame, over the window
+		double maxMs = 0.0;
+	};
+
+	class Scope {
+	public:
+		explicit Scope(const char* name);
+		~Scope();
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		int _index;
+	};
+
+	void init(); // once the context is current
+	bool available() const { return _available; }
+
+	/* beginFrame() returns true when it read back an older frame, scopeStats() then changed */
+	bool beginFrame();
+	void endFrame();
+	int beginScope(const char* name); // -1 when not timed
+	void endScope(int scope);
+
+	const std::vector<ScopeStats>& scopeStats() const { return _stats; }
+	const ScopeStats* find(const char* name) const;
+	unsigned int droppedFrames() const { return _dropped; } // results still pending after FRAME_LATENCY frames
+
+private:
+	struct Frame {
+		unsigned int queries[MAX_SCOPES * 2]; // begin & end timestamp of each scope
+		const char* names[MAX_SCOPES];
+		unsigned int scopeCount = 0;
+		unsigned int lastQuery = 0; // issued last, scopes may nest
+		bool pending = false;
+	};
+
+	struct ScopeHistory {
+		const char* name;
+		double frameMs[WINDOW_FRAMES];
+	};
+
+	bool _available = false;
+	Frame _frames[FRAME_LATENCY];
+	Frame* _current = nullptr;
+	uint64_t _frameIndex = 0;
+	uint64_t _collected = 0;
+	unsigned int _dropped = 0;
+	std::vector<ScopeHistory> _history;
+	std::vector<ScopeStats> _stats;
+
+	bool collect(Frame& frame);
+};
+
+extern GPUProfiler gpuProfiler;
+
+#define GPU_SCOPE_CONCAT_(a, b) a##b
+#define GPU_SCOPE_CONCAT(a, b) GPU_SCOPE_CONCAT_(a, b)
+#define GPU_SCOPE(name) GPUProfiler::Scope GPU_SCOPE_CONCAT(gpuScope, __LINE__)(name)
+
+#endif
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* FNV-1a 64, for the keys of the on-disk caches and the replay pose checksum */
+const uint64_t HASH_SEED = 0xcbf29ce484222325ULL;
+
+inline uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+#endif
\ No newline at end of file
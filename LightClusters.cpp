@@ -0,0 +1,266 @@
+#include "LightClusters.h"
+#include "GLState.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <cmath>
+
+LightClusters::~LightClusters() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_wake.notify_all();
+	for (std::thread& worker : _workers)
+		worker.join();
+}
+
+float LightClusters::attenuationRadius(const ClusterLight& light) {
+	glm::vec3 peak = light.ambient + light.diffuse + light.specular;
+	float brightest = std::max(peak.x, std::max(peak.y, peak.z));
+	if (brightest <= 0.0f)
+		return 0.0f;
+
+	/* brightest / (c + l d + q d^2) = LIGHT_CUTOFF  ->  q d^2 + l d + (c - brightest / LIGHT_CUTOFF) = 0 */
+	float c = light.constant - brightest / LIGHT_CUTOFF;
+	if (c >= 0.0f)
+		return 0.0f; // never bright enough to show
+	if (light.quadratic <= 0.0f)
+		return light.linear > 0.0f ? -c / light.linear : INFINITY;
+	return (-light.linear + sqrtf(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+}
+
+void LightClusters::init(unsigned int workerCount) {
+	GLint maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	if (maxTexels > 0)
+		_maxTexels = (unsigned int)maxTexels;
+
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	glGenBuffers(3, _buffers);
+	glGenTextures(3, _textures);
+	for (int i = 0; i < 3; ++i) {
+		glState.bindBuffer(GL_TEXTURE_BUFFER, _buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW); // a buffer texture needs a data store
+		glState.bindTexture(LIGHT_DATA_UNIT + i, GL_TEXTURE_BUFFER, _textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], _buffers[i]);
+	}
+	glState.bindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	workerCount = std::min(workerCount, GRID_Z - 1);
+	for (unsigned int i = 0; i < workerCount; ++i)
+		_workers.emplace_back(&LightClusters::workerLoop, this, i);
+	std::cout << "Light clusters : " << GRID_X << "x" << GRID_Y << "x" << GRID_Z << ", "
+		<< workerCount + 1 << " binning threads" << std::endl;
+}
+
+void LightClusters::setLights(const std::vector<ClusterLight>& lights) {
+	_lights = lights;
+	for (ClusterLight& light : _lights)
+		light.radius = attenuationRadius(light);
+	_lightsDirty = true;
+}
+
+float LightClusters::sliceDepth(unsigned int slice) const {
+	return _zNear * powf(_zFar / _zNear, (float)slice / GRID_Z);
+}
+
+void LightClusters::build(const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar) {
+	_zNear = zNear;
+	_zFar = zFar;
+	_projX = projection[0][0];
+	_projY = projection[1][1];
+	_clusters.resize(CLUSTER_COUNT * 2);
+
+	/* view space once per light, the slices only read it */
+	const float sliceScale = GRID_Z / logf(zFar / zNear);
+	_viewLights.resize(_lights.size());
+	for (size_t i = 0; i < _lights.size(); ++i) {
+		const ClusterLight& light = _lights[i];
+		glm::vec4 p = view * glm::vec4(light.position, 1.0f);
+		ViewLight& v = _viewLights[i];
+		v.x = p.x;
+		v.y = p.y;
+		v.depth = -p.z; // the camera looks down -z
+		v.radius = light.radius;
+		float nearDepth = v.depth - v.radius, farDepth = v.depth + v.radius;
+		if (farDepth < zNear || nearDepth > zFar || v.radius <= 0.0f) {
+			v.firstSlice = 1;
+			v.lastSlice = 0; // empty range
+			continue;
+		}
+		v.firstSlice = nearDepth <= zNear ? 0 : std::min((int)(logf(nearDepth / zNear) * sliceScale), (int)GRID_Z - 1);
+		v.lastSlice = farDepth >= zFar ? (int)GRID_Z - 1 : std::min((int)(logf(farDepth / zNear) * sliceScale), (int)GRID_Z - 1);
+	}
+
+	/* wake the workers and bin along with them */
+	_nextSlice.store(0, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_generation++;
+		_busyWorkers = (unsigned int)_workers.size();
+	}
+	_wake.notify_all();
+	binSlices();
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_done.wait(lock, [this] { return _busyWorkers == 0; });
+	}
+
+	/* slice offsets are local, concatenate the lists in slice order */
+	_indices.clear();
+	_stats = Stats();
+	_stats.lights = (unsigned int)_lights.size();
+	const unsigned int clustersPerSlice = GRID_X * GRID_Y;
+	for (unsigned int z = 0; z < GRID_Z; ++z) {
+		const uint32_t base = (uint32_t)_indices.size();
+		for (unsigned int c = z * clustersPerSlice; c < (z + 1) * clustersPerSlice; ++c) {
+			uint32_t& offset = _clusters[c * 2];
+			uint32_t& count = _clusters[c * 2 + 1];
+			offset += base;
+			if (offset + count > _maxTexels) {
+				uint32_t kept = offset < _maxTexels ? _maxTexels - offset : 0;
+				_stats.dropped += count - kept;
+				count = kept;
+			}
+			_stats.activeClusters += count > 0;
+			_stats.maxPerCluster = std::max(_stats.maxPerCluster, count);
+		}
+		_indices.insert(_indices.end(), _slices[z].indices.begin(), _slices[z].indices.end());
+	}
+	if (_indices.size() > _maxTexels)
+		_indices.resize(_maxTexels);
+	_stats.indices = (unsigned int)_indices.size();
+}
+
+void LightClusters::binSlices() {
+	PROFILE_ZONE("LightBin");
+	for (;;) {
+		unsigned int z = _nextSlice.fetch_add(1, std::memory_order_relaxed);
+		if (z >= GRID_Z)
+			return;
+		binSlice(z);
+	}
+}
+
+void LightClusters::binSlice(unsigned int z) {
+	const float depth0 = sliceDepth(z), depth1 = sliceDepth(z + 1);
+	Slice& slice = _slices[z];
+	slice.rects.clear();
+	slice.indices.clear();
+
+	/* screen rectangle of each light touching the slice. The part of the sphere inside
+	the slab fits in a view-space box; its corners project to the extremes of x / depth. */
+	for (uint32_t i = 0; i < (uint32_t)_viewLights.size(); ++i) {
+		const ViewLight& light = _viewLights[i];
+		if ((int)z < light.firstSlice || (int)z > light.lastSlice)
+			continue;
+		float dz = light.depth < depth0 ? depth0 - light.depth : (light.depth > depth1 ? light.depth - depth1 : 0.0f);
+		float r = sqrtf(std::max(light.radius * light.radius - dz * dz, 0.0f)); // widest cross section in the slab
+		float d0 = std::max(depth0, light.depth - light.radius);
+		float d1 = std::min(depth1, light.depth + light.radius);
+
+		float x0 = light.x - r, x1 = light.x + r;
+		float y0 = light.y - r, y1 = light.y + r;
+		float ndcX0 = _projX * x0 / (x0 < 0.0f ? d0 : d1);
+		float ndcX1 = _projX * x1 / (x1 < 0.0f ? d1 : d0);
+		float ndcY0 = _projY * y0 / (y0 < 0.0f ? d0 : d1);
+		float ndcY1 = _projY * y1 / (y1 < 0.0f ? d1 : d0);
+		if (ndcX1 < -1.0f || ndcX0 > 1.0f || ndcY1 < -1.0f || ndcY0 > 1.0f)
+			continue;
+
+		/* same mapping as the shader : tile = (ndc * 0.5 + 0.5) * grid */
+		TileRect rect;
+		rect.light = i;
+		rect.x0 = (uint16_t)std::clamp((int)floorf((ndcX0 * 0.5f + 0.5f) * GRID_X), 0, (int)GRID_X - 1);
+		rect.x1 = (uint16_t)std::clamp((int)floorf((ndcX1 * 0.5f + 0.5f) * GRID_X), 0, (int)GRID_X - 1);
+		rect.y0 = (uint16_t)std::clamp((int)floorf((ndcY0 * 0.5f + 0.5f) * GRID_Y), 0, (int)GRID_Y - 1);
+		rect.y1 = (uint16_t)std::clamp((int)floorf((ndcY1 * 0.5f + 0.5f) * GRID_Y), 0, (int)GRID_Y - 1);
+		slice.rects.push_back(rect);
+	}
+
+	/* count, prefix sum, fill : each cluster lists its lights in ascending order */
+	uint32_t* clusters = &_clusters[clusterIndex(0, 0, z) * 2];
+	for (unsigned int c = 0; c < GRID_X * GRID_Y; ++c)
+		clusters[c * 2 + 1] = 0;
+	for (const TileRect& rect : slice.rects) {
+		for (unsigned int y = rect.y0; y <= rect.y1; ++y)
+			for (unsigned int x = rect.x0; x <= rect.x1; ++x)
+				clusters[(x + GRID_X * y) * 2 + 1]++;
+	}
+	uint32_t total = 0;
+	for (unsigned int c = 0; c < GRID_X * GRID_Y; ++c) {
+		clusters[c * 2] = total;
+		total += clusters[c * 2 + 1];
+		clusters[c * 2 + 1] = 0; // refilled below
+	}
+	slice.indices.resize(total);
+	for (const TileRect& rect : slice.rects) {
+		for (unsigned int y = rect.y0; y <= rect.y1; ++y) {
+			for (unsigned int x = rect.x0; x <= rect.x1; ++x) {
+				uint32_t* cluster = &clusters[(x + GRID_X * y) * 2];
+				slice.indices[cluster[0] + cluster[1]++] = rect.light;
+			}
+		}
+	}
+}
+
+void LightClusters::workerLoop(unsigned int index) {
+	std::string name = "LightBin " + std::to_string(index + 1);
+	Profiler::setThreadName(name.c_str());
+
+	uint64_t seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [&] { return _quit || _generation != seen; });
+			if (_quit)
+				return;
+			seen = _generation;
+		}
+		binSlices();
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (--_busyWorkers == 0)
+				_done.notify_one();
+		}
+	}
+}
+
+void LightClusters::uploadLights() {
+	if (!_lightsDirty)
+		return;
+	/* 4 texels per light */
+	size_t count = std::min(_lights.size(), (size_t)_maxTexels / 4);
+	glState.bindBuffer(GL_TEXTURE_BUFFER, _buffers[0]);
+	glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(count, 1) * sizeof(ClusterLight), _lights.data(), GL_STATIC_DRAW);
+	_lightsDirty = false;
+}
+
+void LightClusters::upload() {
+	uploadLights();
+
+	glState.bindBuffer(GL_TEXTURE_BUFFER, _buffers[1]);
+	glBufferData(GL_TEXTURE_BUFFER, _clusters.size() * sizeof(uint32_t), _clusters.data(), GL_STREAM_DRAW);
+
+	/* orphan the index store, grow it in powers of two */
+	glState.bindBuffer(GL_TEXTURE_BUFFER, _buffers[2]);
+	while (_indexCapacity < _indices.size())
+		_indexCapacity *= 2;
+	glBufferData(GL_TEXTURE_BUFFER, _indexCapacity * sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+	if (!_indices.empty())
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, _indices.size() * sizeof(uint32_t), _indices.data());
+}
+
+void LightClusters::bindTextures() {
+	glState.bindTexture(LIGHT_DATA_UNIT, GL_TEXTURE_BUFFER, _textures[0]);
+	glState.bindTexture(CLUSTER_UNIT, GL_TEXTURE_BUFFER, _textures[1]);
+	glState.bindTexture(INDEX_UNIT, GL_TEXTURE_BUFFER, _textures[2]);
+}
+
+glm::vec4 LightClusters::shaderScale(float width, float height) const {
+	float sliceScale = GRID_Z / logf(_zFar / _zNear);
+	return glm::vec4(GRID_X / width, GRID_Y / height, sliceScale, -logf(_zNear) * sliceScale);
+}
\ No newline at end of file
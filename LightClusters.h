@@ -0,0 +1,133 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+/* Point light as stored in the light texture buffer : 4 RGBA32F texels,
+read back by unpackLight() in shaders/lighting.glsl in this order. */
+struct ClusterLight {
+	glm::vec3 position; float radius; // radius : where the attenuation falls below LIGHT_CUTOFF
+	glm::vec3 diffuse;  float constant;
+	glm::vec3 specular; float linear;
+	glm::vec3 ambient;  float quadratic;
+};
+
+static_assert(sizeof(ClusterLight) == 64, "ClusterLight must be 4 RGBA32F texels");
+
+/* Clustered forward lighting.
+The view frustum is split into GRID_X * GRID_Y screen tiles and GRID_Z depth
+slices, exponential in view depth so near clusters stay small. Every frame
+build() lists the point lights whose sphere of influence touches each cluster,
+upload() streams the lists into texture buffers (GL 3.3, no SSBO) and the
+fragment shader only loops over the lights of its own cluster.
+
+Depth slices are binned in parallel : workers take slices off a shared counter,
+each slice writes its own clusters and index list, and the lists are
+concatenated in slice order afterwards. */
+class LightClusters
+{
+public:
+	static const unsigned int GRID_X = 16;
+	static const unsigned int GRID_Y = 9;
+	static const unsigned int GRID_Z = 24;
+	static const unsigned int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+	static constexpr float LIGHT_CUTOFF = 1.0f / 256.0f; // below one step of an 8-bit channel
+
+	/* texture units of the buffers, after the material's diffuse & specular maps */
+	static const unsigned int LIGHT_DATA_UNIT = 2;
+	static const unsigned int CLUSTER_UNIT = 3;
+	static const unsigned int INDEX_UNIT = 4;
+
+	struct Stats {
+		unsigned int lights = 0;
+		unsigned int indices = 0; // light references over all clusters
+		unsigned int activeClusters = 0; // clusters with at least one light
+		unsigned int maxPerCluster = 0;
+		unsigned int dropped = 0; // references past GL_MAX_TEXTURE_BUFFER_SIZE
+	};
+
+	LightClusters() = default;
+	~LightClusters();
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	/* distance at which 1 / (constant + linear * d + quadratic * d^2) times the
+	brightest channel drops below LIGHT_CUTOFF */
+	static float attenuationRadius(const ClusterLight& light);
+
+	void init(unsigned int workerCount); // GL buffers & worker threads, once the context is current
+	void setLights(const std::vector<ClusterLight>& lights); // radius is filled in here
+	const std::vector<ClusterLight>& lights() const { return _lights; }
+
+	/* CPU binning against the camera of the frame, GL is not touched */
+	void build(const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar);
+	void upload(); // lights (when changed), clusters & indices
+	void uploadLights(); // only the light buffer, when changed : enough for the deferred light volumes
+	void bindTextures(); // onto LIGHT_DATA_UNIT, CLUSTER_UNIT & INDEX_UNIT
+
+	/* fragment -> cluster : tile = gl_FragCoord.xy * scale.xy, slice = log(depth) * scale.z + scale.w */
+	glm::vec4 shaderScale(float width, float height) const;
+
+	/* offset & count into indices() for each cluster, x fastest then y then z */
+	const std::vector<uint32_t>& clusters() const { return _clusters; }
+	const std::vector<uint32_t>& indices() const { return _indices; }
+	unsigned int clusterIndex(unsigned int x, unsigned int y, unsigned int z) const { return x + GRID_X * (y + GRID_Y * z); }
+	const Stats& stats() const { return _stats; }
+
+private:
+	/* light in view space, positive depth, with the depth slices it spans */
+	struct ViewLight {
+		float x, y, depth, radius;
+		int firstSlice, lastSlice;
+	};
+
+	struct TileRect {
+		uint32_t light;
+		uint16_t x0, x1, y0, y1;
+	};
+
+	/* output of one depth slice, kept between frames so binning does not allocate */
+	struct Slice {
+		std::vector<TileRect> rects;
+		std::vector<uint32_t> indices;
+	};
+
+	std::vector<ClusterLight> _lights;
+	bool _lightsDirty = false;
+	std::vector<ViewLight> _viewLights;
+	std::vector<uint32_t> _clusters; // 2 per cluster
+	std::vector<uint32_t> _indices;
+	Slice _slices[GRID_Z];
+	Stats _stats;
+	float _zNear = 0.1f, _zFar = 100.0f;
+	float _projX = 1.0f, _projY = 1.0f; // projection[0][0] & [1][1]
+
+	unsigned int _buffers[3] = { 0, 0, 0 }; // lights, clusters, indices
+	unsigned int _textures[3] = { 0, 0, 0 };
+	size_t _indexCapacity = 4; // uint32 in the index buffer, init() allocates 16 bytes
+	unsigned int _maxTexels = 65536; // GL 3.3 minimum of GL_MAX_TEXTURE_BUFFER_SIZE
+
+	/* workers sleep between frames, build() wakes them and joins in */
+	std::vector<std::thread> _workers;
+	std::mutex _mutex;
+	std::condition_variable _wake, _done;
+	uint64_t _generation = 0;
+	unsigned int _busyWorkers = 0;
+	bool _quit = false;
+	std::atomic<unsigned int> _nextSlice{ 0 };
+
+	float sliceDepth(unsigned int slice) const; // near boundary, sliceDepth(GRID_Z) = zFar
+	void binSlices(); // until the shared slice counter runs out
+	void binSlice(unsigned int z);
+	void workerLoop(unsigned int index);
+};
+
+#endif
\ No newline at end of file
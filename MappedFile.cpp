@@ -0,0 +1,94 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+		_data = std::exchange(other._data, nullptr);
+		_size = std::exchange(other._size, 0);
+	}
+	return *this;
+}
+
+bool MappedFile::open(const std::string& path) {
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	/* the view keeps the file open, both handles can go */
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL)
+		return false;
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (view == NULL)
+		return false;
+	_data = (const unsigned char*)view;
+	_size = (size_t)size.QuadPart;
+#else
+	/* checked before opening : opening a fifo would take the data from its reader */
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+		return false;
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	/* the mapping keeps the file open, the descriptor can go */
+	void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+	_data = (const unsigned char*)view;
+	_size = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close() {
+	if (!_data)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(_data);
+#else
+	munmap((void*)_data, _size);
+#endif
+	_data = nullptr;
+	_size = 0;
+}
+
+void MappedFile::touch() const {
+#ifndef _WIN32
+	madvise((void*)_data, _size, MADV_WILLNEED); // read-ahead, the loop below then rarely waits
+#endif
+	volatile unsigned char sink = 0;
+	for (size_t offset = 0; offset < _size; offset += 4096)
+		sink = sink + _data[offset];
+}
\ No newline at end of file
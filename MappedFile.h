@@ -0,0 +1,35 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/* Read-only mapping of a whole file, the pages are read on first touch.
+Only regular, non-empty files map : open() fails on pipes & devices so the
+caller can fall back to reading them. */
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path); // false, quietly, when the file can't be mapped
+	void close();
+
+	/* Faults every page in now, on the calling thread, instead of on first use */
+	void touch() const;
+
+	bool isOpen() const { return _data != nullptr; }
+	const unsigned char* data() const { return _data; }
+	size_t size() const { return _size; }
+
+private:
+	const unsigned char* _data = nullptr;
+	size_t _size = 0;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "Options.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+static void printUsage(const char* program) {
+	std::cout << "Usage : " << program << " [options]\n"
+		<< "  --headless          render offscreen for a fixed number of frames, then exit\n"
+		<< "  --frames N          measured frames in headless mode (default 600, or the whole replay)\n"
+		<< "  --warmup N          frames rendered before measuring (default 60)\n"
+		<< "  --stats-json PATH   frame time statistics output (default frame_stats.json)\n"
+		<< "  --size WxH          framebuffer size (default 800x600)\n"
+		<< "  --record-camera F   record the camera path to F\n"
+		<< "  --replay-camera F   replay the camera path in F, input is ignored\n"
+		<< "  --replay-dt S       simulated seconds per replayed frame (default 1/60)\n"
+		<< "  --deferred          start with deferred shading instead of clustered forward (F2 toggles)\n"
+		<< "  --depth-prepass     depth-only pass before forward shading (F3 toggles)\n"
+		<< "  --lights N          point lights, the scene's 4 then random ones (default 4)\n"
+		<< "  --no-flashlight     start with the camera spot light off (F4 toggles)\n"
+		<< "  --sync-textures     load textures on the main thread before the first frame\n"
+		<< "  --texture-compression auto|bc1|bc3|bc7|none  block compression of the textures (default auto)\n"
+		<< "  --compression-quality fast|normal|high  encoder effort (default normal)\n"
+		<< "  --no-texture-cache  decode every image, don't use ./texture_cache\n"
+		<< "  --profile-trace F   write a Chrome trace of the last frames to F on exit\n"
+		<< "  --bench-bvh [N]     BVH benchmark over N objects (default 1000000)\n"
+		<< "  --bench-profiler [N] profiler zone overhead over N zones (default 10000000)\n"
+		<< "  --bench-render-queue [N] render queue sort time over N draws (default 100000)\n"
+		<< "  --bench-compression [F] block compression speed & PSNR of image F (default ./images/container2.png)\n"
+		<< "  --bench-texture-cache [F] cold decode against texture cache hits for image F (default ./images/container2.png)\n"
+		<< "  --bench-image-load [F] stbi_load against stbi_load_mmap on file F, or every file in directory F (default ./images)\n"
+		<< "  --stress-stbi [N]   N rounds of concurrent image decodes, each thread with its own decoder settings (default 20)\n"
+		<< "  --verify-png-filters decode generated PNGs of every filter, bit depth & channel count, check the pixels\n"
+		<< "  --verify-inflate    inflate generated fixed, dynamic & stored zlib streams, check the bytes & truncations" << std::endl;
+}
+
+static bool parseCount(const char* text, unsigned int& value) {
+	char* end;
+	unsigned long parsed = strtoul(text, &end, 10);
+	if (end == text || *end != '\0')
+		return false;
+	value = (unsigned int)parsed;
+	return true;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		bool ok = true;
+
+		if (arg == "--headless")
+			options.headless = true;
+		else if (arg == "--frames")
+			ok = hasValue && parseCount(argv[++i], options.frames) && options.frames > 0;
+		else if (arg == "--warmup")
+			ok = hasValue && parseCount(argv[++i], options.warmupFrames);
+		else if (arg == "--stats-json")
+			ok = hasValue && !(options.statsPath = argv[++i]).empty();
+		else if (arg == "--size")
+			ok = hasValue && sscanf(argv[++i], "%ux%u", &options.width, &options.height) == 2
+				&& options.width > 0 && options.height > 0;
+		else if (arg == "--record-camera")
+			ok = hasValue && !(options.recordPath = argv[++i]).empty();
+		else if (arg == "--replay-camera")
+			ok = hasValue && !(options.replayPath = argv[++i]).empty();
+		else if (arg == "--replay-dt")
+			ok = hasValue && sscanf(argv[++i], "%f", &options.replayDelta) == 1 && options.replayDelta > 0.0f;
+		else if (arg == "--deferred")
+			options.deferred = true;
+		else if (arg == "--depth-prepass")
+			options.depthPrepass = true;
+		else if (arg == "--lights")
+			ok = hasValue && parseCount(argv[++i], options.pointLights);
+		else if (arg == "--no-flashlight")
+			options.spotLight = false;
+		else if (arg == "--sync-textures")
+			options.syncTextures = true;
+		else if (arg == "--texture-compression") {
+			std::string mode = hasValue ? argv[++i] : "";
+			options.textureCompression = mode;
+			ok = mode == "auto" || mode == "bc1" || mode == "bc3" || mode == "bc7" || mode == "none";
+		}
+		else if (arg == "--compression-quality") {
+			std::string quality = hasValue ? argv[++i] : "";
+			options.compressionQuality = quality == "fast" ? 0 : quality == "high" ? 2 : 1;
+			ok = quality == "fast" || quality == "normal" || quality == "high";
+		}
+		else if (arg == "--no-texture-cache")
+			options.textureCache = false;
+		else if (arg == "--profile-trace")
+			ok = hasValue && !(options.tracePath = argv[++i]).empty();
+		else if (arg == "--bench-bvh") {
+			options.benchBVH = 1000000;
+			if (hasValue && argv[i + 1][0] != '-')
+				ok = parseCount(argv[++i], options.benchBVH) && options.benchBVH > 0;
+		}
+		else if (arg == "--bench-profiler") {
+			options.benchProfiler = 10000000;
+			if (hasValue && argv[i + 1][0] != '-')
+				ok = parseCount(argv[++i], options.benchProfiler) && options.benchProfiler > 0;
+		}
+		else if (arg == "--bench-render-queue") {
+			options.benchRenderQueue = 100000;
+			if (hasValue && argv[i + 1][0] != '-')
+				ok = parseCount(argv[++i], options.benchRenderQueue) && options.benchRenderQueue > 0;
+		}
+		else if (arg == "--bench-compression") {
+			options.benchCompression = "./images/container2.png";
+			if (hasValue && argv[i + 1][0] != '-')
+				options.benchCompression = argv[++i];
+		}
+		else if (arg == "--bench-texture-cache") {
+			options.benchTextureCache = "./images/container2.png";
+			if (hasValue && argv[i + 1][0] != '-')
+				options.benchTextureCache = argv[++i];
+		}
+		else if (arg == "--bench-image-load") {
+			options.benchImageLoad = "./images";
+			if (hasValue && argv[i + 1][0] != '-')
+				options.benchImageLoad = argv[++i];
+		}
+		else if (arg == "--stress-stbi") {
+			options.stressStbi = 20;
+			if (hasValue && argv[i + 1][0] != '-')
+				ok = parseCount(argv[++i], options.stressStbi) && options.stressStbi > 0;
+		}
+		else if (arg == "--verify-png-filters")
+			options.verifyPngFilters = true;
+		else if (arg == "--verify-inflate")
+			options.verifyInflate = true;
+		else
+			ok = false;
+		if (ok && !options.recordPath.empty() && !options.replayPath.empty())
+			ok = false; // recording a replay would only copy the file
+
+		if (!ok) {
+			std::cout << "ERROR::OPTIONS::INVALID_ARGUMENT " << arg << std::endl;
+			printUsage(argv[0]);
+			return false;
+		}
+	}
+	return true;
+}
\ No newline at end of file
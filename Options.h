@@ -0,0 +1,44 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+
+/* Command line switches, parsed once in main() */
+struct Options {
+	/* --headless : invisible window (or no display at all), rendering into an FBO */
+	bool headless = false;
+	unsigned int frames = 0; // --frames N : measured frames in headless mode, 0 = 600 or the whole replay
+	unsigned int warmupFrames = 60; // --warmup N : rendered first, left out of the statistics
+	std::string statsPath = "frame_stats.json"; // --stats-json PATH
+	unsigned int width = 800, height = 600; // --size WxH
+
+	std::string recordPath; // --record-camera PATH : save the camera path on exit
+	std::string replayPath; // --replay-camera PATH : drive the camera from a recorded path
+	float replayDelta = 1.0f / 60.0f; // --replay-dt S : simulated time step of the replay
+
+	bool deferred = false; // --deferred : start with deferred shading, F2 switches at runtime
+	bool depthPrepass = false; // --depth-prepass : forward shading behind a depth-only pass, F3 toggles
+	unsigned int pointLights = 4; // --lights N : the 4 scene lights, then random ones up to N
+	bool spotLight = true; // --no-flashlight : start with the camera spot light off, F4 toggles
+	bool syncTextures = false; // --sync-textures : decode & upload on the main thread during startup, to compare
+	std::string textureCompression = "auto"; // --texture-compression auto|bc1|bc3|bc7|none, auto : BC7, else BC1 / BC3
+	unsigned int compressionQuality = 1; // --compression-quality fast|normal|high : 0~2, see CompressionQuality
+	bool textureCache = true; // --no-texture-cache : always decode, nothing read from or written to ./texture_cache
+
+	std::string tracePath; // --profile-trace PATH : Chrome trace written on exit (F9 dumps one any time)
+
+	unsigned int benchBVH = 0; // --bench-bvh [N] : run the BVH benchmark over N objects and exit
+	unsigned int benchProfiler = 0; // --bench-profiler [N] : time N empty profiler zones and exit
+	unsigned int benchRenderQueue = 0; // --bench-render-queue [N] : time sorting a render queue of N draws and exit
+	std::string benchCompression; // --bench-compression [PATH] : encode an image in every block format & quality and exit
+	std::string benchTextureCache; // --bench-texture-cache [PATH] : cold decode against cache hits and exit
+	std::string benchImageLoad; // --bench-image-load [PATH] : stbi_load against stbi_load_mmap over a file or directory and exit
+	unsigned int stressStbi = 0; // --stress-stbi [N] : N rounds of concurrent decodes with different stbi_decoder settings, then exit
+	bool verifyPngFilters = false; // --verify-png-filters : decode generated PNGs of every filter & bit depth, check the pixels and exit
+	bool verifyInflate = false; // --verify-inflate : inflate generated fixed & dynamic Huffman streams, check the bytes and exit
+};
+
+/* Returns false and prints the usage on unknown or malformed arguments */
+bool parseOptions(int argc, char** argv, Options& options);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+
+std::mutex Profiler::_threadsMutex;
+std::vector<std::unique_ptr<Profiler::ThreadBuffer>> Profiler::_threads;
+std::vector<Profiler::ZoneHistory> Profiler::_histories;
+std::vector<Profiler::ZoneStats> Profiler::_zoneStats;
+uint64_t Profiler::_frames = 0;
+
+namespace {
+	/* trace timestamps are relative to this, and the tick rate is measured from it */
+	const uint64_t originTicks = Profiler::ticks();
+	const std::chrono::steady_clock::time_point originTime = std::chrono::steady_clock::now();
+}
+
+Profiler::ThreadBuffer* Profiler::registerThread() {
+	std::lock_guard<std::mutex> lock(_threadsMutex);
+	_threads.push_back(std::make_unique<ThreadBuffer>());
+	ThreadBuffer* buffer = _threads.back().get();
+	buffer->tid = (unsigned int)_threads.size();
+	buffer->name = "Thread " + std::to_string(buffer->tid);
+	_threadBuffer = buffer;
+	return buffer;
+}
+
+void Profiler::setThreadName(const char* name) {
+	ThreadBuffer* buffer = _threadBuffer ? _threadBuffer : registerThread();
+	std::lock_guard<std::mutex> lock(_threadsMutex);
+	buffer->name = name;
+}
+
+double Profiler::ticksPerMs() {
+#ifdef PROFILER_RDTSC
+	/* measured over the whole run so far, precise once the first frames are in */
+	double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - originTime).count();
+	uint64_t elapsedTicks = ticks() - originTicks;
+	return elapsedMs > 0.0 && elapsedTicks > 0 ? elapsedTicks / elapsedMs : 1.0e6;
+#else
+	typedef std::chrono::steady_clock::period Period;
+	return (double)Period::den / Period::num / 1000.0;
+#endif
+}
+
+size_t Profiler::historyIndex(const char* name) {
+	for (size_t i = 0; i < _histories.size(); ++i) {
+		if (_histories[i].name == name || strcmp(_histories[i].name, name) == 0)
+			return i;
+	}
+	_histories.push_back(ZoneHistory()); // zeroed window
+	_histories.back().name = name;
+	return _histories.size() - 1;
+}
+
+void Profiler::endFrame() {
+	const size_t slot = _frames % WINDOW_FRAMES;
+	for (ZoneHistory& history : _histories) {
+		history.frameMs[slot] = 0.0;
+		history.calls[slot] = 0;
+	}
+
+	const double msPerTick = 1.0 / ticksPerMs();
+	{
+		std::lock_guard<std::mutex> lock(_threadsMutex);
+		for (auto& buffer : _threads) {
+			/* events older than one ring were overwritten before we got to them */
+			uint64_t head = buffer->head.load(std::memory_order_acquire);
+			uint64_t first = std::max(buffer->statsTail, head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0);
+			for (uint64_t i = first; i < head; ++i) {
+				const Event& event = buffer->events[i & (EVENTS_PER_THREAD - 1)];
+				ZoneHistory& history = _histories[historyIndex(event.name)];
+				history.frameMs[slot] += (event.end - event.begin) * msPerTick;
+				history.calls[slot]++;
+			}
+			buffer->statsTail = head;
+		}
+	}
+	_frames++;
+
+	const size_t filled = (size_t)std::min<uint64_t>(_frames, WINDOW_FRAMES);
+	_zoneStats.resize(_histories.size());
+	for (size_t z = 0; z < _histories.size(); ++z) {
+		const ZoneHistory& history = _histories[z];
+		ZoneStats& stats = _zoneStats[z];
+		double sum = 0.0, maxMs = 0.0;
+		unsigned int calls = 0;
+		for (size_t f = 0; f < filled; ++f) {
+			sum += history.frameMs[f];
+			maxMs = std::max(maxMs, history.frameMs[f]);
+			calls += history.calls[f];
+		}
+		stats.name = history.name;
+		stats.lastMs = history.frameMs[slot];
+		stats.avgMs = sum / filled;
+		stats.maxMs = maxMs;
+		stats.callsPerFrame = (double)calls / filled;
+	}
+	std::sort(_zoneStats.begin(), _zoneStats.end(),
+		[](const ZoneStats& a, const ZoneStats& b) { return strcmp(a.name, b.name) < 0; });
+}
+
+bool Profiler::writeTrace(const std::string& path) {
+	std::ofstream out(path, std::ios::trunc);
+	if (!out) {
+		std::cout << "ERROR::PROFILER::FILE_NOT_WRITABLE " << path << std::endl;
+		return false;
+	}
+
+	const double usPerTick = 1000.0 / ticksPerMs();
+	char line[256];
+	size_t events = 0;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	std::lock_guard<std::mutex> lock(_threadsMutex);
+	for (auto& buffer : _threads) {
+		snprintf(line, sizeof(line), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			events++ ? "," : "", buffer->tid, buffer->name.c_str());
+		out << line;
+
+		/* complete events ("X"), nesting is recovered from the time ranges */
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		for (uint64_t i = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0; i < head; ++i) {
+			const Event& event = buffer->events[i & (EVENTS_PER_THREAD - 1)];
+			snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				event.name, buffer->tid, (double)(int64_t)(event.begin - originTicks) * usPerTick,
+				(double)(event.end - event.begin) * usPerTick);
+			out << line;
+			events++;
+		}
+	}
+	out << "\n]}\n";
+	return (bool)out;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/* Define PROFILER_ENABLED=0 in the build to compile every PROFILE_ZONE away */
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PROFILER_RDTSC 1
+#else
+#include <chrono>
+#endif
+
+/* Scoped-zone CPU profiler.
+A zone costs two timestamp reads and one store into a buffer owned by the
+calling thread : no lock, no allocation. Each thread writes its own ring of
+the latest EVENTS_PER_THREAD zones, endFrame() folds the new ones into rolling
+per-zone statistics and writeTrace() dumps the rings as Chrome trace JSON
+(chrome://tracing, ui.perfetto.dev).
+Zone names must outlive the program, use string literals. */
+class Profiler
+{
+public:
+	static const unsigned int EVENTS_PER_THREAD = 1 << 16;
+	static const unsigned int WINDOW_FRAMES = 120; // rolling statistics span
+
+	struct ZoneStats {
+		const char* name = nullptr;
+		double lastMs = 0.0; // time spent in the zone during the last frame
+		double avgMs = 0.0; // per frame, over the window
+		double maxMs = 0.0;
+		double callsPerFrame = 0.0;
+	};
+
+	class Zone {
+	public:
+		explicit Zone(const char* name) : _name(name), _begin(ticks()) {}
+		~Zone() { record(_name, _begin, ticks()); }
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+	private:
+		const char* _name;
+		uint64_t _begin;
+	};
+
+	static inline uint64_t ticks() {
+#ifdef PROFILER_RDTSC
+		return __rdtsc(); // invariant TSC, converted with a rate measured against steady_clock
+#else
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	static inline void record(const char* name, uint64_t begin, uint64_t end) {
+		ThreadBuffer* buffer = _threadBuffer ? _threadBuffer : registerThread();
+		uint64_t head = buffer->head.load(std::memory_order_relaxed);
+		Event& event = buffer->events[head & (EVENTS_PER_THREAD - 1)];
+		event.name = name;
+		event.begin = begin;
+		event.end = end;
+		buffer->head.store(head + 1, std::memory_order_release); // publishes the event to the reader
+	}
+
+	static void setThreadName(const char* name); // shown in the trace, call from the thread itself
+	static void endFrame(); // once per frame on the main thread
+	static const std::vector<ZoneStats>& zoneStats() { return _zoneStats; } // sorted by name
+	static bool writeTrace(const std::string& path);
+
+private:
+	struct Event {
+		const char* name;
+		uint64_t begin, end; // ticks()
+	};
+
+	/* single producer (the owning thread), read by the main thread */
+	struct ThreadBuffer {
+		Event events[EVENTS_PER_THREAD];
+		std::atomic<uint64_t> head{ 0 }; // events written so far, the ring keeps the last EVENTS_PER_THREAD
+		uint64_t statsTail = 0; // first event endFrame() has not seen yet
+		unsigned int tid = 0;
+		std::string name;
+	};
+
+	struct ZoneHistory {
+		const char* name;
+		double frameMs[WINDOW_FRAMES];
+		unsigned int calls[WINDOW_FRAMES];
+	};
+
+	static inline thread_local ThreadBuffer* _threadBuffer = nullptr;
+	static std::mutex _threadsMutex; // registration & readers, never taken by record()
+	static std::vector<std::unique_ptr<ThreadBuffer>> _threads; // kept after their thread exits
+	static std::vector<ZoneHistory> _histories;
+	static std::vector<ZoneStats> _zoneStats;
+	static uint64_t _frames;
+
+	static ThreadBuffer* registerThread();
+	static double ticksPerMs();
+	static size_t historyIndex(const char* name);
+};
+
+#if PROFILER_ENABLED
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILER_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_END_FRAME() Profiler::endFrame()
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_END_FRAME() ((void)0)
+#endif
+
+#endif
\ No newline at end of file
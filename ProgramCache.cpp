@@ -0,0 +1,140 @@
+#include "ProgramCache.h"
+#include "GLExtensions.h"
+#include "Hash.h"
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+std::string ProgramCache::directory = "./shader_cache";
+bool ProgramCache::enabled = true;
+ProgramCache::Stats ProgramCache::_stats;
+
+namespace {
+	const char CACHE_MAGIC[4] = { 'G', 'L', 'P', 'B' };
+	const uint32_t CACHE_VERSION = 1;
+
+	struct CacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t binaryFormat;
+		uint32_t length;
+	};
+
+	uint64_t hashString(uint64_t hash, const char* str) {
+		if (str == NULL)
+			str = "";
+		return hashBytes(hash, str, strlen(str) + 1); // keep the '\0' as a separator
+	}
+}
+
+bool ProgramCache::available() {
+	return enabled && GLExt.programBinary;
+}
+
+uint64_t ProgramCache::key(const std::string& vertexSource, const std::string& fragmentSource) {
+	uint64_t hash = HASH_SEED;
+	hash = hashString(hash, vertexSource.c_str());
+	hash = hashString(hash, fragmentSource.c_str());
+	hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+	hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+	hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+	return hash;
+}
+
+std::string ProgramCache::path(uint64_t key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return directory + "/" + name;
+}
+
+bool ProgramCache::load(unsigned int program, uint64_t key) {
+	std::string file = path(key);
+	std::ifstream in(file, std::ios::binary);
+	if (!in) {
+		_stats.misses++;
+		return false;
+	}
+
+	CacheHeader header;
+	std::vector<char> binary;
+	bool valid = false;
+	std::error_code ec;
+	uintmax_t fileSize = std::filesystem::file_size(file, ec);
+	if (!ec && in.read((char*)&header, sizeof(header))
+		&& memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+		&& header.version == CACHE_VERSION && header.key == key
+		&& header.length <= fileSize - sizeof(header)) { // a corrupt length must not allocate first
+		binary.resize(header.length);
+		valid = (bool)in.read(binary.data(), header.length);
+	}
+	in.close();
+
+	if (valid) {
+		GLExt.ProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+		int success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		valid = success != 0;
+	}
+
+	if (!valid) {
+		/* truncated file, or the driver refused the binary : drop it, the caller relinks */
+		_stats.invalidations++;
+		std::filesystem::remove(file, ec);
+		return false;
+	}
+
+	_stats.hits++;
+	return true;
+}
+
+void ProgramCache::store(unsigned int program, uint64_t key) {
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum binaryFormat = 0;
+	GLExt.GetProgramBinary(program, length, NULL, &binaryFormat, binary.data());
+
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+
+	CacheHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.key = key;
+	header.binaryFormat = binaryFormat;
+	header.length = (uint32_t)length;
+
+	/* written aside then renamed over : an interrupted write never leaves a torn binary */
+	std::string file = path(key);
+	std::string temporary = file + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			std::cout << "WARNING::PROGRAM_CACHE::CANNOT_WRITE " << file << std::endl;
+			return;
+		}
+		out.write((const char*)&header, sizeof(header));
+		out.write(binary.data(), length);
+		if (!out) {
+			out.close();
+			std::filesystem::remove(temporary, ec);
+			std::cout << "WARNING::PROGRAM_CACHE::CANNOT_WRITE " << file << std::endl;
+			return;
+		}
+	}
+	std::filesystem::rename(temporary, file, ec);
+	if (ec) {
+		std::filesystem::remove(temporary, ec);
+		std::cout << "WARNING::PROGRAM_CACHE::CANNOT_WRITE " << file << std::endl;
+	}
+}
\ No newline at end of file
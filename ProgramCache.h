@@ -0,0 +1,38 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <string>
+#include <cstdint>
+
+/* On-disk cache of linked program binaries (ARB_get_program_binary).
+Entries are keyed by a hash of the shader sources and the driver's
+vendor/renderer/version strings, so a driver update simply misses. */
+class ProgramCache
+{
+public:
+	struct Stats {
+		unsigned int hits = 0;
+		unsigned int misses = 0;
+		unsigned int invalidations = 0; // entry found but rejected (corrupt, or refused by the driver)
+	};
+
+	static std::string directory;
+	static bool enabled; // also requires GLExt.programBinary
+
+	static bool available();
+	static uint64_t key(const std::string& vertexSource, const std::string& fragmentSource);
+
+	/* Try to load the binary into program; true when it's linked and ready to use. */
+	static bool load(unsigned int program, uint64_t key);
+	/* Save the binary of a successfully linked program. */
+	static void store(unsigned int program, uint64_t key);
+
+	static const Stats& stats() { return _stats; }
+
+private:
+	static Stats _stats;
+
+	static std::string path(uint64_t key);
+};
+
+#endif
\ No newline at end of file
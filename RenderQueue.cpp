@@ -0,0 +1,206 @@
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+	const unsigned int PASS_BITS = 4, PROGRAM_BITS = 10, VAO_BITS = 10, MATERIAL_BITS = 12, DEPTH_BITS = 28;
+	const unsigned int DEPTH_SHIFT = 0;
+	const unsigned int MATERIAL_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+	const unsigned int VAO_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+	const unsigned int PROGRAM_SHIFT = VAO_SHIFT + VAO_BITS;
+	const unsigned int PASS_SHIFT = PROGRAM_SHIFT + PROGRAM_BITS;
+	static_assert(PASS_SHIFT + PASS_BITS == 64, "sort key must fill 64 bits");
+
+	const unsigned int MIN_RADIX_BITS = 8, MAX_RADIX_BITS = 14; // digit width, grows with the queue
+
+	inline uint64_t field(unsigned int value, unsigned int bits, unsigned int shift) {
+		return (uint64_t)(value & ((1u << bits) - 1)) << shift;
+	}
+}
+
+uint64_t RenderQueue::makeKey(unsigned int pass, unsigned int program, unsigned int vao,
+	unsigned int material, float depth, float farPlane, bool backToFront) {
+	float normalized = depth / farPlane;
+	if (!(normalized > 0.0f)) // also catches NaN
+		normalized = 0.0f;
+	if (normalized > 1.0f)
+		normalized = 1.0f;
+
+	const uint32_t maxDepth = (1u << DEPTH_BITS) - 1;
+	uint32_t quantized = (uint32_t)(normalized * maxDepth);
+	if (backToFront)
+		quantized = maxDepth - quantized;
+
+	return field(pass, PASS_BITS, PASS_SHIFT)
+		| field(program, PROGRAM_BITS, PROGRAM_SHIFT)
+		| field(vao, VAO_BITS, VAO_SHIFT)
+		| field(material, MATERIAL_BITS, MATERIAL_SHIFT)
+		| field(quantized, DEPTH_BITS, DEPTH_SHIFT);
+}
+
+void RenderQueue::clear() {
+	_items.clear();
+	_keys.clear();
+	_order.clear();
+	_varying = 0;
+	_stats.items = _stats.programChanges = _stats.vaoChanges = _stats.textureChanges = 0;
+}
+
+DrawItem& RenderQueue::push(uint64_t key) {
+	if (!_keys.empty())
+		_varying |= key ^ _keys.front();
+	_keys.push_back(key);
+	_items.emplace_back();
+	return _items.back();
+}
+
+void RenderQueue::push(uint64_t key, const DrawItem& item) {
+	if (!_keys.empty())
+		_varying |= key ^ _keys.front();
+	_keys.push_back(key);
+	_items.push_back(item);
+}
+
+void RenderQueue::sort() {
+	auto begin = std::chrono::steady_clock::now();
+
+	const uint32_t count = (uint32_t)_keys.size();
+	_order.resize(count);
+	_scratch.resize(count);
+
+	/* Digits as wide as the queue makes worth it, 2^digitBits counters cleared and summed per
+	pass. Only the bits that differ between keys can change the order : a digit starts at the
+	next varying bit and stops at the last one it holds, so the fields every item shares (one
+	program, one VAO, unused bits) are never sorted on. */
+	unsigned int digitBits = MIN_RADIX_BITS;
+	while (digitBits < MAX_RADIX_BITS && ((uint64_t)1 << (digitBits + 3)) < count)
+		digitBits++;
+	struct Digit {
+		unsigned int shift;
+		uint64_t mask;
+	};
+	Digit digits[64];
+	unsigned int digitCount = 0;
+	for (unsigned int bit = 0; bit < 64;) {
+		if (((_varying >> bit) & 1) == 0) {
+			bit++;
+			continue;
+		}
+		unsigned int width = std::min(digitBits, 64 - bit);
+		while (((_varying >> (bit + width - 1)) & 1) == 0)
+			width--;
+		digits[digitCount++] = { bit, ((uint64_t)1 << width) - 1 };
+		bit += width;
+	}
+
+	/* all histograms in one read of the keys */
+	const size_t bucketCount = (size_t)1 << digitBits;
+	_histogram.assign(digitCount * bucketCount, 0);
+	for (uint32_t i = 0; i < count; ++i) {
+		const uint64_t key = _keys[i];
+		for (unsigned int d = 0; d < digitCount; ++d)
+			_histogram[d * bucketCount + ((key >> digits[d].shift) & digits[d].mask)]++;
+	}
+
+	/* LSD radix sort of the 32-bit item indices, stable from one digit to the next. The keys
+	stay where push() wrote them and are read through the index. */
+	uint32_t* src = _order.data();
+	uint32_t* dst = _scratch.data();
+	for (unsigned int d = 0; d < digitCount; ++d) {
+		uint32_t* histogram = _histogram.data() + d * bucketCount;
+		const unsigned int shift = digits[d].shift;
+		const uint64_t mask = digits[d].mask;
+
+		uint32_t offset = 0;
+		for (uint64_t b = 0; b <= mask; ++b) {
+			uint32_t n = histogram[b];
+			histogram[b] = offset;
+			offset += n;
+		}
+		if (d == 0) {
+			for (uint32_t i = 0; i < count; ++i)
+				dst[histogram[(_keys[i] >> shift) & mask]++] = i;
+		}
+		else {
+			for (uint32_t i = 0; i < count; ++i) {
+				const uint32_t index = src[i];
+				dst[histogram[(_keys[index] >> shift) & mask]++] = index;
+			}
+		}
+		std::swap(src, dst);
+	}
+	if (digitCount == 0) {
+		for (uint32_t i = 0; i < count; ++i)
+			_order[i] = i;
+	}
+	else if (src != _order.data())
+		_order.swap(_scratch);
+
+	_stats.sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+const char* RenderQueue::passName(unsigned int pass) {
+	switch (pass) {
+	case PASS_DEPTH: return "Depth";
+	case PASS_OPAQUE: return "Opaque";
+	case PASS_UNLIT: return "Unlit";
+	default: return "Pass";
+	}
+}
+
+void RenderQueue::submit() {
+	submit(0, ~0u);
+}
+
+void RenderQueue::submit(unsigned int firstPass, unsigned int lastPass) {
+	Shader* shader = nullptr;
+	unsigned int vao = 0xFFFFFFFFu;
+	unsigned int textures[2] = { 0xFFFFFFFFu, 0xFFFFFFFFu };
+	unsigned int pass = 0xFFFFFFFFu;
+	int passScope = -1;
+
+	for (uint32_t index : _order) {
+		const DrawItem& item = _items[index];
+
+		unsigned int itemPass = (unsigned int)(_keys[index] >> PASS_SHIFT);
+		if (itemPass < firstPass)
+			continue;
+		if (itemPass > lastPass)
+			break; // sorted by pass first
+		if (itemPass != pass) {
+			gpuProfiler.endScope(passScope);
+			pass = itemPass;
+			passScope = gpuProfiler.beginScope(passName(pass));
+		}
+
+		if (item.shader != shader) {
+			shader = item.shader;
+			shader->use();
+			_stats.programChanges++;
+		}
+		if (item.vao != vao) {
+			vao = item.vao;
+			glState.bindVertexArray(vao);
+			_stats.vaoChanges++;
+		}
+		for (unsigned int unit = 0; unit < 2; ++unit) {
+			if (item.textures[unit] != 0 && item.textures[unit] != textures[unit]) {
+				textures[unit] = item.textures[unit];
+				glState.bindTexture(unit, GL_TEXTURE_2D, textures[unit]);
+				_stats.textureChanges++;
+			}
+		}
+		if (item.modelUniform.location != -1)
+			shader->setMat4(item.modelUniform, item.model);
+
+		if (item.instanceCount > 0)
+			glDrawArraysInstanced(GL_TRIANGLES, 0, item.vertexCount, item.instanceCount);
+		else
+			glDrawArrays(GL_TRIANGLES, 0, item.vertexCount);
+		_stats.items++;
+	}
+	gpuProfiler.endScope(passScope);
+}
\ No newline at end of file
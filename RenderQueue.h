@@ -0,0 +1,73 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "Shader.h"
+
+/* One draw call and the state it needs. */
+struct DrawItem {
+	Shader* shader = nullptr;
+	unsigned int vao = 0;
+	unsigned int textures[2] = { 0, 0 }; // unit 0 & 1, 0 = leave the unit alone
+	unsigned int vertexCount = 0;
+	unsigned int instanceCount = 0; // 0 = glDrawArrays, otherwise glDrawArraysInstanced
+	Uniform modelUniform; // location -1 = no per-item model matrix
+	glm::mat4 model = glm::mat4(1.0f);
+};
+
+/* Collects the draws of a frame, radix-sorts them by a 64-bit key and submits
+them with as few state changes as possible.
+
+Key layout, most significant first :
+	pass (4) | program (10) | vao (10) | material (12) | depth (28)
+State comes before depth so items sharing a program/VAO/material are adjacent;
+within a state bucket opaque items are front-to-back for early-z. The ids are
+truncated into their fields, so a collision only costs an extra state change,
+submit() always compares the real objects. */
+class RenderQueue
+{
+public:
+	enum Pass {
+		PASS_DEPTH = 0, // optional depth pre-pass of the opaque items
+		PASS_OPAQUE = 1,
+		PASS_UNLIT = 2, // light source cubes
+	};
+	static const char* passName(unsigned int pass); // GPU scope of the pass
+
+	struct Stats {
+		unsigned int items = 0; // submitted since clear()
+		unsigned int programChanges = 0;
+		unsigned int vaoChanges = 0;
+		unsigned int textureChanges = 0;
+		double sortMs = 0.0;
+	};
+
+	/* depth : view distance, quantized over [0, farPlane]. backToFront for blended passes. */
+	static uint64_t makeKey(unsigned int pass, unsigned int program, unsigned int vao,
+		unsigned int material, float depth, float farPlane, bool backToFront = false);
+
+	void clear();
+	DrawItem& push(uint64_t key); // returns a default item to fill in
+	void push(uint64_t key, const DrawItem& item);
+	void sort();
+	void submit(); // in key order, call sort() first; each pass is timed as a GPU scope
+	void submit(unsigned int firstPass, unsigned int lastPass); // only these passes, e.g. around a deferred lighting pass
+
+	const Stats& stats() const { return _stats; }
+	size_t size() const { return _items.size(); }
+	const std::vector<uint32_t>& order() const { return _order; } // push() indices in key order, after sort()
+
+private:
+	std::vector<DrawItem> _items;
+	std::vector<uint64_t> _keys; // written at push(), in item order : the items never move
+	uint64_t _varying = 0; // key bits that differ between the items
+	std::vector<uint32_t> _order, _scratch; // item indices, in key order after sort()
+	std::vector<uint32_t> _histogram;
+	Stats _stats;
+};
+
+#endif
\ No newline at end of file
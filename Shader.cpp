@@ -1,95 +1,473 @@
 #include "Shader.h"
+#include "GLExtensions.h"
+#include "ProgramCache.h"
+#include "GLState.h"
+#include "ShaderPreprocessor.h"
+#include "FileWatcher.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
-	std::ifstream vertexFile;
-	std::ifstream fragmentFile;
+#include <algorithm>
+#include <thread>
 
-	vertexFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fragmentFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+unsigned int Shader::_replaced = 0;
 
-	try {
-		vertexFile.open(vertexPath);
-		fragmentFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
+/* set by enableHotReload(), every file read from then on is watched */
+static std::unique_ptr<FileWatcher>& hotReloadWatcher() {
+	static std::unique_ptr<FileWatcher> watcher;
+	return watcher;
+}
 
-		vShaderStream << vertexFile.rdbuf();
-		fShaderStream << fragmentFile.rdbuf();
+ShaderDefines& ShaderDefines::set(const std::string& name, const std::string& value) {
+	_defines[name] = value;
+	return *this;
+}
 
-		vertexFile.close();
-		fragmentFile.close();
+ShaderDefines& ShaderDefines::set(const std::string& name, int value) {
+	return set(name, std::to_string(value));
+}
 
-		_vertexSource = vShaderStream.str();
-		_fragmentSource = fShaderStream.str();
-	}
-	catch (std::ifstream::failure e) {
-		std::cout << "ERROR: SHADER: File Not Successfully Read" << std::endl;
+std::string ShaderDefines::key() const {
+	std::string key;
+	for (const auto& define : _defines)
+		key += define.first + "=" + define.second + ";";
+	return key;
+}
+
+std::string ShaderDefines::inject(const std::string& source) const {
+	if (_defines.empty())
+		return source;
+
+	std::string lines;
+	for (const auto& define : _defines)
+		lines += "#define " + define.first + " " + define.second + "\n";
+
+	/* #version must stay the first statement, the defines go on the line after it */
+	size_t version = source.find("#version");
+	if (version == std::string::npos)
+		return lines + "#line 1\n" + source;
+	size_t lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos)
+		return source + "\n" + lines;
+	size_t versionLine = 1 + std::count(source.begin(), source.begin() + lineEnd, '\n');
+	return source.substr(0, lineEnd + 1) + lines + "#line " + std::to_string(versionLine + 1) + "\n"
+		+ source.substr(lineEnd + 1);
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines)
+	: _vertexPath(vertexPath), _fragmentPath(fragmentPath), _defines(defines)
+{
+	readSources();
+	registry().push_back(this);
+}
+
+/* #include expansion & defines; on failure the previous sources are kept */
+bool Shader::readSources() {
+	std::string vertexSource, fragmentSource;
+	std::vector<std::string> vertexFiles, fragmentFiles;
+	if (!ShaderPreprocessor::load(_vertexPath, vertexSource, vertexFiles)
+		|| !ShaderPreprocessor::load(_fragmentPath, fragmentSource, fragmentFiles))
+		return false;
+
+	_vertexSource = _defines.inject(vertexSource);
+	_fragmentSource = _defines.inject(fragmentSource);
+	_vertexFiles = vertexFiles;
+	_fragmentFiles = fragmentFiles;
+
+	/* an edit may have added an include */
+	if (FileWatcher* watcher = hotReloadWatcher().get()) {
+		for (const std::string& file : _vertexFiles)
+			watcher->watch(file);
+		for (const std::string& file : _fragmentFiles)
+			watcher->watch(file);
 	}
+	return true;
+}
+
+Shader::~Shader() {
+	std::vector<Shader*>& shaders = registry();
+	shaders.erase(std::remove(shaders.begin(), shaders.end(), this), shaders.end());
+}
+
+std::vector<Shader*>& Shader::registry() {
+	static std::vector<Shader*> shaders;
+	return shaders;
+}
+
+std::unordered_map<std::string, std::unique_ptr<Shader>>& Shader::permutations() {
+	registry(); // constructed first so it outlives the permutations, whose destructors unregister
+	static std::unordered_map<std::string, std::unique_ptr<Shader>> shaders;
+	return shaders;
+}
+
+Shader& Shader::permutation(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines) {
+	std::string key = std::string(vertexPath) + "|" + fragmentPath + "|" + defines.key();
+	std::unique_ptr<Shader>& shader = permutations()[key];
+	if (!shader)
+		shader = std::make_unique<Shader>(vertexPath, fragmentPath, defines);
+	return *shader;
 }
 
 void Shader::build() {
-	int success;
-	char infoLog[512];
+	beginBuild();
+	finishBuild();
+}
+
+void Shader::beginBuild() {
 	const char* pSource;
 
+	/* Program Binary Cache ============================================================ */
+	_useCache = ProgramCache::available();
+	if (_useCache) {
+		_cacheKey = ProgramCache::key(_vertexSource, _fragmentSource);
+		_building = glCreateProgram();
+		if (ProgramCache::load(_building, _cacheKey)) {
+			adopt();
+			return;
+		}
+		glState.deleteProgram(_building); // a failed glProgramBinary leaves the program unusable
+	}
+
+	/* Issue compiles & link without querying any status : a status query forces
+	the driver to finish the work, so errors are checked in finishBuild(). */
+
 	/* Vertex Shader Compile ========================================================= */
-	unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	_vertexShader = glCreateShader(GL_VERTEX_SHADER);
 	pSource = _vertexSource.c_str();
-	glShaderSource(vertexShader, 1, &pSource, NULL);
-	glCompileShader(vertexShader);
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success); // check for shader compile errors
-	if (!success) {
-		glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-	}
+	glShaderSource(_vertexShader, 1, &pSource, NULL);
+	glCompileShader(_vertexShader);
 
 	/* Fragment Shader Compile ========================================================= */
-	unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	_fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 	pSource = _fragmentSource.c_str();
-	glShaderSource(fragmentShader, 1, &pSource, NULL);
-	glCompileShader(fragmentShader);
-	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success); // check for shader compile errors
+	glShaderSource(_fragmentShader, 1, &pSource, NULL);
+	glCompileShader(_fragmentShader);
+
+	/* Link Shaders : into a new program, _id may be in use ============================== */
+	_building = glCreateProgram();
+	glAttachShader(_building, _vertexShader);
+	glAttachShader(_building, _fragmentShader);
+	if (_useCache)
+		GLExt.ProgramParameteri(_building, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(_building);
+
+	_state = BuildState::Compiling;
+}
+
+bool Shader::isBuildComplete() const {
+	if (_state != BuildState::Compiling)
+		return true;
+	if (!GLExt.parallelShaderCompile)
+		return true; // no non-blocking query : finishBuild() will wait on the driver
+
+	int complete = 0;
+	glGetProgramiv(_building, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete != 0;
+}
+
+void Shader::finishBuild() {
+	int success;
+	char infoLog[512];
+
+	if (_state != BuildState::Compiling)
+		return;
+
+	// check for shader compile errors
+	glGetShaderiv(_vertexShader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		glGetShaderInfoLog(_vertexShader, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n"
+			<< ShaderPreprocessor::annotateLog(infoLog, _vertexFiles) << std::endl;
+	}
+	glGetShaderiv(_fragmentShader, GL_COMPILE_STATUS, &success);
 	if (!success) {
-		glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+		glGetShaderInfoLog(_fragmentShader, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n"
+			<< ShaderPreprocessor::annotateLog(infoLog, _fragmentFiles) << std::endl;
 	}
 
-	/* Link Shaders ==================================================================== */
-	_id = glCreateProgram();
-	glAttachShader(_id, vertexShader);
-	glAttachShader(_id, fragmentShader);
-	glLinkProgram(_id);
 	// check for linking errors
-	glGetProgramiv(_id, GL_LINK_STATUS, &success);
+	glGetProgramiv(_building, GL_LINK_STATUS, &success);
 	if (!success) {
-		glGetProgramInfoLog(_id, 512, NULL, infoLog);
+		glGetProgramInfoLog(_building, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 	}
+	else if (_useCache) {
+		ProgramCache::store(_building, _cacheKey);
+	}
 
 	/* Release Shaders ================================================================== */
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	glDeleteShader(_vertexShader);
+	glDeleteShader(_fragmentShader);
+	_vertexShader = _fragmentShader = 0;
+
+	if (success) {
+		adopt();
+		return;
+	}
+	if (_id != 0) {
+		/* failed reload : the previous program stays */
+		std::cout << "Shader rebuild failed, keeping the previous program : " << _vertexPath << " + " << _fragmentPath << std::endl;
+		glState.deleteProgram(_building);
+		_building = 0;
+		_state = _linked ? BuildState::Ready : BuildState::Failed;
+		return;
+	}
+	_id = _building;
+	_building = 0;
+	cacheUniformLocations();
+	_state = BuildState::Failed;
+}
+
+void Shader::adopt() {
+	if (_id != 0) {
+		if (_linked)
+			copyProgramState(_id, _building);
+		glState.deleteProgram(_id);
+		_replaced++;
+	}
+	_id = _building;
+	_building = 0;
+	_linked = true;
+	cacheUniformLocations();
+	_state = BuildState::Ready;
+}
+
+/* Uniform values & block bindings belong to the program and were set once after
+the first build : the rebuilt program starts with the previous one's, not zeros */
+void Shader::copyProgramState(unsigned int from, unsigned int to) {
+	char name[256];
+	int blocks = 0;
+	glGetProgramiv(to, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+	for (int i = 0; i < blocks; ++i) {
+		glGetActiveUniformBlockName(to, (GLuint)i, sizeof(name), NULL, name);
+		GLuint previous = glGetUniformBlockIndex(from, name);
+		if (previous == GL_INVALID_INDEX)
+			continue;
+		GLint binding = 0;
+		glGetActiveUniformBlockiv(from, previous, GL_UNIFORM_BLOCK_BINDING, &binding);
+		glUniformBlockBinding(to, (GLuint)i, (GLuint)binding);
+	}
+
+	glState.useProgram(to); // glUniform* write the current program
+	int count = 0;
+	glGetProgramiv(to, GL_ACTIVE_UNIFORMS, &count);
+	for (int i = 0; i < count; ++i) {
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type;
+		glGetActiveUniform(to, (GLuint)i, sizeof(name), &length, &size, &type, name);
+		std::string uniformName(name, length);
+		std::string base = uniformName.substr(0, uniformName.find('['));
+
+		for (int element = 0; element < size; ++element) {
+			std::string elementName = size > 1 ? base + "[" + std::to_string(element) + "]" : uniformName;
+			GLint source = glGetUniformLocation(from, elementName.c_str());
+			GLint target = glGetUniformLocation(to, elementName.c_str());
+			if (source < 0 || target < 0)
+				continue; // new in this version, or a block member
+
+			GLfloat f[16];
+			GLint v[4];
+			GLuint u[4];
+			switch (type) {
+			case GL_FLOAT: glGetUniformfv(from, source, f); glUniform1fv(target, 1, f); break;
+			case GL_FLOAT_VEC2: glGetUniformfv(from, source, f); glUniform2fv(target, 1, f); break;
+			case GL_FLOAT_VEC3: glGetUniformfv(from, source, f); glUniform3fv(target, 1, f); break;
+			case GL_FLOAT_VEC4: glGetUniformfv(from, source, f); glUniform4fv(target, 1, f); break;
+			case GL_FLOAT_MAT2: glGetUniformfv(from, source, f); glUniformMatrix2fv(target, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT3: glGetUniformfv(from, source, f); glUniformMatrix3fv(target, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT4: glGetUniformfv(from, source, f); glUniformMatrix4fv(target, 1, GL_FALSE, f); break;
+			case GL_INT_VEC2: case GL_BOOL_VEC2: glGetUniformiv(from, source, v); glUniform2iv(target, 1, v); break;
+			case GL_INT_VEC3: case GL_BOOL_VEC3: glGetUniformiv(from, source, v); glUniform3iv(target, 1, v); break;
+			case GL_INT_VEC4: case GL_BOOL_VEC4: glGetUniformiv(from, source, v); glUniform4iv(target, 1, v); break;
+			case GL_UNSIGNED_INT: glGetUniformuiv(from, source, u); glUniform1uiv(target, 1, u); break;
+			case GL_UNSIGNED_INT_VEC2: glGetUniformuiv(from, source, u); glUniform2uiv(target, 1, u); break;
+			case GL_UNSIGNED_INT_VEC3: glGetUniformuiv(from, source, u); glUniform3uiv(target, 1, u); break;
+			case GL_UNSIGNED_INT_VEC4: glGetUniformuiv(from, source, u); glUniform4uiv(target, 1, u); break;
+			case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT3x2:
+			case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3:
+				break; // unused here
+			default: // int, bool & samplers
+				glGetUniformiv(from, source, v);
+				glUniform1iv(target, 1, v);
+			}
+		}
+	}
+}
+
+void Shader::beginBuildAll() {
+	if (GLExt.parallelShaderCompile)
+		GLExt.MaxShaderCompilerThreads(0xFFFFFFFF); // let the driver pick the thread count
+
+	for (Shader* shader : registry()) {
+		if (shader->_state == BuildState::None)
+			shader->beginBuild();
+	}
+}
+
+bool Shader::pollBuildAll() {
+	bool done = true;
+	for (Shader* shader : registry()) {
+		if (shader->_state != BuildState::Compiling)
+			continue;
+		if (shader->isBuildComplete())
+			shader->finishBuild();
+		else
+			done = false;
+	}
+	return done;
+}
+
+void Shader::finishBuildAll() {
+	/* finish whatever is ready first, so the slowest program is the only one we wait on */
+	while (!pollBuildAll())
+		std::this_thread::yield();
+}
+
+bool Shader::dependsOn(const std::string& path) const {
+	return std::find(_vertexFiles.begin(), _vertexFiles.end(), path) != _vertexFiles.end()
+		|| std::find(_fragmentFiles.begin(), _fragmentFiles.end(), path) != _fragmentFiles.end();
+}
+
+bool Shader::reload() {
+	if (!readSources())
+		return false; // keeps the sources & program it has
+	beginBuild();
+	return true;
+}
+
+void Shader::enableHotReload() {
+	std::unique_ptr<FileWatcher>& watcher = hotReloadWatcher();
+	if (watcher)
+		return;
+	watcher = std::make_unique<FileWatcher>();
+	for (Shader* shader : registry()) {
+		for (const std::string& file : shader->_vertexFiles)
+			watcher->watch(file);
+		for (const std::string& file : shader->_fragmentFiles)
+			watcher->watch(file);
+	}
+}
+
+bool Shader::pollHotReload() {
+	FileWatcher* watcher = hotReloadWatcher().get();
+	if (!watcher)
+		return false;
+
+	/* only programs in use are rebuilt, a permutation never requested stays unbuilt */
+	std::vector<std::string> changed;
+	if (watcher->poll(changed)) {
+		for (const std::string& path : changed) {
+			std::cout << "Shader file changed : " << path << std::endl;
+			for (Shader* shader : registry()) {
+				if (shader->_state != BuildState::None && shader->dependsOn(path))
+					shader->_reloadPending = true;
+			}
+		}
+	}
+
+	unsigned int replaced = _replaced;
+	for (Shader* shader : registry()) {
+		if (shader->_reloadPending && shader->_state != BuildState::Compiling) {
+			shader->_reloadPending = false;
+			shader->reload();
+		}
+	}
+	pollBuildAll();
+	return _replaced != replaced;
+}
+
+void Shader::cacheUniformLocations() {
+	_uniformLocations.clear();
+
+	int count = 0, maxLength = 0;
+	glGetProgramiv(_id, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::string name(maxLength, '\0');
+
+	for (int i = 0; i < count; ++i) {
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type;
+		glGetActiveUniform(_id, (GLuint)i, maxLength, &length, &size, &type, &name[0]);
+
+		/* members of uniform blocks have no location, they're fed by a UBO */
+		GLuint index = (GLuint)i;
+		GLint blockIndex = -1;
+		glGetActiveUniformsiv(_id, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+		if (blockIndex != -1)
+			continue;
+
+		std::string uniformName = name.substr(0, length);
+		_uniformLocations[uniformName] = glGetUniformLocation(_id, uniformName.c_str());
+
+		/* arrays are reported once as "name[0]" : register "name" and every element */
+		size_t bracket = uniformName.find('[');
+		if (size > 1 && bracket != std::string::npos) {
+			std::string base = uniformName.substr(0, bracket);
+			_uniformLocations[base] = _uniformLocations[uniformName];
+			for (int element = 1; element < size; ++element) {
+				std::string elementName = base + "[" + std::to_string(element) + "]";
+				_uniformLocations[elementName] = glGetUniformLocation(_id, elementName.c_str());
+			}
+		}
+	}
+}
+
+Uniform Shader::uniform(const std::string& name) const {
+	Uniform u;
+	auto it = _uniformLocations.find(name);
+	if (it != _uniformLocations.end())
+		u.location = it->second;
+	return u;
 }
 
 void Shader::use() {
-	glUseProgram(_id);
+	glState.useProgram(_id); // elided when already current
 }
 
-/* Utility uniform functions */
+void Shader::bindUniformBlock(const std::string& name, unsigned int binding) const {
+	unsigned int blockIndex = glGetUniformBlockIndex(_id, name.c_str());
+	if (blockIndex == GL_INVALID_INDEX) // block unused or optimized out by the linker
+		return;
+	glUniformBlockBinding(_id, blockIndex, binding);
+}
+
+/* Utility uniform functions : location comes from the table, no GL query */
 void Shader::setBool(const std::string& name, bool value) const {
-	glUniform1i(glGetUniformLocation(_id, name.c_str()), (int)value);
+	setBool(uniform(name), value);
 }
 void Shader::setInt(const std::string& name, int value) const {
-	glUniform1i(glGetUniformLocation(_id, name.c_str()), value);
+	setInt(uniform(name), value);
 }
 void Shader::setFloat(const std::string& name, float value) const {
-	glUniform1f(glGetUniformLocation(_id, name.c_str()), value);
+	setFloat(uniform(name), value);
 }
 void Shader::setMat4(const std::string& name, glm::mat4 mat) const {
-	glUniformMatrix4fv(glGetUniformLocation(_id, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+	setMat4(uniform(name), mat);
 }
 void Shader::setVec3(const std::string& name, glm::vec3 vec) const {
-	glUniform3fv(glGetUniformLocation(_id, name.c_str()), 1, &vec[0]);
+	setVec3(uniform(name), vec);
 }
 void Shader::setVec3(const std::string& name, float x, float y, float z) const {
-	glUniform3f(glGetUniformLocation(_id, name.c_str()), x, y, z);
+	setVec3(uniform(name), x, y, z);
+}
+
+/* Pre-resolved handles */
+void Shader::setBool(Uniform u, bool value) const {
+	glUniform1i(u.location, (int)value);
+}
+void Shader::setInt(Uniform u, int value) const {
+	glUniform1i(u.location, value);
+}
+void Shader::setFloat(Uniform u, float value) const {
+	glUniform1f(u.location, value);
+}
+void Shader::setMat4(Uniform u, const glm::mat4& mat) const {
+	glUniformMatrix4fv(u.location, 1, GL_FALSE, glm::value_ptr(mat));
+}
+void Shader::setVec3(Uniform u, const glm::vec3& vec) const {
+	glUniform3fv(u.location, 1, &vec[0]);
+}
+void Shader::setVec3(Uniform u, float x, float y, float z) const {
+	glUniform3f(u.location, x, y, z);
 }
\ No newline at end of file
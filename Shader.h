@@ -9,18 +9,81 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <map>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/* Pre-resolved uniform location. Look it up once with Shader::uniform() after build(),
+then the setters below do no string work and no GL queries. */
+struct Uniform {
+	int location = -1; // -1 : not active in the program, glUniform* silently ignores it
+};
+
+/* #define lines for one shader permutation, injected right after #version.
+Kept sorted by name so equal sets give equal keys, whatever order they were set in. */
+class ShaderDefines
+{
+public:
+	ShaderDefines& set(const std::string& name, const std::string& value = "1");
+	ShaderDefines& set(const std::string& name, int value);
+
+	bool empty() const { return _defines.empty(); }
+	std::string key() const; // "NAME=VALUE;..." in name order
+	std::string inject(const std::string& source) const; // #line keeps error messages on the file's lines
+
+private:
+	std::map<std::string, std::string> _defines;
+};
 
 class Shader
 {
 public:
-	unsigned int _id; // Program ID;
+	unsigned int _id = 0; // Program ID;
 	std::string _vertexSource;
 	std::string _fragmentSource;
 
-	Shader(const char* vertexPath, const char* fragmentPath);
+	enum class BuildState { None, Compiling, Ready, Failed };
+
+	Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines());
+	~Shader();
+	Shader(const Shader&) = delete; // registered by address, see registry()
+	Shader& operator=(const Shader&) = delete;
+
+	void build(); // synchronous : beginBuild() + finishBuild()
+	void beginBuild(); // issue compile & link without waiting for the driver
+	bool isBuildComplete() const; // non-blocking with KHR_parallel_shader_compile
+	void finishBuild(); // check status, log errors, fill the uniform table
+	BuildState buildState() const { return _state; }
+
+	/* Every constructed Shader is registered, so all programs can be compiled
+	in parallel while the app keeps setting up buffers and textures. */
+	static void beginBuildAll();
+	static bool pollBuildAll(); // finishes the programs that are done, true once all are
+	static void finishBuildAll(); // wait for the rest
+
+	/* One Shader per (vertex file, fragment file, defines), created on first request and
+	kept for the program's lifetime. A new permutation is only registered, not built :
+	requested before beginBuildAll() it compiles with the others, later buildState()
+	is None and the caller builds it. The defines are part of the sources, so each
+	permutation also gets its own ProgramCache entry. */
+	static Shader& permutation(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines);
+	static size_t permutationCount() { return permutations().size(); }
+
+	/* Hot reload : once enabled, every file a Shader is expanded from is watched and
+	pollHotReload() rebuilds the programs depending on a changed file, polled like
+	pollBuildAll() so the driver compiles in the background when it can. The current
+	program stays in use until the new one links, a failed edit keeps it. */
+	static void enableHotReload();
+	static bool pollHotReload(); // true when a program was replaced : Uniform handles must be resolved again
+	bool reload(); // re-read the files & begin the build, false when they can't be read
+	bool dependsOn(const std::string& path) const; // normalized, see ShaderPreprocessor
 
-	void build();
 	void use(); // use/activate Shader Program
+	void bindUniformBlock(const std::string& name, unsigned int binding) const; // attach a uniform block to a UBO binding point
+
+	Uniform uniform(const std::string& name) const; // resolve a handle from the location table
 
 	/* Utility uniform functions */
 	void setBool(const std::string& name, bool value) const;
@@ -29,6 +92,38 @@ public:
 	void setMat4(const std::string& name, glm::mat4 mat) const;
 	void setVec3(const std::string& name, glm::vec3 vec) const;
 	void setVec3(const std::string& name, float x, float y, float z) const;
+
+	/* Hot path : pre-resolved handles */
+	void setBool(Uniform u, bool value) const;
+	void setInt(Uniform u, int value) const;
+	void setFloat(Uniform u, float value) const;
+	void setMat4(Uniform u, const glm::mat4& mat) const;
+	void setVec3(Uniform u, const glm::vec3& vec) const;
+	void setVec3(Uniform u, float x, float y, float z) const;
+
+private:
+	std::unordered_map<std::string, int> _uniformLocations; // active uniforms, filled after linking
+
+	BuildState _state = BuildState::None;
+	unsigned int _building = 0; // program being built, replaces _id once linked
+	unsigned int _vertexShader = 0, _fragmentShader = 0; // alive while compiling
+	bool _linked = false; // _id has linked at least once
+	bool _reloadPending = false; // a file changed while the previous reload was compiling
+
+	std::string _vertexPath, _fragmentPath;
+	ShaderDefines _defines;
+	std::vector<std::string> _vertexFiles, _fragmentFiles; // what each stage was expanded from, by #line file number
+	bool _useCache = false;
+	uint64_t _cacheKey = 0;
+
+	static std::vector<Shader*>& registry();
+	static std::unordered_map<std::string, std::unique_ptr<Shader>>& permutations();
+	static unsigned int _replaced; // programs swapped for a reloaded one so far
+
+	bool readSources();
+	void adopt(); // _building linked, it becomes _id
+	void cacheUniformLocations();
+	static void copyProgramState(unsigned int from, unsigned int to);
 };
 
 #endif
\ No newline at end of file
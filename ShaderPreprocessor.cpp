@@ -0,0 +1,92 @@
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+
+std::string ShaderPreprocessor::normalizePath(const std::string& path) {
+	return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+bool ShaderPreprocessor::load(const std::string& path, std::string& source, std::vector<std::string>& files) {
+	source.clear();
+	files.assign(1, normalizePath(path));
+	return expand(files[0], 0, source, files);
+}
+
+/* "#include" after optional blanks, blanks also allowed after the '#' */
+static bool includeDirective(const std::string& line, std::string& name) {
+	size_t i = line.find_first_not_of(" \t");
+	if (i == std::string::npos || line[i] != '#')
+		return false;
+	i = line.find_first_not_of(" \t", i + 1);
+	if (i == std::string::npos || line.compare(i, 7, "include") != 0)
+		return false;
+
+	size_t open = line.find_first_of("\"<", i + 7);
+	if (open == std::string::npos)
+		return false;
+	size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+	if (close == std::string::npos)
+		return false;
+	name = line.substr(open + 1, close - open - 1);
+	return true;
+}
+
+bool ShaderPreprocessor::expand(const std::string& path, unsigned int fileNumber, std::string& source,
+	std::vector<std::string>& files) {
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ERROR: SHADER: File Not Successfully Read : " << path << std::endl;
+		return false;
+	}
+
+	std::string line, name;
+	unsigned int lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+		if (!includeDirective(line, name)) {
+			source += line;
+			source += '\n';
+			continue;
+		}
+
+		std::string includePath = normalizePath((std::filesystem::path(path).parent_path() / name).string());
+		if (std::find(files.begin(), files.end(), includePath) != files.end()) {
+			source += "// " + line + " : included already\n"; // keeps the line count
+			continue;
+		}
+
+		unsigned int includeNumber = (unsigned int)files.size();
+		files.push_back(includePath);
+		source += "#line 1 " + std::to_string(includeNumber) + "\n";
+		if (!expand(includePath, includeNumber, source, files)) {
+			std::cout << "ERROR::SHADER::INCLUDE_FAILED " << includePath << " (" << path << ":" << lineNumber << ")" << std::endl;
+			return false;
+		}
+		/* the next line of this file */
+		source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileNumber) + "\n";
+	}
+	return true;
+}
+
+std::string ShaderPreprocessor::annotateLog(const std::string& log, const std::vector<std::string>& files) {
+	/* "0:12(5): error" (Mesa), "0(12) : error" (NVIDIA), "ERROR: 0:12: " (AMD, Intel) */
+	static const std::regex location(R"(^(\s*(?:ERROR|WARNING): )?(\d+)([:(])(\d+))");
+
+	std::istringstream lines(log);
+	std::string line, annotated;
+	std::smatch match;
+	while (std::getline(lines, line)) {
+		if (std::regex_search(line, match, location)) {
+			unsigned long fileNumber = std::stoul(match[2].str());
+			if (fileNumber < files.size())
+				line = match[1].str() + files[fileNumber] + match[3].str() + match[4].str() + match.suffix().str();
+		}
+		annotated += line + "\n";
+	}
+	return annotated;
+}
\ No newline at end of file
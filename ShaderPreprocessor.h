@@ -0,0 +1,29 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <string>
+#include <vector>
+
+/* GLSL has no #include : load() expands #include "file", relative to the including
+file, before the source goes to the driver. A file is included at most once per
+stage, an implicit include guard, so shared files can include what they need.
+
+files lists every file the stage was expanded from, the root first. An included
+file is framed with #line <line> <position in files>, so the driver reports its
+errors as "<file number>:<line>" and annotateLog() puts the names back. */
+class ShaderPreprocessor
+{
+public:
+	/* false, with the error printed, when the file or one of its includes can't be read */
+	static bool load(const std::string& path, std::string& source, std::vector<std::string>& files);
+
+	static std::string annotateLog(const std::string& log, const std::vector<std::string>& files);
+
+	static std::string normalizePath(const std::string& path); // "./shaders/x.glsl" -> "shaders/x.glsl"
+
+private:
+	static bool expand(const std::string& path, unsigned int fileNumber, std::string& source,
+		std::vector<std::string>& files);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "TextureCache.h"
+#include "Hash.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+std::string TextureCache::directory = "./texture_cache";
+bool TextureCache::enabled = true;
+TextureCache::Stats TextureCache::_stats;
+
+namespace {
+	const char CACHE_MAGIC[4] = { 'G', 'L', 'T', 'X' };
+	const uint32_t CACHE_VERSION = 1;
+	const uint64_t DATA_ALIGNMENT = 64;
+
+	/* followed by the levels, then the data at dataOffset */
+	struct CacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint64_t sourceHash;
+		uint64_t sourceSize;
+		uint32_t internalFormat;
+		uint32_t format;
+		uint32_t blockFormat;
+		uint32_t levelCount;
+		double psnr;
+		uint64_t dataOffset;
+		uint64_t dataSize;
+	};
+}
+
+uint64_t TextureCache::key(const std::string& sourcePath, const std::string& options) {
+	std::string normalized = std::filesystem::path(sourcePath).lexically_normal().generic_string();
+	uint64_t hash = hashBytes(HASH_SEED, normalized.c_str(), normalized.size() + 1); // keep the '\0' as a separator
+	return hashBytes(hash, options.c_str(), options.size());
+}
+
+bool TextureCache::hashFile(const std::string& path, uint64_t& hash, uint64_t& size) {
+	MappedFile file;
+	if (!file.open(path))
+		return false;
+	hash = hashBytes(HASH_SEED, file.data(), file.size());
+	size = file.size();
+	return true;
+}
+
+std::string TextureCache::path(uint64_t key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)key);
+	return directory + "/" + name;
+}
+
+bool TextureCache::load(uint64_t key, uint64_t sourceHash, uint64_t sourceSize, Entry& entry) {
+	std::string file = path(key);
+	if (!entry.file.open(file)) {
+		_stats.misses++;
+		return false;
+	}
+
+	const unsigned char* bytes = entry.file.data();
+	const size_t size = entry.file.size();
+	CacheHeader header;
+	bool valid = size >= sizeof(header);
+	if (valid) {
+		memcpy(&header, bytes, sizeof(header));
+		valid = memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 && header.version == CACHE_VERSION
+			&& header.key == key && header.levelCount > 0 && header.levelCount <= 32
+			&& sizeof(header) + header.levelCount * sizeof(TextureLevel) <= header.dataOffset
+			&& header.dataOffset <= size && header.dataSize <= size - header.dataOffset;
+	}
+	if (valid && (header.sourceHash != sourceHash || header.sourceSize != sourceSize)) {
+		/* the image changed : overwritten by the caller's store() */
+		entry.file.close();
+		_stats.invalidations++;
+		return false;
+	}
+
+	TexturePayload& payload = entry.payload;
+	if (valid) {
+		payload.levels.resize(header.levelCount);
+		memcpy(payload.levels.data(), bytes + sizeof(header), header.levelCount * sizeof(TextureLevel));
+		for (const TextureLevel& level : payload.levels)
+			valid = valid && level.offset <= header.dataSize && level.size <= header.dataSize - level.offset;
+	}
+	if (!valid) {
+		/* truncated or from another build : drop it, the caller decodes */
+		entry.file.close();
+		_stats.invalidations++;
+		std::error_code ec;
+		std::filesystem::remove(file, ec);
+		return false;
+	}
+
+	payload.internalFormat = header.internalFormat;
+	payload.format = header.format;
+	payload.blockFormat = (BlockFormat)header.blockFormat;
+	payload.psnr = header.psnr;
+	payload.data = bytes + header.dataOffset;
+	payload.size = (size_t)header.dataSize;
+	entry.file.touch(); // page faults here, not in the GL thread's upload
+	_stats.hits++;
+	return true;
+}
+
+void TextureCache::store(uint64_t key, uint64_t sourceHash, uint64_t sourceSize, const TexturePayload& payload) {
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.key = key;
+	header.sourceHash = sourceHash;
+	header.sourceSize = sourceSize;
+	header.internalFormat = payload.internalFormat;
+	header.format = payload.format;
+	header.blockFormat = (uint32_t)payload.blockFormat;
+	header.levelCount = (uint32_t)payload.levels.size();
+	header.psnr = payload.psnr;
+	uint64_t tableEnd = sizeof(header) + payload.levels.size() * sizeof(TextureLevel);
+	header.dataOffset = (tableEnd + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+	header.dataSize = payload.size;
+
+	/* written aside then renamed over : a reader never maps half a file */
+	std::string file = path(key);
+	std::string temporary = file + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			std::cout << "WARNING::TEXTURE_CACHE::CANNOT_WRITE " << file << std::endl;
+			return;
+		}
+		static const char padding[DATA_ALIGNMENT] = {};
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)payload.levels.data(), payload.levels.size() * sizeof(TextureLevel));
+		out.write(padding, header.dataOffset - tableEnd);
+		out.write((const char*)payload.data, payload.size);
+		if (!out) {
+			out.close();
+			std::filesystem::remove(temporary, ec);
+			std::cout << "WARNING::TEXTURE_CACHE::CANNOT_WRITE " << file << std::endl;
+			return;
+		}
+	}
+	std::filesystem::rename(temporary, file, ec);
+	if (ec) {
+		std::filesystem::remove(temporary, ec);
+		std::cout << "WARNING::TEXTURE_CACHE::CANNOT_WRITE " << file << std::endl;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "BlockCompression.h"
+#include "MappedFile.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct TextureLevel {
+	int32_t width, height;
+	uint64_t offset, size; // bytes in TexturePayload::data
+};
+
+/* Everything the upload needs, as stored in a cache file */
+struct TexturePayload {
+	uint32_t internalFormat = 0; // GL enum
+	uint32_t format = 0; // pixel format of glTexImage2D, 0 : compressed levels
+	std::vector<TextureLevel> levels; // largest first, one level : glGenerateMipmap makes the others
+	const unsigned char* data = nullptr; // owned by whoever filled the payload
+	size_t size = 0;
+	BlockFormat blockFormat = BlockFormat::None; // for the log
+	double psnr = 0.0; // compressed only
+};
+
+/* On-disk cache of the payloads TextureLoader uploads : every mip level in its final
+format, already flipped & compressed. One file per source path & load options, named
+by their hash, the header keeps a hash of the source bytes : an edited image misses
+and gets rewritten. A hit is mapped, the levels go to GL straight from the mapping.
+Called from the decode threads. */
+class TextureCache
+{
+public:
+	struct Stats {
+		std::atomic<unsigned int> hits{ 0 };
+		std::atomic<unsigned int> misses{ 0 };
+		std::atomic<unsigned int> invalidations{ 0 }; // entry found but stale or corrupt
+	};
+
+	/* A hit : the payload points into the mapping */
+	struct Entry {
+		MappedFile file;
+		TexturePayload payload;
+	};
+
+	static std::string directory;
+	static bool enabled;
+
+	/* options : whatever changes the payload besides the source bytes */
+	static uint64_t key(const std::string& sourcePath, const std::string& options);
+	static bool hashFile(const std::string& path, uint64_t& hash, uint64_t& size); // false when unreadable
+
+	static bool load(uint64_t key, uint64_t sourceHash, uint64_t sourceSize, Entry& entry);
+	static void store(uint64_t key, uint64_t sourceHash, uint64_t sourceSize, const TexturePayload& payload);
+
+	static const Stats& stats() { return _stats; }
+
+private:
+	static Stats _stats;
+
+	static std::string path(uint64_t key);
+};
+
+#endif
\ No newline at end of file
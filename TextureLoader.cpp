@@ -0,0 +1,297 @@
+#include "TextureLoader.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "Profiler.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static double millisecondsSince(std::chrono::steady_clock::time_point begin) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+TextureLoader::~TextureLoader() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_wake.notify_all();
+	for (std::thread& worker : _workers)
+		worker.join();
+	for (Image& image : _images)
+		stbi_image_free(image.pixels);
+}
+
+void TextureLoader::init(unsigned int workerCount) {
+	glGenBuffers(1, &_pbo);
+
+	for (unsigned int i = 0; i < workerCount; ++i)
+		_workers.emplace_back(&TextureLoader::workerLoop, this, i);
+	if (workerCount > 0)
+		std::cout << "Texture loader : " << workerCount << " decode threads" << std::endl;
+}
+
+void TextureLoader::setCompression(BlockFormat format, CompressionQuality quality) {
+	_format = format;
+	_quality = quality;
+}
+
+unsigned int TextureLoader::load(const std::string& path, bool flipVertically) {
+	if (!std::ifstream(path)) {
+		std::cout << "Failed to load texture : " << path << std::endl;
+		return 0;
+	}
+
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // the pixels below come from client memory
+	glState.bindTexture(0, GL_TEXTURE_2D, texture);
+	static const unsigned char grey[4] = { 128, 128, 128, 255 };
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+	glGenerateMipmap(GL_TEXTURE_2D); // complete with the default mipmapped filter
+
+	_pending++;
+	_stats.requested++;
+	if (_workers.empty()) {
+		Image image = decode(path, flipVertically, _format, _quality, std::max(std::thread::hardware_concurrency(), 1u));
+		image.texture = texture;
+		upload(image);
+		return texture;
+	}
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs.push_back({ texture, path, flipVertically, _format, _quality });
+	}
+	_wake.notify_one();
+	return texture;
+}
+
+bool TextureLoader::update(float budgetMs) {
+	if (_pending == 0)
+		return true;
+
+	/* at least one upload per call, so a large image can't stall the queue */
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for (;;) {
+		Image image;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_images.empty())
+				break;
+			image = std::move(_images.front());
+			_images.pop_front();
+		}
+		upload(image);
+		if (millisecondsSince(begin) >= budgetMs)
+			break;
+	}
+	return _pending == 0;
+}
+
+void TextureLoader::finish() {
+	while (_pending > 0) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_decoded.wait(lock, [this] { return !_images.empty(); });
+		}
+		update(INFINITY);
+	}
+}
+
+bool TextureLoader::failed(unsigned int texture) const {
+	return texture == 0 || std::find(_failed.begin(), _failed.end(), texture) != _failed.end();
+}
+
+void TextureLoader::upload(Image& image) {
+	_pending--;
+	_stats.decodeMs += image.decodeMs;
+	_stats.compressMs += image.compressMs;
+	if (!image.decoded) {
+		std::cout << "Failed to load texture : " << image.path << " (" << (image.failure.empty() ? "unknown error" : image.failure) << ")" << std::endl;
+		_stats.failed++;
+		_failed.push_back(image.texture);
+		return; // the placeholder stays
+	}
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	const TexturePayload& payload = image.payload;
+
+	/* Orphaned, then mapped : a transfer still reading the previous image keeps its
+	storage, and glTexImage2D returns once the driver has queued the copy.
+	A cache hit skips it, the driver copies straight from the file mapping. */
+	bool staged = false;
+	if (!image.cached.isOpen()) {
+		glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, payload.size, NULL, GL_STREAM_DRAW);
+		void* staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, payload.size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (staging) {
+			memcpy(staging, payload.data, payload.size);
+			staged = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE; // false : the store got lost, rare
+		}
+	}
+	if (!staged)
+		glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // straight from client memory
+
+	glState.bindTexture(0, GL_TEXTURE_2D, image.texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // rows of RGB images are not 4-byte aligned
+	for (size_t i = 0; i < payload.levels.size(); ++i) {
+		const TextureLevel& level = payload.levels[i];
+		const void* pixels = staged ? (const void*)level.offset : (const void*)(payload.data + level.offset);
+		if (payload.format == 0)
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, payload.internalFormat, level.width, level.height, 0,
+				(GLsizei)level.size, pixels);
+		else
+			glTexImage2D(GL_TEXTURE_2D, (GLint)i, (GLint)payload.internalFormat, level.width, level.height, 0,
+				payload.format, GL_UNSIGNED_BYTE, pixels);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (payload.levels.size() == 1 && (payload.levels[0].width > 1 || payload.levels[0].height > 1))
+		glGenerateMipmap(GL_TEXTURE_2D);
+	glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (payload.blockFormat != BlockFormat::None) {
+		_stats.minPsnr = std::min(_stats.minPsnr, payload.psnr);
+		std::cout << "Texture " << image.path << " : " << blockFormatName(payload.blockFormat) << ", "
+			<< payload.levels.size() << " levels, PSNR " << payload.psnr << " dB, "
+			<< (image.cached.isOpen() ? "cached" : "compressed in " + std::to_string(image.compressMs) + " ms") << std::endl;
+	}
+
+	stbi_image_free(image.pixels);
+	image.pixels = nullptr;
+	image.levels.clear();
+	image.cached.close();
+	_stats.resident++;
+	_stats.uploadedBytes += payload.size;
+	_stats.uploadMs += millisecondsSince(begin);
+}
+
+void TextureLoader::workerLoop(unsigned int index) {
+	std::string name = "TextureDecode " + std::to_string(index + 1);
+	Profiler::setThreadName(name.c_str());
+
+	for (;;) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [this] { return _quit || !_jobs.empty(); });
+			if (_quit)
+				return;
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+		}
+
+		/* the pool already spreads the images over the cores */
+		Image image = decode(job.path, job.flipVertically, job.format, job.quality, 1);
+		image.texture = job.texture;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_images.push_back(std::move(image));
+		}
+		_decoded.notify_one();
+	}
+}
+
+/* Levels of 8-bit pixels, the first one in place */
+static void buildMipmaps(TextureLoader::Image& image, int width, int height, int channels) {
+	TexturePayload& payload = image.payload;
+	std::vector<unsigned char> level, next;
+	size_t size = (size_t)width * height * channels;
+	image.levels.assign(image.pixels, image.pixels + size);
+	const unsigned char* source = image.pixels;
+	for (int w = width, h = height; w > 1 || h > 1; ) {
+		downsample(source, w, h, channels, next);
+		w = std::max(w / 2, 1);
+		h = std::max(h / 2, 1);
+		payload.levels.push_back({ w, h, image.levels.size(), next.size() });
+		image.levels.insert(image.levels.end(), next.begin(), next.end());
+		level.swap(next);
+		source = level.data();
+	}
+}
+
+TextureLoader::Image TextureLoader::decode(const std::string& path, bool flipVertically, BlockFormat format,
+	CompressionQuality quality, unsigned int compressThreads) {
+	Image image;
+	image.path = path;
+	TexturePayload& payload = image.payload;
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+	/* everything that changes the payload besides the file itself */
+	uint64_t key = 0, sourceHash = 0, sourceSize = 0;
+	bool cacheable = TextureCache::enabled && TextureCache::hashFile(path, sourceHash, sourceSize);
+	if (cacheable) {
+		PROFILE_ZONE("TextureCache");
+		std::string options = "flip=" + std::to_string(flipVertically) + ";format=" + blockFormatName(format);
+		if (format != BlockFormat::None)
+			options += ";quality=" + std::to_string((int)quality);
+		key = TextureCache::key(path, options);
+		TextureCache::Entry entry;
+		if (TextureCache::load(key, sourceHash, sourceSize, entry)) {
+			image.payload = std::move(entry.payload);
+			image.cached = std::move(entry.file);
+			image.decoded = true;
+			image.decodeMs = millisecondsSince(begin);
+			return image;
+		}
+	}
+
+	int width, height, channels;
+	{
+		PROFILE_ZONE("Decode");
+		stbi_decoder decoder; // settings & failure of this call only, the pool threads decode side by side
+		stbi_decoder_init(&decoder);
+		decoder.flip_vertically = flipVertically;
+		image.pixels = stbi_decoder_load_mmap(&decoder, path.c_str(), &width, &height, &channels, format == BlockFormat::None ? 0 : 4); // the encoder reads RGBA
+		image.decodeMs = millisecondsSince(begin);
+		image.decoded = image.pixels != nullptr;
+		if (!image.decoded) {
+			image.failure = decoder.failure_reason ? decoder.failure_reason : "";
+			return image;
+		}
+	}
+
+	if (format != BlockFormat::None) {
+		PROFILE_ZONE("Compress");
+		begin = std::chrono::steady_clock::now();
+		if (format == BlockFormat::BC1 && hasTransparency(image.pixels, (size_t)width * height))
+			format = BlockFormat::BC3;
+		CompressedImage compressed = compressMipmaps(image.pixels, width, height, format, quality, compressThreads);
+		stbi_image_free(image.pixels);
+		image.pixels = nullptr;
+		image.levels = std::move(compressed.data);
+		for (const CompressedLevel& level : compressed.levels)
+			payload.levels.push_back({ level.width, level.height, level.offset, level.size });
+		payload.internalFormat = format == BlockFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+			: format == BlockFormat::BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		payload.blockFormat = format;
+		payload.psnr = compressed.psnr;
+		image.compressMs = millisecondsSince(begin);
+	}
+	else {
+		static const GLenum formats[5] = { 0, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+		static const GLenum internalFormats[5] = { 0, GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+		payload.internalFormat = internalFormats[channels];
+		payload.format = formats[channels];
+		payload.levels.push_back({ width, height, 0, (uint64_t)width * height * channels });
+		if (cacheable) {
+			/* the cache keeps every level, glGenerateMipmap can't be skipped otherwise */
+			PROFILE_ZONE("Mipmaps");
+			begin = std::chrono::steady_clock::now();
+			buildMipmaps(image, width, height, channels);
+			stbi_image_free(image.pixels);
+			image.pixels = nullptr;
+			image.compressMs = millisecondsSince(begin);
+		}
+	}
+	payload.data = image.pixels ? image.pixels : image.levels.data();
+	payload.size = image.pixels ? (size_t)payload.levels[0].size : image.levels.size();
+
+	if (cacheable)
+		TextureCache::store(key, sourceHash, sourceSize, payload);
+	return image;
+}
\ No newline at end of file
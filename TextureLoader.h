@@ -0,0 +1,110 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include "TextureCache.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Asynchronous 2D textures.
+load() returns the texture name at once, holding a 1x1 grey placeholder, and
+queues the file for a pool of decode threads (stb_image). The GL thread picks
+the decoded images up in update() : each one is copied into a pixel buffer
+object and the texture is re-specified from it, so the transfer itself runs
+asynchronously in the driver. update() stops after budgetMs, a burst of
+finished images is spread over several frames instead of stalling one.
+
+With compression set, the decode threads also build the mip chain and encode it
+(see BlockCompression.h), every level then goes up with glCompressedTexImage2D.
+With TextureCache enabled the finished levels are stored, the next run maps them
+instead of decoding and uploads from the mapping without the staging copy.
+
+The name never changes, whatever was bound or queued with the placeholder
+shows the real image once it is resident. */
+class TextureLoader
+{
+public:
+	static constexpr float DEFAULT_BUDGET_MS = 2.0f;
+
+	struct Stats {
+		unsigned int requested = 0;
+		unsigned int resident = 0;
+		unsigned int failed = 0; // keep the placeholder
+		double decodeMs = 0.0; // summed over the decode threads, cache lookups included
+		double compressMs = 0.0; // same, mipmaps & block compression
+		double minPsnr = 100.0; // worst of the compressed textures, in dB
+		double uploadMs = 0.0; // GL thread : staging copies & glTex(Compressed)Image2D
+		size_t uploadedBytes = 0;
+	};
+
+	TextureLoader() = default;
+	~TextureLoader();
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	/* Once the context is current. No worker : load() decodes & uploads before returning,
+	compressing over every core. */
+	void init(unsigned int workerCount);
+
+	/* For the following load() calls, BlockFormat::None uploads 8-bit data.
+	BC1 has no alpha : images with some transparency get BC3 instead. */
+	void setCompression(BlockFormat format, CompressionQuality quality);
+
+	/* 0, with the error printed, when the file can't be opened */
+	unsigned int load(const std::string& path, bool flipVertically = true);
+
+	bool update(float budgetMs = DEFAULT_BUDGET_MS); // true once nothing is pending
+	void finish(); // wait for every pending texture and upload it, regardless of the budget
+	bool done() const { return _pending == 0; }
+	bool failed(unsigned int texture) const; // load() returned 0, or the image keeps the placeholder
+	const Stats& stats() const { return _stats; }
+
+	struct Image {
+		unsigned int texture = 0;
+		std::string path;
+		bool decoded = false;
+		std::string failure; // the decoder's failure reason, copied : it may point into the decoder
+		TexturePayload payload; // its data lives in one of the three below
+		unsigned char* pixels = nullptr; // stb_image allocation
+		std::vector<unsigned char> levels; // built mipmaps or compressed blocks
+		MappedFile cached; // a cache hit
+		double decodeMs = 0.0, compressMs = 0.0;
+	};
+
+	/* What the decode threads do for load() : cache lookup, else stb_image, mipmaps,
+	compression & cache store. No GL call, also run by --bench-texture-cache. */
+	static Image decode(const std::string& path, bool flipVertically, BlockFormat format,
+		CompressionQuality quality, unsigned int compressThreads);
+
+private:
+	struct Job {
+		unsigned int texture;
+		std::string path;
+		bool flipVertically;
+		BlockFormat format;
+		CompressionQuality quality;
+	};
+
+	std::vector<std::thread> _workers;
+	std::mutex _mutex;
+	std::condition_variable _wake, _decoded;
+	std::deque<Job> _jobs;
+	std::deque<Image> _images; // decoded, waiting for the GL thread
+	bool _quit = false;
+
+	unsigned int _pending = 0; // requested, neither resident nor failed yet
+	std::vector<unsigned int> _failed; // textures whose image didn't decode
+	unsigned int _pbo = 0;
+	BlockFormat _format = BlockFormat::None;
+	CompressionQuality _quality = CompressionQuality::Normal;
+	Stats _stats;
+
+	void workerLoop(unsigned int index);
+	void upload(Image& image);
+};
+
+#endif
\ No newline at end of file
@@ -3,6 +3,15 @@
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
+#include <vector>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <filesystem>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -10,12 +19,33 @@
 
 #include "Shader.h"
 #include "Camera.h"
-#include "stb_image.h"
+#include "FrameData.h"
+#include "GLExtensions.h"
+#include "ProgramCache.h"
+#include "GLState.h"
+#include "RenderQueue.h"
+#include "Frustum.h"
+#include "BVH.h"
+#include "Benchmarks.h"
+#include "Options.h"
+#include "FrameStats.h"
+#include "CameraPath.h"
+#include "Profiler.h"
+#include "GPUProfiler.h"
+#include "LightClusters.h"
+#include "DeferredRenderer.h"
+#include "DepthPrepass.h"
+#include "TextureLoader.h"
+#include "TextureCache.h"
+#include "Hash.h"
 
 const char* vertexShaderPath = "./shaders/vertexShader.glsl";
 const char* fragmentShaderPath = "./shaders/fragmentShader.glsl";
 const char* lightVertexPath = "./shaders/lightVertex.glsl";
 const char* lightFragmentPath = "./shaders/lightFragment.glsl";
+const char* instancedVertexPath = "./shaders/instancedVertex.glsl";
+const char* diffuseMapPath = "./images/container2.png";
+const char* specularMapPath = "./images/container2_specular.png";
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
@@ -33,55 +63,184 @@ std::string getFileContent(const std::string& path)
 
 class App {
 public:
-	void run() {
+	int run(const Options& runOptions) {
+		options = runOptions;
+		useDeferred = options.deferred;
+		useDepthPrepass = options.depthPrepass;
+		useSpotLight = options.spotLight;
+		Profiler::setThreadName("Main");
+		if (!options.replayPath.empty()) {
+			if (!cameraPath.load(options.replayPath))
+				return 1;
+			replaying = true;
+		}
 		initWindow();
 		initGLAD();
+		gpuProfiler.init();
 		setViewport();
-
-		setupShaderProgram();
+		if (options.headless)
+			setupOffscreenTarget();
+
+		startupBegin = glfwGetTime();
+		setupLights(); // no program needed, decides POINT_LIGHTS
+		hasSpecularMap = std::filesystem::exists(specularMapPath); // SPECULAR_MAP, before the image is decoded
+		requestForwardShaders();
+		if (asyncShaderBuild)
+			Shader::beginBuildAll(); // the driver compiles while we set up buffers & textures
+		setupUniformBuffer();
 		setupVertexArray();
+		setupInstanceBuffer();
 		setupTextures();
-		setupUserInput();
-		
-		renderLoop();
+		setupShaderProgram();
+		std::cout << "Startup : " << (glfwGetTime() - startupBegin) * 1000.0 << " ms ("
+			<< (asyncShaderBuild ? (GLExt.parallelShaderCompile ? "parallel" : "deferred") : "synchronous")
+			<< " shader build, " << (options.syncTextures ? "synchronous" : "asynchronous") << " "
+			<< blockFormatName(textureFormat) << " textures)" << std::endl;
+		int result = 0;
+		if (options.headless)
+			result = renderHeadless();
+		else {
+			setupUserInput();
+
+			renderLoop();
+		}
+
+		if (!options.tracePath.empty())
+			Profiler::writeTrace(options.tracePath);
 
 		glfwTerminate();
+		return result;
 	}
 
 	App(const char* vertexPath, const char* fragmentPath)
-		: shaderProgram(Shader(vertexPath, fragmentPath)), 
-		lightShader(Shader(lightVertexPath, lightFragmentPath))
+		: forwardVertexPath(vertexPath),
+		forwardFragmentPath(fragmentPath),
+		lightShader(Shader(lightVertexPath, lightFragmentPath)),
+		deferred(vertexPath, instancedVertexPath)
 	{
 		camera = Camera();
 		lightPos = glm::vec3(1.2f, 1.0f, 2.0f);
+
+		cubePositions = {
+			glm::vec3(0.0f,  0.0f,  0.0f),
+			glm::vec3(2.0f,  5.0f, -15.0f),
+			glm::vec3(-1.5f, -2.2f, -2.5f),
+			glm::vec3(-3.8f, -2.0f, -12.3f),
+			glm::vec3(2.4f, -0.4f, -3.5f),
+			glm::vec3(-1.7f,  3.0f, -7.5f),
+			glm::vec3(1.3f, -2.0f, -2.5f),
+			glm::vec3(1.5f,  2.0f, -2.5f),
+			glm::vec3(1.5f,  0.2f, -1.5f),
+			glm::vec3(-1.3f,  1.0f, -1.5f)
+		};
+		pointLightPositions = {
+			glm::vec3(0.7f,  0.2f,  2.0f),
+			glm::vec3(2.3f, -3.3f, -4.0f),
+			glm::vec3(-4.0f,  2.0f, -12.0f),
+			glm::vec3(0.0f,  0.0f, -3.0f)
+		};
 	}
 
 	void mouseInput(double xpos, double ypos) {
-		camera.mouseInput(xpos, ypos);
+		if (!replaying)
+			camera.mouseInput(xpos, ypos);
 	}
 	void scrollInput(double xoffset, double yoffset) {
-		camera.scrollInput(xoffset, yoffset);
+		if (!replaying)
+			camera.scrollInput(xoffset, yoffset);
 	}
 
 private:
+	Options options;
+	CameraPath cameraPath; // recorded into with --record-camera, played back with --replay-camera
+	bool replaying = false;
 	GLFWwindow* window;
-	Shader shaderProgram;
+	unsigned int offscreenFBO = 0;
+	unsigned int offscreenRBO[2] = { 0, 0 }; // color, depth-stencil
+	/* the forward cube programs are permutations of these, see forwardShader() */
+	const char* forwardVertexPath;
+	const char* forwardFragmentPath;
+	std::vector<Shader*> forwardShaders; // requested before the startup build, see requestForwardShaders()
 	Shader lightShader;
+	DeferredRenderer deferred; // owns the G-buffer programs, used when useDeferred
+	DepthPrepass depthPrepass; // depth-only programs & fragment counts, used when useDepthPrepass
 	Camera camera;
 	unsigned int VAO, lightVAO;
+	unsigned int instanceVBO;
+	unsigned int frameUBO;
+	FrameData frameData;
+	Uniform lightModelUniform, gbufferModelUniform, depthModelUniform; // resolved once after build()
+	RenderQueue renderQueue;
+	static const unsigned int MATERIAL_CONTAINER = 1; // material id in the sort key
 	unsigned int TexBox;
 	unsigned int TexBoxSpecular;
+	bool hasSpecularMap = false; // the file exists & decoded, without it the forward shader compiles the specular term out
+	TextureLoader textureLoader; // decodes on worker threads, uploads within a budget per frame
+	BlockFormat textureFormat = BlockFormat::None; // from --texture-compression & the context
+	double startupBegin = 0.0; // glfwGetTime()
+	double texturesResidentMs = -1.0; // since startupBegin, -1 until every texture is resident
 	glm::vec3 lightPos;
 
+	std::vector<glm::vec3> cubePositions;
+	std::vector<glm::vec3> pointLightPositions;
+	LightClusters lightClusters; // every point light, binned per frame for the fragment shader
+	BoundsSoA lightBounds; // light source cubes
+	std::vector<uint32_t> visibleLights;
+
+	/* Per-instance vertex data for the instanced cube field.
+	Layout must match instancedVertex.glsl : model at location 3~6, normal matrix at 7~9 */
+	struct InstanceData {
+		glm::mat4 model;
+		glm::mat3 normal;
+	};
+	std::vector<InstanceData> instances;
+	std::vector<InstanceData> visibleInstances; // culled subset streamed to instanceVBO each frame
+	BoundsSoA cubeBounds; // bounding sphere per cube, same order as cubePositions
+	std::vector<uint32_t> visibleCubes;
+	CullStats cullStats;
+	BVH sceneBVH; // cube AABBs, for ray picking
+	int aimedCube = -1; // cube under the screen center, -1 = none
+	bool useInstancing = true; // draw the cube field with one glDrawArraysInstanced call
+	bool useDeferred = false; // G-buffer + light volumes instead of clustered forward shading, F2
+	bool useDepthPrepass = false; // forward shading only, F3
+	bool useSpotLight = true; // camera flashlight, F4
+	bool asyncShaderBuild = true; // overlap shader compilation with the rest of the setup
+
+	static bool hasDisplay() {
+#ifdef _WIN32
+		return true;
+#else
+		return getenv("DISPLAY") || getenv("WAYLAND_DISPLAY");
+#endif
+	}
+
 	void initWindow() {
+#ifdef GLFW_PLATFORM_NULL
+		/* GLFW 3.4+ : without a display server use the null platform,
+		the context then comes from EGL (surfaceless) or OSMesa, e.g. Mesa llvmpipe */
+		if (options.headless && !hasDisplay())
+			glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
 		glfwInit();
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 		/* core-profile means we'll get access to a smaller subset of OpenGL features
 		without backwards-compatible features */
 		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-		window = glfwCreateWindow(800, 600, "LearnOpenGL", NULL, NULL);
+		if (options.headless)
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE); // only hosts the context, frames go to offscreenFBO
+
+		window = glfwCreateWindow(options.width, options.height, "LearnOpenGL", NULL, NULL);
+#ifdef GLFW_PLATFORM_NULL
+		if (window == NULL && options.headless) {
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+			window = glfwCreateWindow(options.width, options.height, "LearnOpenGL", NULL, NULL);
+		}
+		if (window == NULL && options.headless) {
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+			window = glfwCreateWindow(options.width, options.height, "LearnOpenGL", NULL, NULL);
+		}
+#endif
 		if (window == NULL)
 		{
 			std::cout << "Failed to create GLFW window" << std::endl;
@@ -99,11 +258,13 @@ private:
 			std::cout << "Failed to initialize GLAD" << std::endl;
 			throw std::runtime_error("Failed to initialize GLAD");
 		}
+		loadGLExtensions((GLADloadproc)glfwGetProcAddress);
 	}
 
 	void setViewport() {
 		/* tell OpenGL the size of the rendering window */
-		glViewport(0, 0, 800, 600);
+		glViewport(0, 0, options.width, options.height);
+		camera.aspect = (float)options.width / options.height;
 
 		/* register a callback function on the window that gets called
 		each time the window is resized */
@@ -115,9 +276,70 @@ private:
 		glfwSetFramebufferSizeCallback(window, resize);
 	}
 
+	void setupOffscreenTarget() {
+		/* headless frames are rendered here, the default framebuffer of a hidden
+		or null-platform window may not exist or not be backed by memory */
+		glGenFramebuffers(1, &offscreenFBO);
+		glGenRenderbuffers(2, offscreenRBO);
+		glState.bindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+
+		glBindRenderbuffer(GL_RENDERBUFFER, offscreenRBO[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options.width, options.height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenRBO[0]);
+
+		glBindRenderbuffer(GL_RENDERBUFFER, offscreenRBO[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, options.width, options.height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, offscreenRBO[1]);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "Failed to create offscreen framebuffer" << std::endl;
+			throw std::runtime_error("Failed to create offscreen framebuffer");
+		}
+	}
+
+	/* Both flashlight variants, so F4 never waits for the driver. Called before the first
+	beginBuildAll() : they compile with the other programs while buffers & textures are set up. */
+	void requestForwardShaders() {
+		for (bool spotLight : { true, false }) {
+			forwardShaders.push_back(&Shader::permutation(forwardVertexPath, forwardFragmentPath, forwardDefines(spotLight)));
+			forwardShaders.push_back(&Shader::permutation(instancedVertexPath, forwardFragmentPath, forwardDefines(spotLight)));
+		}
+	}
+
 	void setupShaderProgram() {
-		shaderProgram.build();
-		lightShader.build();
+		/* run() issued every program already, unless the build is synchronous */
+		if (!asyncShaderBuild)
+			Shader::beginBuildAll();
+		Shader::finishBuildAll();
+
+		const ProgramCache::Stats& cacheStats = ProgramCache::stats();
+		std::cout << "Program cache : " << cacheStats.hits << " hits, " << cacheStats.misses << " misses, "
+			<< cacheStats.invalidations << " invalidations" << std::endl;
+
+		lightShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+		for (Shader* shader : forwardShaders)
+			setupForwardShader(*shader);
+
+		deferred.init(32.0f); // material.shininess
+		setMaterialUniforms(deferred.geometryShader);
+		setMaterialUniforms(deferred.instancedGeometryShader);
+
+		depthPrepass.init();
+		resolveUniforms();
+
+		/* edit a shader or one of its includes while running : it's rebuilt in place */
+		if (!options.headless)
+			Shader::enableHotReload();
+	}
+
+	/* after setup, and whenever a hot reload replaced a program : locations may have moved */
+	void resolveUniforms() {
+		lightModelUniform = lightShader.uniform("model");
+		gbufferModelUniform = deferred.geometryShader.uniform("model");
+		depthModelUniform = depthPrepass.shader.uniform("model");
+		deferred.resolveUniforms();
 	}
 
 	void setupVertexArray() {
@@ -132,14 +354,15 @@ private:
 		/* A Cube in Model Coordinate. 6 vertices for one rectangle. */
 		// pos, normal vector, texture coord
 		int TIMES_OF_STRIDE = 8;
+		/* every face counter-clockwise seen from outside : the light volumes are face culled */
 		float vertices[] = {
 			// positions          // normals           // texture coords
 			-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-			 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
 			 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+			 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
 			 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-			-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
 			-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+			-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
 
 			-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
 			 0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 0.0f,
@@ -156,11 +379,11 @@ private:
 			-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
 
 			 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-			 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
 			 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+			 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
 			 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-			 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
 			 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+			 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
 
 			-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
 			 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
@@ -170,11 +393,11 @@ private:
 			-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
 
 			-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
-			 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
 			 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+			 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
 			 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-			-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
-			-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
+			-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+			-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f
 		};
 
 		unsigned int indices[] = {  // note that we start from 0!
@@ -189,10 +412,10 @@ private:
 		glGenVertexArrays(1, &VAO);
 
 		/* Bind VBO to the VAO ============================================== */
-		glBindVertexArray(VAO);
+		glState.bindVertexArray(VAO);
 
 		/* Bind and Init VBO --> VAO ====================================================== */
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
 		/* Bind and Init EBO --> VAO */
@@ -221,56 +444,115 @@ private:
 		glEnableVertexAttribArray(2);
 		/* ============================================================================ */
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+		glState.bindBuffer(GL_ARRAY_BUFFER, 0);
+		glState.bindVertexArray(0);
 
 		/* Light VAO setting */
 		glGenVertexArrays(1, &lightVAO);
-		glBindVertexArray(lightVAO);
+		glState.bindVertexArray(lightVAO);
 
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
 
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 
 			TIMES_OF_STRIDE * sizeof(float), (void*)0);
 		glEnableVertexAttribArray(0);
 
-		glBindVertexArray(0);
+		glState.bindVertexArray(0);
 	}
 
-	void registerTexture(unsigned int* id, const char* path, int format) {
-		int width, height, nrChannels;
-		unsigned char* texData;
-
-		stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis
+	glm::mat4 cubeModel(unsigned int i) {
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), cubePositions[i]);
+		return glm::rotate(model, glm::radians(20.0f * i), glm::vec3(1.0f, 0.3f, 0.5f));
+	}
 
-		glGenTextures(1, id);
-		glBindTexture(GL_TEXTURE_2D, *id);
+	void setupInstanceBuffer() {
+		/* Model & normal matrices of the whole cube field, uploaded once */
+		instances.resize(cubePositions.size());
+		for (unsigned int i = 0; i < cubePositions.size(); ++i) {
+			instances[i].model = cubeModel(i);
+			instances[i].normal = glm::mat3(glm::transpose(glm::inverse(instances[i].model)));
+		}
 
-		texData = stbi_load(path, &width, &height, &nrChannels, 0);
-		if (texData) {
-			glTexImage2D(GL_TEXTURE_2D,
-				/* level = */ 0, // set each mipmap level manually, but we'll leave it at the base level
-				/* internalformat = */GL_RGB, // format we want to store the texture.
-				width, height,
-				/* border = */0, // should always be 0 (some legacy stuff)
-				/* format = */format, GL_UNSIGNED_BYTE, // format and datatype of the source image
-				texData);
-			glGenerateMipmap(GL_TEXTURE_2D);
+		/* unit cube rotated in place : the sphere through its corners bounds every orientation */
+		cubeBounds.resize(cubePositions.size());
+		for (unsigned int i = 0; i < cubePositions.size(); ++i)
+			cubeBounds.set(i, cubePositions[i], 0.8660254f); // sqrt(3) / 2
+
+		/* tight world AABB of each rotated unit cube : half extent = |rotation| * 0.5 */
+		std::vector<AABB> cubeBoxes(cubePositions.size());
+		for (unsigned int i = 0; i < cubePositions.size(); ++i) {
+			const glm::mat4& m = instances[i].model;
+			glm::vec3 half(
+				0.5f * (fabsf(m[0].x) + fabsf(m[1].x) + fabsf(m[2].x)),
+				0.5f * (fabsf(m[0].y) + fabsf(m[1].y) + fabsf(m[2].y)),
+				0.5f * (fabsf(m[0].z) + fabsf(m[1].z) + fabsf(m[2].z)));
+			cubeBoxes[i].min = cubePositions[i] - half;
+			cubeBoxes[i].max = cubePositions[i] + half;
 		}
-		else {
-			std::cout << "Failed to load texture : " << path << std::endl;
+		sceneBVH.build(cubeBoxes);
+		visibleInstances.reserve(instances.size());
+
+		/* full size once, only the visible instances are rewritten every frame */
+		glGenBuffers(1, &instanceVBO);
+		glState.bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_DYNAMIC_DRAW);
+
+		/* Instance attributes live in the cube VAO next to the per-vertex ones.
+		A mat4 takes 4 consecutive locations (one per column), a mat3 takes 3. */
+		glState.bindVertexArray(VAO);
+		for (unsigned int col = 0; col < 4; ++col) {
+			glVertexAttribPointer(3 + col, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+				(void*)(offsetof(InstanceData, model) + col * sizeof(glm::vec4)));
+			glEnableVertexAttribArray(3 + col);
+			glVertexAttribDivisor(3 + col, 1); // advance once per instance, not per vertex
+		}
+		for (unsigned int col = 0; col < 3; ++col) {
+			glVertexAttribPointer(7 + col, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+				(void*)(offsetof(InstanceData, normal) + col * sizeof(glm::vec3)));
+			glEnableVertexAttribArray(7 + col);
+			glVertexAttribDivisor(7 + col, 1);
 		}
-		stbi_image_free(texData);
+		glState.bindVertexArray(0);
+		glState.bindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	/* auto takes BC7 where the context has it, else BC1 (BC3 for images with alpha) */
+	BlockFormat chooseTextureFormat() {
+		const std::string& mode = options.textureCompression;
+		if (mode == "none")
+			return BlockFormat::None;
+		if ((mode == "auto" || mode == "bc7") && GLExt.textureCompressionBPTC)
+			return BlockFormat::BC7;
+		if (mode == "bc7")
+			std::cout << "ERROR::TEXTURE::BPTC_UNSUPPORTED, using BC1 / BC3" << std::endl;
+		if (!GLExt.textureCompressionS3TC) {
+			if (mode != "auto")
+				std::cout << "ERROR::TEXTURE::S3TC_UNSUPPORTED, textures stay uncompressed" << std::endl;
+			return BlockFormat::None;
+		}
+		return mode == "bc3" ? BlockFormat::BC3 : BlockFormat::BC1;
 	}
 
 	void setupTextures() {
-		registerTexture(&TexBox, "./images/container2.png", GL_RGBA);
-		registerTexture(&TexBoxSpecular, "./images/container2_specular.png", GL_RGBA);
+		TextureCache::enabled = options.textureCache;
+		textureFormat = chooseTextureFormat();
+		textureLoader.setCompression(textureFormat, (CompressionQuality)options.compressionQuality);
+
+		/* without workers load() returns once the image is resident, the encoder then
+		uses every core. Otherwise the placeholders are drawn until updateTextures()
+		has uploaded the images. */
+		unsigned int cores = std::thread::hardware_concurrency();
+		textureLoader.init(options.syncTextures ? 0 : (cores > 1 ? cores - 1 : 1));
+		TexBox = textureLoader.load(diffuseMapPath);
+		TexBoxSpecular = textureLoader.load(specularMapPath);
+		if (options.syncTextures) {
+			texturesResidentMs = (glfwGetTime() - startupBegin) * 1000.0;
+			checkSpecularMap();
+			reportTextures();
+		}
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, TexBox);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, TexBoxSpecular);
+		glState.bindTexture(0, GL_TEXTURE_2D, TexBox);
+		glState.bindTexture(1, GL_TEXTURE_2D, TexBoxSpecular);
 	}
 
 	void setupUserInput() {
@@ -280,167 +562,599 @@ private:
 		glfwSetScrollCallback(window, scroll_callback);
 	}
 
-	void setLightsUniform(glm::vec3 lights[]) {
+	void setupUniformBuffer() {
+		/* One UBO holds camera & light data for every program, see FrameData.h */
+		glGenBuffers(1, &frameUBO);
+		glState.bindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+		glState.bindBuffer(GL_UNIFORM_BUFFER, 0);
+		glState.bindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frameUBO);
+	}
+
+	void setMaterialUniforms(Shader& shader) {
+		/* Program uniforms persist, so the constant material is set only once */
+		shader.use();
+		shader.setVec3("material.ambient", glm::vec3(1.0f, 0.5f, 0.31f));
+		shader.setInt("material.diffuse", 0);
+		shader.setInt("material.specular", 1);
+		shader.setFloat("material.shininess", 32.0f);
+	}
+
+	void setClusterSamplers(Shader& shader) {
+		shader.use();
+		shader.setInt("lightData", LightClusters::LIGHT_DATA_UNIT);
+		shader.setInt("lightClusters", LightClusters::CLUSTER_UNIT);
+		shader.setInt("lightIndices", LightClusters::INDEX_UNIT);
+	}
+
+	/* Switches at the top of fragmentShader.glsl : what the scene does not use is compiled out */
+	ShaderDefines forwardDefines(bool spotLight) const {
+		ShaderDefines defines;
+		defines.set("POINT_LIGHTS", lightClusters.lights().empty() ? 0 : 1);
+		defines.set("SPOT_LIGHT", spotLight ? 1 : 0);
+		defines.set("SPECULAR_MAP", hasSpecularMap ? 1 : 0);
+		return defines;
+	}
+
+	void setupForwardShader(Shader& shader) {
+		shader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+		setMaterialUniforms(shader);
+		setClusterSamplers(shader);
+	}
+
+	/* Forward program for the current features, a permutation not seen before is built here once */
+	Shader& forwardShader(bool instanced) {
+		Shader& shader = Shader::permutation(instanced ? instancedVertexPath : forwardVertexPath,
+			forwardFragmentPath, forwardDefines(useSpotLight));
+		if (shader.buildState() == Shader::BuildState::None) {
+			shader.build();
+			setupForwardShader(shader);
+		}
+		return shader;
+	}
+
+	/* The scene's point lights, then options.pointLights - 4 small random ones around
+	the cube field (fixed seed). They are static : uploaded once, re-binned every frame. */
+	void setupLights() {
+		pointLightPositions.resize(std::min<size_t>(pointLightPositions.size(), options.pointLights));
+		std::vector<ClusterLight> lights;
+		for (const glm::vec3& position : pointLightPositions) {
+			ClusterLight light;
+			light.position = position;
+			light.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+			light.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+			light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+			light.constant = 1.0f;
+			light.linear = 0.09f;
+			light.quadratic = 0.032f;
+			lights.push_back(light);
+		}
+
+		std::mt19937 rng(42);
+		std::uniform_real_distribution<float> x(-10.0f, 10.0f), y(-6.0f, 8.0f), z(-20.0f, 5.0f);
+		std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+		while (lights.size() < options.pointLights) {
+			ClusterLight light;
+			light.position = glm::vec3(x(rng), y(rng), z(rng));
+			glm::vec3 color(channel(rng), channel(rng), channel(rng));
+			light.ambient = glm::vec3(0.0f); // a thousand ambient terms would wash the scene out
+			light.diffuse = color * 0.25f;
+			light.specular = color * 0.25f;
+			light.constant = 1.0f;
+			light.linear = 0.7f;
+			light.quadratic = 20.0f; // about 2.5 units of reach
+			lights.push_back(light);
+			pointLightPositions.push_back(light.position);
+		}
+
+		unsigned int cores = std::thread::hardware_concurrency();
+		lightClusters.init(cores > 1 ? cores - 1 : 0);
+		lightClusters.setLights(lights);
+		lightClusters.bindTextures(); // units 2~4 are not touched by the render queue
+
+		lightBounds.resize(pointLightPositions.size());
+		for (unsigned int i = 0; i < pointLightPositions.size(); ++i)
+			lightBounds.set(i, pointLightPositions[i], 0.1732051f); // cube scaled by 0.2
+	}
+
+	void updateLights() {
 		// directional light
-		shaderProgram.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-		shaderProgram.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-		shaderProgram.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-		shaderProgram.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-		// point light 1
-		shaderProgram.setVec3("pointLights[0].position", lights[0]);
-		shaderProgram.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-		shaderProgram.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-		shaderProgram.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-		shaderProgram.setFloat("pointLights[0].constant", 1.0f);
-		shaderProgram.setFloat("pointLights[0].linear", 0.09f);
-		shaderProgram.setFloat("pointLights[0].quadratic", 0.032f);
-		// point light 2
-		shaderProgram.setVec3("pointLights[1].position", lights[1]);
-		shaderProgram.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-		shaderProgram.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-		shaderProgram.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-		shaderProgram.setFloat("pointLights[1].constant", 1.0f);
-		shaderProgram.setFloat("pointLights[1].linear", 0.09f);
-		shaderProgram.setFloat("pointLights[1].quadratic", 0.032f);
-		// point light 3
-		shaderProgram.setVec3("pointLights[2].position", lights[2]);
-		shaderProgram.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-		shaderProgram.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-		shaderProgram.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-		shaderProgram.setFloat("pointLights[2].constant", 1.0f);
-		shaderProgram.setFloat("pointLights[2].linear", 0.09f);
-		shaderProgram.setFloat("pointLights[2].quadratic", 0.032f);
-		// point light 4
-		shaderProgram.setVec3("pointLights[3].position", lights[3]);
-		shaderProgram.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-		shaderProgram.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-		shaderProgram.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-		shaderProgram.setFloat("pointLights[3].constant", 1.0f);
-		shaderProgram.setFloat("pointLights[3].linear", 0.09f);
-		shaderProgram.setFloat("pointLights[3].quadratic", 0.032f);
-		// spotLight
-		shaderProgram.setVec3("spotLight.position", camera.getPos());
-		shaderProgram.setVec3("spotLight.direction", camera.Front);
-		shaderProgram.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-		shaderProgram.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-		shaderProgram.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-		shaderProgram.setFloat("spotLight.constant", 1.0f);
-		shaderProgram.setFloat("spotLight.linear", 0.09f);
-		shaderProgram.setFloat("spotLight.quadratic", 0.032f);
-		shaderProgram.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-		shaderProgram.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-	}
-
-	void setUniforms(glm::vec3 pos[], glm::vec3 lights[], unsigned int i) {
-		glm::mat4 model, view, projection;
-
-		shaderProgram.use();
-		
-		model = glm::translate(glm::mat4(1.0f), pos[i]);
-		model = glm::rotate(model, glm::radians(20.0f * i), glm::vec3(1.0f, 0.3f, 0.5f));
-		//model = glm::rotate(model, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.5f, 1.0f, 0.0f));
+		frameData.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+		frameData.dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+		frameData.dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+		frameData.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+		// point lights : binned into lightClusters by binLights()
+		// spotLight : the forward shader compiles it out when off, the deferred one gets a black light
+		const float spotIntensity = useSpotLight ? 1.0f : 0.0f;
+		frameData.spotLight.position = camera.getPos();
+		frameData.spotLight.direction = camera.Front;
+		frameData.spotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+		frameData.spotLight.diffuse = glm::vec3(spotIntensity);
+		frameData.spotLight.specular = glm::vec3(spotIntensity);
+		frameData.spotLight.constant = 1.0f;
+		frameData.spotLight.linear = 0.09f;
+		frameData.spotLight.quadratic = 0.032f;
+		frameData.spotLight.cutOff = glm::cos(glm::radians(12.5f));
+		frameData.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+	}
 
+	void updateTextures() {
+		if (texturesResidentMs >= 0.0)
+			return;
+		if (textureLoader.update(TextureLoader::DEFAULT_BUDGET_MS)) {
+			texturesResidentMs = (glfwGetTime() - startupBegin) * 1000.0;
+			checkSpecularMap();
+			reportTextures();
+		}
+	}
+
+	/* The specular map exists but didn't load or decode : it stays a grey placeholder, so the
+	term is compiled out after all. forwardShader() builds that permutation on its next call. */
+	void checkSpecularMap() {
+		if (hasSpecularMap && textureLoader.failed(TexBoxSpecular))
+			hasSpecularMap = false;
+	}
+
+	void reportTextures() {
+		const TextureLoader::Stats& textures = textureLoader.stats();
+		std::cout << "Textures : " << textures.resident << " resident " << texturesResidentMs
+			<< " ms after startup began, decode " << textures.decodeMs << " ms, compress " << textures.compressMs
+			<< " ms, upload " << textures.uploadMs << " ms" << std::endl;
+		if (TextureCache::enabled) {
+			const TextureCache::Stats& cache = TextureCache::stats();
+			std::cout << "Texture cache : " << cache.hits << " hits, " << cache.misses << " misses, "
+				<< cache.invalidations << " invalidations" << std::endl;
+		}
+	}
+
+	/* View-space clusters follow the camera, so the lists are rebuilt every frame.
+	The deferred light volumes only read the light buffer. */
+	void binLights() {
+		if (useDeferred) {
+			lightClusters.uploadLights();
+			return;
+		}
+		lightClusters.build(camera.getView(), camera.getProjection(), camera.zNear, camera.zFar);
+		lightClusters.upload();
+	}
+
+	/* the offscreen target has the requested size, a window may have been resized */
+	void framebufferSize(int& width, int& height) {
+		width = options.width;
+		height = options.height;
+		if (!options.headless)
+			glfwGetFramebufferSize(window, &width, &height);
+		width = std::max(width, 1);
+		height = std::max(height, 1);
+	}
+
+	/* Camera & lights shared by every draw : written to the UBO once per frame */
+	void updateFrameData() {
 		// note that we're translating the scene in the reverse direction of where we want to move
 		/*const float radius = 10.0f;
 		float camX = sin(glfwGetTime()) * radius;
 		float camZ = cos(glfwGetTime()) * radius;*/
 		//view = glm::lookAt(glm::vec3(camX, 0.0, camZ), glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
-		glm::vec3 Pos = camera.getPos();
-		view = glm::lookAt(Pos, Pos + camera.getFront(), camera.getUp());
+		frameData.view = camera.getView();
 
-		projection = glm::perspective(glm::radians(camera.getFOV()), 800.0f / 600.0f, 0.1f, 100.0f);
+		frameData.projection = camera.getProjection();
 
-		shaderProgram.setMat4("model", model);
-		shaderProgram.setMat4("view", view);
-		shaderProgram.setMat4("projection", projection);
+		frameData.viewPos = camera.getPos();
 
-		shaderProgram.setVec3("viewPos", camera.getPos());
+		updateLights();
 
-		shaderProgram.setVec3("material.ambient", glm::vec3(1.0f, 0.5f, 0.31f));
-		shaderProgram.setInt("material.diffuse", 0);
-		shaderProgram.setInt("material.specular", 1);
-		shaderProgram.setFloat("material.shininess", 32.0f);
+		int width, height;
+		framebufferSize(width, height);
+		frameData.clusterScale = lightClusters.shaderScale((float)width, (float)height);
+		frameData.clusterGrid[0] = LightClusters::GRID_X;
+		frameData.clusterGrid[1] = LightClusters::GRID_Y;
+		frameData.clusterGrid[2] = LightClusters::GRID_Z;
+		frameData.clusterGrid[3] = (unsigned int)lightClusters.lights().size();
 
-		setLightsUniform(lights);
+		glState.bindBuffer(GL_UNIFORM_BUFFER, frameUBO); // elided after the first frame
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &frameData);
 	}
 
-	void setUniformsLightSource(glm::vec3 light) {
-		glm::mat4 model, view, projection;
-
-		lightShader.use();
+	/* Draws of the frame; the queue orders them by state and depth */
+	void cullCubes(const Frustum& frustum) {
+		cullStats = cullSpheres(frustum, cubeBounds, visibleCubes);
+		if (!useInstancing || visibleCubes.empty())
+			return;
+
+		/* compact the visible instances to the front of instanceVBO */
+		visibleInstances.clear();
+		for (uint32_t i : visibleCubes)
+			visibleInstances.push_back(instances[i]);
+		glState.bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, visibleInstances.size() * sizeof(InstanceData), visibleInstances.data());
+	}
 
-		/* MVP for Light Source */
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, light);
-		model = glm::scale(model, glm::vec3(0.2f));
+	void pickCube() {
+		RayHit hit;
+		aimedCube = sceneBVH.raycast(camera.getPos(), camera.getFront(), camera.zFar, hit) ? (int)hit.index : -1;
+	}
 
+	void buildRenderQueue() {
+		const float farPlane = camera.zFar;
 		glm::vec3 Pos = camera.getPos();
-		view = glm::lookAt(Pos, Pos + camera.getFront(), camera.getUp());
 
-		projection = glm::perspective(glm::radians(camera.getFOV()), 800.0f / 600.0f, 0.1f, 100.0f);
+		renderQueue.clear();
+
+		/* the deferred path draws the same items into the G-buffer */
+		Shader& cubeShader = useDeferred ? deferred.geometryShader : forwardShader(false);
+		Shader& cubeInstancedShader = useDeferred ? deferred.instancedGeometryShader : forwardShader(true);
+		const Uniform cubeModelUniform = useDeferred ? gbufferModelUniform : cubeShader.uniform("model");
+		/* the depth pre-pass draws them once more in front, without textures */
+		const bool prepass = useDepthPrepass && !useDeferred;
+
+		/* Shader Program & VAO setting Completed, Now, let's DRAW!! */
+		if (useInstancing) {
+			/* visible part of the cube field in one draw call, model matrices come from instanceVBO */
+			if (!visibleCubes.empty()) {
+				DrawItem& item = renderQueue.push(RenderQueue::makeKey(RenderQueue::PASS_OPAQUE,
+					cubeInstancedShader._id, VAO, MATERIAL_CONTAINER, 0.0f, farPlane));
+				item.shader = &cubeInstancedShader;
+				item.vao = VAO;
+				item.textures[0] = TexBox;
+				item.textures[1] = TexBoxSpecular;
+				item.vertexCount = 36;
+				item.instanceCount = (unsigned int)visibleCubes.size();
+
+				if (prepass) {
+					DrawItem& depth = renderQueue.push(RenderQueue::makeKey(RenderQueue::PASS_DEPTH,
+						depthPrepass.instancedShader._id, VAO, 0, 0.0f, farPlane));
+					depth.shader = &depthPrepass.instancedShader;
+					depth.vao = VAO;
+					depth.vertexCount = 36;
+					depth.instanceCount = (unsigned int)visibleCubes.size();
+				}
+			}
+		}
+		else {
+			for (uint32_t i : visibleCubes) {
+				const float depth = glm::distance(Pos, cubePositions[i]);
+				DrawItem& item = renderQueue.push(RenderQueue::makeKey(RenderQueue::PASS_OPAQUE,
+					cubeShader._id, VAO, MATERIAL_CONTAINER, depth, farPlane));
+				item.shader = &cubeShader;
+				item.vao = VAO;
+				item.textures[0] = TexBox;
+				item.textures[1] = TexBoxSpecular;
+				item.vertexCount = 36;
+				item.modelUniform = cubeModelUniform;
+				item.model = instances[i].model;
+
+				if (prepass) {
+					DrawItem& depthItem = renderQueue.push(RenderQueue::makeKey(RenderQueue::PASS_DEPTH,
+						depthPrepass.shader._id, VAO, 0, depth, farPlane));
+					depthItem.shader = &depthPrepass.shader;
+					depthItem.vao = VAO;
+					depthItem.vertexCount = 36;
+					depthItem.modelUniform = depthModelUniform;
+					depthItem.model = instances[i].model;
+				}
+			}
+		}
 
-		lightShader.setMat4("model", model);
-		lightShader.setMat4("view", view);
-		lightShader.setMat4("projection", projection);
+		for (uint32_t i : visibleLights) {
+			DrawItem& item = renderQueue.push(RenderQueue::makeKey(RenderQueue::PASS_UNLIT,
+				lightShader._id, lightVAO, 0, glm::distance(Pos, pointLightPositions[i]), farPlane));
+			item.shader = &lightShader;
+			item.vao = lightVAO;
+			item.vertexCount = 36;
+			/* Model for Light Source, view & projection come from the UBO */
+			item.modelUniform = lightModelUniform;
+			item.model = glm::translate(glm::mat4(1.0f), pointLightPositions[i]);
+			item.model = glm::scale(item.model, glm::vec3(0.2f));
+		}
+	}
+
+	/* Frame time and per-frame statistics, refreshed once a second */
+	void updateWindowTitle(float deltaTime) {
+		static float elapsed = 0.0f;
+		static unsigned int frames = 0;
+
+		elapsed += deltaTime;
+		frames++;
+		if (elapsed < 1.0f)
+			return;
+
+		const GLState::Counters& calls = glState.frameCounters();
+		const RenderQueue::Stats& queue = renderQueue.stats();
+		const GPUProfiler::ScopeStats* gpuFrame = gpuProfiler.find("Frame");
+		char gpu[32] = "GPU n/a";
+		if (gpuFrame)
+			snprintf(gpu, sizeof(gpu), "GPU %.2f ms", gpuFrame->avgMs);
+		const LightClusters::Stats& lights = lightClusters.stats();
+		char title[448];
+		char shading[96];
+		if (useDeferred)
+			snprintf(shading, sizeof(shading), "deferred");
+		else if (useDepthPrepass && depthPrepass.available())
+			snprintf(shading, sizeof(shading), "forward, %u per cluster max | pre-pass saved %.0f%% of fragments",
+				lights.maxPerCluster, depthPrepass.lastFrame().savedFraction() * 100.0);
+		else
+			snprintf(shading, sizeof(shading), "forward, %u per cluster max", lights.maxPerCluster);
+		snprintf(title, sizeof(title), "LearnOpenGL | %.2f ms | %s | GL binds %u issued, %u elided | %u draws, %u programs, sort %.3f ms | cubes %u visible, %u culled | aim %d | lights %u %s",
+			elapsed * 1000.0f / frames, gpu, calls.issued, calls.elided, queue.items, queue.programChanges, queue.sortMs,
+			cullStats.visible, cullStats.culled, aimedCube, lights.lights, shading);
+		glfwSetWindowTitle(window, title);
+
+		elapsed = 0.0f;
+		frames = 0;
 	}
 
 	void renderLoop() {
-		glm::vec3 cubePositions[] = {
-			glm::vec3(0.0f,  0.0f,  0.0f),
-			glm::vec3(2.0f,  5.0f, -15.0f),
-			glm::vec3(-1.5f, -2.2f, -2.5f),
-			glm::vec3(-3.8f, -2.0f, -12.3f),
-			glm::vec3(2.4f, -0.4f, -3.5f),
-			glm::vec3(-1.7f,  3.0f, -7.5f),
-			glm::vec3(1.3f, -2.0f, -2.5f),
-			glm::vec3(1.5f,  2.0f, -2.5f),
-			glm::vec3(1.5f,  0.2f, -1.5f),
-			glm::vec3(-1.3f,  1.0f, -1.5f)
-		};
-		glm::vec3 pointLightPositions[] = {
-			glm::vec3(0.7f,  0.2f,  2.0f),
-			glm::vec3(2.3f, -3.3f, -4.0f),
-			glm::vec3(-4.0f,  2.0f, -12.0f),
-			glm::vec3(0.0f,  0.0f, -3.0f)
-		};
 		/* Find Location of Uniform Variable */
 		// int colorLocation = glGetUniformLocation(shaderProgram, "ourColor");
 
-		glEnable(GL_DEPTH_TEST); // Enable Depth Testing via Z-Buffer.
+		glState.enable(GL_DEPTH_TEST); // Enable Depth Testing via Z-Buffer.
 
 		/* Render Loop */
 		float deltaTime = 0.0f;
 		float lastFrame = glfwGetTime();
 		float currentFrame;
+		const float recordBegin = lastFrame;
+		const bool recording = !options.recordPath.empty();
+		unsigned int replayFrame = 0;
 		while (!glfwWindowShouldClose(window)) {
-			currentFrame = glfwGetTime();
-			deltaTime = currentFrame - lastFrame;
-			lastFrame = currentFrame;
-			camera.keyboardInput(window, deltaTime);
+			{
+				PROFILE_ZONE("Frame");
+				currentFrame = glfwGetTime();
+				deltaTime = currentFrame - lastFrame;
+				lastFrame = currentFrame;
+				{
+					PROFILE_ZONE("Input");
+					if (replaying) {
+						/* simulated time, not the clock : every replay shows the same frames */
+						float replayTime = replayFrame++ * options.replayDelta;
+						if (replayTime > cameraPath.duration() || glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+							glfwSetWindowShouldClose(window, true);
+						cameraPath.apply(replayTime, camera);
+					}
+					else {
+						camera.keyboardInput(window, deltaTime);
+						if (recording)
+							cameraPath.record(currentFrame - recordBegin, camera);
+					}
+					toggleShadingOnKey();
+					togglePrepassOnKey();
+					toggleSpotLightOnKey();
+				}
+				{
+					PROFILE_ZONE("ShaderReload");
+					if (Shader::pollHotReload())
+						resolveUniforms();
+				}
+				glState.beginFrame();
+				gpuProfiler.beginFrame();
+				{
+					GPU_SCOPE("Frame");
+					renderFrame();
+				}
+				gpuProfiler.endFrame();
+
+				updateWindowTitle(deltaTime);
+
+				{
+					PROFILE_ZONE("Swap");
+					glfwSwapBuffers(window);
+				}
+				{
+					PROFILE_ZONE("Poll");
+					glfwPollEvents();
+				}
+			}
+			PROFILE_END_FRAME();
+			dumpProfileOnKey();
+		}
 
-			/* the entire color buffer will be filled with the color
-			as configured by glClearColor. */
+		if (recording && cameraPath.save(options.recordPath))
+			std::cout << "Camera path : " << cameraPath.size() << " samples, " << cameraPath.duration()
+				<< " s recorded to " << options.recordPath << std::endl;
+	}
+
+	/* F2 : switch between clustered forward and deferred shading on the same scene */
+	void toggleShadingOnKey() {
+		static bool wasDown = false;
+		bool down = glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS;
+		if (down && !wasDown) {
+			useDeferred = !useDeferred;
+			std::cout << "Shading : " << (useDeferred ? "deferred" : "clustered forward") << std::endl;
+		}
+		wasDown = down;
+	}
+
+	/* F3 : depth pre-pass on or off, the title shows how many fragments it saves */
+	void togglePrepassOnKey() {
+		static bool wasDown = false;
+		bool down = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+		if (down && !wasDown) {
+			useDepthPrepass = !useDepthPrepass;
+			std::cout << "Depth pre-pass : " << (useDepthPrepass ? "on" : "off") << std::endl;
+		}
+		wasDown = down;
+	}
+
+	/* F4 : camera flashlight, the forward path switches to the permutation without it */
+	void toggleSpotLightOnKey() {
+		static bool wasDown = false;
+		bool down = glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS;
+		if (down && !wasDown) {
+			useSpotLight = !useSpotLight;
+			std::cout << "Flashlight : " << (useSpotLight ? "on" : "off") << std::endl;
+		}
+		wasDown = down;
+	}
+
+	/* F9 : Chrome trace of the buffered frames plus the rolling per-zone averages */
+	void dumpProfileOnKey() {
+		static bool wasDown = false;
+		bool down = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+		if (down && !wasDown) {
+			std::string path = options.tracePath.empty() ? "profile_trace.json" : options.tracePath;
+			if (Profiler::writeTrace(path))
+				std::cout << "Profile trace written to " << path << std::endl;
+			for (const Profiler::ZoneStats& zone : Profiler::zoneStats())
+				printf("  %-12s avg %8.3f ms  max %8.3f ms  %6.1f calls/frame\n",
+					zone.name, zone.avgMs, zone.maxMs, zone.callsPerFrame);
+			for (const GPUProfiler::ScopeStats& scope : gpuProfiler.scopeStats())
+				printf("  GPU %-8s avg %8.3f ms  max %8.3f ms\n", scope.name, scope.avgMs, scope.maxMs);
+		}
+		wasDown = down;
+	}
+
+	void renderFrame() {
+		/* the entire color buffer will be filled with the color
+		as configured by glClearColor. */
+		{
+			PROFILE_ZONE("Clear");
 			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
+		{
+			PROFILE_ZONE("Textures");
+			updateTextures();
+		}
+		{
+			PROFILE_ZONE("Lights");
+			binLights();
+		}
+		{
+			PROFILE_ZONE("FrameData");
+			updateFrameData();
+		}
+		{
+			PROFILE_ZONE("Cull");
+			Frustum frustum = Frustum::fromCamera(camera);
+			cullCubes(frustum);
+			cullSpheres(frustum, lightBounds, visibleLights);
+			pickCube();
+		}
+		{
+			PROFILE_ZONE("BuildQueue");
+			buildRenderQueue();
+			renderQueue.sort();
+		}
+		{
+			PROFILE_ZONE("Submit");
+			if (useDeferred) {
+				int width, height;
+				framebufferSize(width, height);
+				deferred.resize(width, height);
+				deferred.beginGeometryPass();
+				renderQueue.submit(RenderQueue::PASS_OPAQUE, RenderQueue::PASS_OPAQUE);
+				deferred.lightPass(options.headless ? offscreenFBO : 0, lightVAO,
+					(unsigned int)lightClusters.lights().size(), frameData.projection * frameData.view);
+				renderQueue.submit(RenderQueue::PASS_UNLIT, RenderQueue::PASS_UNLIT);
+			}
+			else if (useDepthPrepass) {
+				depthPrepass.beginDepthPass();
+				renderQueue.submit(RenderQueue::PASS_DEPTH, RenderQueue::PASS_DEPTH);
+				depthPrepass.beginShadingPass();
+				renderQueue.submit(RenderQueue::PASS_OPAQUE, RenderQueue::PASS_OPAQUE);
+				depthPrepass.end();
+				renderQueue.submit(RenderQueue::PASS_UNLIT, RenderQueue::PASS_UNLIT);
+			}
+			else
+				renderQueue.submit();
+		}
+		// glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	}
 
-			glBindVertexArray(VAO);
-			/* Shader Program & VAO setting Completed, Now, let's DRAW!! */
-			for (unsigned int i = 0; i < 10; ++i) {
-				setUniforms(cubePositions, pointLightPositions, i);
-				glDrawArrays(GL_TRIANGLES, 0, 36); // Triangle	
+	/* Fixed number of frames into offscreenFBO without input, then the frame time statistics
+	go to options.statsPath. Returns the process exit code. */
+	int renderHeadless() {
+		glState.enable(GL_DEPTH_TEST);
+
+		/* a replay covers the whole path by default */
+		unsigned int frames = options.frames;
+		if (frames == 0)
+			frames = replaying ? (unsigned int)(cameraPath.duration() / options.replayDelta) + 1 : 600;
+
+		FrameStats stats;
+		stats.reserve("frame_ms", frames);
+		const unsigned int totalFrames = options.warmupFrames + frames;
+		uint64_t cameraHash = HASH_SEED;
+		double frameBegin = glfwGetTime();
+		for (unsigned int frame = 0; frame < totalFrames; ++frame) {
+			if (replaying) {
+				/* warmup frames hold the first pose, the measured ones walk the path */
+				unsigned int replayFrame = frame < options.warmupFrames ? 0 : frame - options.warmupFrames;
+				cameraPath.apply(replayFrame * options.replayDelta, camera);
 			}
+			if (frame >= options.warmupFrames)
+				cameraHash = CameraPath::hashPose(cameraHash, camera);
+			{
+				PROFILE_ZONE("Frame");
+				glState.beginFrame();
+				/* results arrive FRAME_LATENCY frames late, the first measured ones may be warmup frames */
+				if (gpuProfiler.beginFrame() && frame >= options.warmupFrames) {
+					for (const GPUProfiler::ScopeStats& scope : gpuProfiler.scopeStats())
+						stats.add(std::string("gpu_") + scope.name + "_ms", scope.lastMs);
+				}
+				{
+					GPU_SCOPE("Frame");
+					renderFrame();
+				}
+				gpuProfiler.endFrame();
+				glfwPollEvents();
+				/* no swap paces the loop, wait for the GPU so a frame's time covers its work */
+				PROFILE_ZONE("Finish");
+				glFinish();
+			}
+			PROFILE_END_FRAME();
 
-			glBindVertexArray(lightVAO);
-			for (unsigned int i = 0; i < 4; ++i) {
-				setUniformsLightSource(pointLightPositions[i]);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
+			double frameEnd = glfwGetTime();
+			if (frame >= options.warmupFrames) {
+				stats.add("frame_ms", (frameEnd - frameBegin) * 1000.0);
+				for (const Profiler::ZoneStats& zone : Profiler::zoneStats())
+					stats.add(std::string("zone_") + zone.name + "_ms", zone.lastMs);
 			}
-			// glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-			glBindVertexArray(0);
+			frameBegin = frameEnd;
+		}
 
-			glfwSwapBuffers(window);
-			glfwPollEvents();
+		const char* renderer = (const char*)glGetString(GL_RENDERER);
+		const char* version = (const char*)glGetString(GL_VERSION);
+		stats.setInfo("renderer", renderer ? renderer : "unknown");
+		stats.setInfo("gl_version", version ? version : "unknown");
+		stats.setInfo("width", options.width);
+		stats.setInfo("height", options.height);
+		stats.setInfo("warmup_frames", options.warmupFrames);
+		stats.setInfo("instancing", useInstancing ? 1 : 0);
+		stats.setInfo("gpu_timers", gpuProfiler.available() ? 1 : 0);
+		stats.setInfo("point_lights", (double)lightClusters.lights().size());
+		stats.setInfo("shading", useDeferred ? "deferred" : "forward");
+		stats.setInfo("depth_prepass", useDepthPrepass && !useDeferred ? 1 : 0);
+		stats.setInfo("spot_light", useSpotLight ? 1 : 0);
+		stats.setInfo("texture_loading", options.syncTextures ? "sync" : "async");
+		stats.setInfo("textures_resident_ms", texturesResidentMs);
+		stats.setInfo("texture_compression", blockFormatName(textureFormat));
+		if (textureFormat != BlockFormat::None)
+			stats.setInfo("texture_psnr_db", textureLoader.stats().minPsnr);
+		if (options.textureCache)
+			stats.setInfo("texture_cache_hits", (double)TextureCache::stats().hits);
+		stats.setInfo("shader_permutations", (double)Shader::permutationCount());
+		if (useDepthPrepass && depthPrepass.available()) {
+			/* totals over the run, warmup included : the pass saves the same share every frame */
+			const DepthPrepass::Stats& prepass = depthPrepass.total();
+			stats.setInfo("prepass_depth_samples", (double)prepass.depthSamples);
+			stats.setInfo("prepass_shaded_samples", (double)prepass.shadedSamples);
+			stats.setInfo("prepass_saved_fraction", prepass.savedFraction());
+		}
+		if (replaying) {
+			/* equal hashes : both runs rendered exactly the same camera poses */
+			char hash[17];
+			snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)cameraHash);
+			stats.setInfo("camera_path", options.replayPath);
+			stats.setInfo("replay_dt", options.replayDelta);
+			stats.setInfo("camera_hash", hash);
 		}
+
+		FrameStats::Summary frameMs = stats.summary("frame_ms");
+		std::cout << "Headless : " << frameMs.samples << " frames, mean " << frameMs.mean << " ms, p50 "
+			<< frameMs.p50 << " ms, p95 " << frameMs.p95 << " ms, p99 " << frameMs.p99 << " ms ("
+			<< (renderer ? renderer : "unknown") << ")" << std::endl;
+		return stats.writeJSON(options.statsPath) ? 0 : 1;
 	}
 };
 
@@ -453,8 +1167,29 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
 	app.scrollInput(xoffset, yoffset);
 }
 
-int main() {
-	app.run();
-
-	return 0;
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, options))
+		return 1;
+
+	if (options.benchBVH)
+		return runBVHBenchmark(options.benchBVH);
+	if (options.benchProfiler)
+		return runProfilerBenchmark(options.benchProfiler);
+	if (options.benchRenderQueue)
+		return runRenderQueueBenchmark(options.benchRenderQueue);
+	if (!options.benchCompression.empty())
+		return runCompressionBenchmark(options.benchCompression);
+	if (!options.benchTextureCache.empty())
+		return runTextureCacheBenchmark(options.benchTextureCache);
+	if (!options.benchImageLoad.empty())
+		return runImageLoadBenchmark(options.benchImageLoad);
+	if (options.stressStbi)
+		return runStbiStressTest(options.stressStbi);
+	if (options.verifyPngFilters)
+		return runPngFilterTest();
+	if (options.verifyInflate)
+		return runInflateTest();
+
+	return app.run(options);
 }
\ No newline at end of file
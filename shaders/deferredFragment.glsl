@@ -0,0 +1,37 @@
+#version 330 core
+#include "lighting.glsl"
+
+// Full-screen pass of the deferred path : directional light & spot light.
+// Point lights are added on top by the light volumes, see DeferredRenderer.h
+out vec4 FragColor;
+
+uniform sampler2D gNormal;
+uniform sampler2D gDiffuse;
+uniform sampler2D gSpecular;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+uniform float shininess;
+
+void main()
+{
+   ivec2 pixel = ivec2(gl_FragCoord.xy);
+   float depth = texelFetch(gDepth, pixel, 0).r;
+   if (depth == 1.0)
+      discard; // nothing was drawn here, keep the clear color
+
+   vec4 ndc = vec4(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)), depth, 1.0) * 2.0 - 1.0;
+   vec4 position = inverseViewProjection * ndc;
+
+   Surface surface;
+   surface.position = position.xyz / position.w;
+   surface.normal = texelFetch(gNormal, pixel, 0).xyz;
+   surface.diffuse = texelFetch(gDiffuse, pixel, 0).rgb;
+   surface.specular = texelFetch(gSpecular, pixel, 0).rgb;
+   surface.shininess = shininess;
+
+   vec3 viewDir = normalize(viewPos - surface.position);
+   vec3 result = calcDirectionalLight(dirLight, surface, viewDir);
+   result += calcSpotLight(spotLight, surface, viewDir);
+
+   FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
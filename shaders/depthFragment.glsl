@@ -0,0 +1,5 @@
+#version 330 core
+// Depth pre-pass : color writes are masked off, only the depth test & write run
+void main()
+{
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+// per-instance attribute (glVertexAttribDivisor = 1)
+layout (location = 3) in mat4 aModel;
+
+// Leading members of the shared FrameData block; std140 keeps their offsets
+// identical to the full declaration in frameData.glsl
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+};
+
+// Depth pre-pass : same expression as instancedVertex.glsl, and invariant in both,
+// so the shading pass can depth test with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+   gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+}
\ No newline at end of file
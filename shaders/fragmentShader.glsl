@@ -1,4 +1,18 @@
 #version 330 core
+// Feature switches, Shader::permutation() defines them right after #version.
+// The file alone builds the full shader.
+#ifndef POINT_LIGHTS
+#define POINT_LIGHTS 1  // clustered point lights
+#endif
+#ifndef SPOT_LIGHT
+#define SPOT_LIGHT 1    // the camera flashlight
+#endif
+#ifndef SPECULAR_MAP
+#define SPECULAR_MAP 1  // without one the material is matte, no specular term at all
+#endif
+
+#include "lighting.glsl"
+
 struct Material {
 	vec3 ambient;
 	sampler2D diffuse;
@@ -7,31 +21,6 @@ struct Material {
 	float shininess;
 };
 
-struct DirLight {
-    vec3 direction;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-
-    // For Spotlight
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
 out vec4 FragColor;
 
 in vec3 FragPos;
@@ -39,82 +28,65 @@ in vec3 Normal;
 in vec2 TexCoord;
 
 uniform Material material;
-uniform vec3 viewPos;
 
-uniform DirLight dirLight;
-#define NR_POINT_LIGHTS 4
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform PointLight spotLight;
+// Clustered point lights, filled by LightClusters every frame
+uniform samplerBuffer lightData;      // 4 texels per light, see unpackLight()
+uniform usamplerBuffer lightClusters; // offset & count into lightIndices per cluster
+uniform usamplerBuffer lightIndices;
 
-vec3 calcDirectionalLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 calcSpotLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 calcClusterLights(Surface surface, vec3 viewDir);
 
 void main()
 {
    //FragColor = mix(texture(TexBox, TexCoord), texture(TexFace, TexCoord), 0.2);
 
+   // the material texels are read once, not once per light
+   Surface surface;
+   surface.position = FragPos;
+   surface.normal = Normal;
+   surface.diffuse = vec3(texture(material.diffuse, TexCoord));
+#if SPECULAR_MAP
+   surface.specular = vec3(texture(material.specular, TexCoord));
+#else
+   surface.specular = vec3(0.0);
+#endif
+   surface.shininess = material.shininess;
+
    vec3 viewDir = normalize(viewPos - FragPos);
    vec3 result = vec3(0.0);
 
-   result += calcDirectionalLight(dirLight, Normal, viewDir);
+   result += calcDirectionalLight(dirLight, surface, viewDir);
    
-   for (int i=0; i < NR_POINT_LIGHTS; i++)
-		result += calcPointLight(pointLights[i], Normal, FragPos, viewDir);
+#if POINT_LIGHTS
+   result += calcClusterLights(surface, viewDir);
+#endif
 
-   result += calcSpotLight(spotLight, Normal, FragPos, viewDir);
+#if SPOT_LIGHT
+   result += calcSpotLight(spotLight, surface, viewDir);
+#endif
 
    FragColor = vec4(result, 1.0);
 }
 
-vec3 calcDirectionalLight(DirLight light, vec3 normal, vec3 viewDir)
-{
-	vec3 lightDir = normalize(-light.direction); // towards light source
-	float diffuse_cos = max( dot(normal, lightDir), 0.0 ); // angle btw light and normal vector
-	
-	vec3 reflectDir = reflect(-lightDir, normal);
-	float spec_cos = max( dot(viewDir, reflectDir), 0.0 ); // angle btw viewDir & reflectDir
-	float phong = pow(spec_cos, material.shininess);
-
-	vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoord));
-	vec3 diffuse = light.diffuse * diffuse_cos * vec3(texture(material.diffuse, TexCoord));
-	vec3 specular = light.specular * phong * vec3(texture(material.specular, TexCoord));
-
-	return (ambient + diffuse + specular);
-}
-
-vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 calcClusterLights(Surface surface, vec3 viewDir)
 {
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diffuse_cos = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float phong = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // attenuation
-    float distance    = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + 
-  			     light.quadratic * (distance * distance));    
-    // combine results
-    vec3 ambient  = light.ambient  * vec3(texture(material.diffuse, TexCoord));
-    vec3 diffuse  = light.diffuse  * diffuse_cos * vec3(texture(material.diffuse, TexCoord));
-    vec3 specular = light.specular * phong * vec3(texture(material.specular, TexCoord));
-    ambient  *= attenuation;
-    diffuse  *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
-}
-
-vec3 calcSpotLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    float theta = dot(lightDir, normalize(-light.direction));
-    /* For Smoothing Edges */
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp( (theta - light.outerCutOff)/epsilon, 0.0, 1.0 );
-    vec3 result;
-
-    result = calcPointLight(light, normal, fragPos, viewDir);
-    return intensity * result;
-   
+    // same cluster as LightClusters::build() computed on the CPU
+    float viewDepth = -(view * vec4(surface.position, 1.0)).z;
+    uvec3 cluster = uvec3(uvec2(gl_FragCoord.xy * clusterScale.xy),
+                          uint(max(log(viewDepth) * clusterScale.z + clusterScale.w, 0.0)));
+    cluster = min(cluster, clusterGrid.xyz - 1u);
+    int clusterIndex = int(cluster.x + clusterGrid.x * (cluster.y + clusterGrid.y * cluster.z));
+    uvec2 range = texelFetch(lightClusters, clusterIndex).rg;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int base = int(texelFetch(lightIndices, int(range.x + i)).r) * 4;
+        vec4 positionRadius = texelFetch(lightData, base);
+        vec3 toLight = positionRadius.xyz - surface.position;
+        if (dot(toLight, toLight) > positionRadius.w * positionRadius.w)
+            continue; // the cluster only bounds the light
+
+        result += calcPointLight(unpackLight(lightData, base, positionRadius), surface, viewDir);
+    }
+    return result;
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+// Light structs & the per-frame uniform block, see FrameData.h for the C++ mirror.
+// Included by both stages of a program, so their declarations always match.
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    // For Spotlight
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// written once per frame with glBufferSubData
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+
+    DirLight dirLight;
+    PointLight spotLight;
+    // point lights are read from the cluster buffers, see LightClusters.h
+    vec4 clusterScale; // tile = gl_FragCoord.xy * xy, slice = log(view depth) * z + w
+    uvec4 clusterGrid; // grid size x, y, z & point light count
+};
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 330 core
+struct Material {
+	vec3 ambient;
+	sampler2D diffuse;
+	sampler2D specular;
+
+	float shininess;
+};
+
+// G-buffer of the deferred path, lit later by deferredFragment.glsl & lightVolumeFragment.glsl
+layout (location = 0) out vec4 gNormal;   // world space
+layout (location = 1) out vec4 gDiffuse;  // material.diffuse
+layout (location = 2) out vec4 gSpecular; // material.specular
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoord;
+
+uniform Material material;
+
+void main()
+{
+   gNormal = vec4(normalize(Normal), 0.0);
+   gDiffuse = vec4(texture(material.diffuse, TexCoord).rgb, 1.0);
+   gSpecular = vec4(texture(material.specular, TexCoord).rgb, 1.0);
+}
\ No newline at end of file
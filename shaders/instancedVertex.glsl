@@ -0,0 +1,28 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+// per-instance attributes (glVertexAttribDivisor = 1)
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in mat3 aNormalMatrix;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+
+// the FrameData declaration of fragmentShader.glsl too, they link into one program
+#include "frameData.glsl"
+
+// bit-identical to the depth pre-pass positions, see depthInstancedVertex.glsl
+invariant gl_Position;
+
+void main()
+{
+   gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+
+   FragPos = vec3(aModel * vec4(aPos, 1.0));
+
+   // normal matrix is precomputed on the CPU, no inverse() per vertex
+   Normal = aNormalMatrix * aNormal;
+   TexCoord = aTexCoord;
+}
\ No newline at end of file
@@ -6,8 +6,12 @@ layout (location = 2) in vec2 aTexCoord;
 out vec2 TexCoord;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Leading members of the shared FrameData block; std140 keeps their offsets
+// identical to the full declaration in frameData.glsl
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+};
 
 void main()
 {
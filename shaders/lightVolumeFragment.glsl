@@ -0,0 +1,43 @@
+#version 330 core
+#include "lighting.glsl"
+
+// Light volume pass of the deferred path : one point light per instance, added onto
+// the full-screen pass with additive blending, see DeferredRenderer.h
+out vec4 FragColor;
+
+flat in int LightTexel;
+
+uniform samplerBuffer lightData; // 4 texels per light, see unpackLight()
+uniform sampler2D gNormal;
+uniform sampler2D gDiffuse;
+uniform sampler2D gSpecular;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+uniform float shininess;
+
+void main()
+{
+   ivec2 pixel = ivec2(gl_FragCoord.xy);
+   float depth = texelFetch(gDepth, pixel, 0).r;
+   if (depth == 1.0)
+      discard; // background, reached through depth clamping of far back faces
+
+   vec4 ndc = vec4(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)), depth, 1.0) * 2.0 - 1.0;
+   vec4 position = inverseViewProjection * ndc;
+
+   Surface surface;
+   surface.position = position.xyz / position.w;
+
+   vec4 positionRadius = texelFetch(lightData, LightTexel);
+   vec3 toLight = positionRadius.xyz - surface.position;
+   if (dot(toLight, toLight) > positionRadius.w * positionRadius.w)
+      discard; // inside the box, outside the sphere
+
+   surface.normal = texelFetch(gNormal, pixel, 0).xyz;
+   surface.diffuse = texelFetch(gDiffuse, pixel, 0).rgb;
+   surface.specular = texelFetch(gSpecular, pixel, 0).rgb;
+   surface.shininess = shininess;
+
+   PointLight light = unpackLight(lightData, LightTexel, positionRadius);
+   FragColor = vec4(calcPointLight(light, surface, normalize(viewPos - surface.position)), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// the FrameData declaration of lightVolumeFragment.glsl too, they link into one program
+#include "frameData.glsl"
+
+// one instance per point light, read from the same buffer as the clustered forward path
+uniform samplerBuffer lightData;
+
+flat out int LightTexel;
+
+void main()
+{
+   LightTexel = gl_InstanceID * 4;
+   vec4 positionRadius = texelFetch(lightData, LightTexel);
+
+   // the unit cube of lightVAO scaled to enclose the sphere of influence
+   gl_Position = projection * view * vec4(positionRadius.xyz + aPos * (2.0 * positionRadius.w), 1.0);
+}
\ No newline at end of file
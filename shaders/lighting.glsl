@@ -0,0 +1,85 @@
+// Phong lighting shared by the forward & deferred paths
+#include "frameData.glsl"
+
+// 0 : matte surfaces, the specular term is compiled out (a Shader::permutation() define)
+#ifndef SPECULAR_MAP
+#define SPECULAR_MAP 1
+#endif
+
+// what the lights need of a surface : read from the material textures by the
+// forward shader, from the G-buffer by the deferred one
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 diffuse;  // diffuse map texel
+    vec3 specular; // specular map texel
+    float shininess;
+};
+
+vec3 calcSpecular(vec3 lightSpecular, vec3 lightDir, Surface surface, vec3 viewDir)
+{
+#if SPECULAR_MAP
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float phong = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess); // angle btw viewDir & reflectDir
+    return lightSpecular * phong * surface.specular;
+#else
+    return vec3(0.0);
+#endif
+}
+
+vec3 calcDirectionalLight(DirLight light, Surface surface, vec3 viewDir)
+{
+	vec3 lightDir = normalize(-light.direction); // towards light source
+	float diffuse_cos = max( dot(surface.normal, lightDir), 0.0 ); // angle btw light and normal vector
+
+	vec3 ambient = light.ambient * surface.diffuse;
+	vec3 diffuse = light.diffuse * diffuse_cos * surface.diffuse;
+	vec3 specular = calcSpecular(light.specular, lightDir, surface, viewDir);
+
+	return (ambient + diffuse + specular);
+}
+
+vec3 calcPointLight(PointLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - surface.position);
+    // diffuse shading
+    float diffuse_cos = max(dot(surface.normal, lightDir), 0.0);
+    // attenuation
+    float distance    = length(light.position - surface.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance +
+  			     light.quadratic * (distance * distance));
+    // combine results
+    vec3 ambient  = light.ambient  * surface.diffuse;
+    vec3 diffuse  = light.diffuse  * diffuse_cos * surface.diffuse;
+    vec3 specular = calcSpecular(light.specular, lightDir, surface, viewDir);
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 calcSpotLight(PointLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - surface.position);
+    float theta = dot(lightDir, normalize(-light.direction));
+    /* For Smoothing Edges */
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp( (theta - light.outerCutOff)/epsilon, 0.0, 1.0 );
+
+    return intensity * calcPointLight(light, surface, viewDir);
+}
+
+// A point light of the LightClusters buffer : 4 texels from texel, position & radius
+// (read first for the range test), diffuse & constant, specular & linear, ambient & quadratic
+PointLight unpackLight(samplerBuffer lightData, int texel, vec4 positionRadius)
+{
+    vec4 diffuseConstant = texelFetch(lightData, texel + 1);
+    vec4 specularLinear = texelFetch(lightData, texel + 2);
+    vec4 ambientQuadratic = texelFetch(lightData, texel + 3);
+    PointLight light;
+    light.position = positionRadius.xyz;
+    light.diffuse = diffuseConstant.rgb;
+    light.constant = diffuseConstant.a;
+    light.specular = specularLinear.rgb;
+    light.linear = specularLinear.a;
+    light.ambient = ambientQuadratic.rgb;
+    light.quadratic = ambientQuadratic.a;
+    return light;
+}
\ No newline at end of file
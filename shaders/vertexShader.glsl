@@ -8,8 +8,12 @@ out vec3 Normal;
 out vec2 TexCoord;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// the FrameData declaration of fragmentShader.glsl too, they link into one program
+#include "frameData.glsl"
+
+// bit-identical to the depth pre-pass positions, see depthVertex.glsl
+invariant gl_Position;
 
 void main()
 {
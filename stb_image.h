@@ -426,6 +426,12 @@ extern "C" {
     STBIDEF stbi_uc* stbi_load(char const* filename, int* x, int* y, int* channels_in_file, int desired_channels);
     STBIDEF stbi_uc* stbi_load_from_file(FILE* f, int* x, int* y, int* channels_in_file, int desired_channels);
     // for stbi_load_from_file, file pointer is left pointing immediately after image
+#ifndef STBI_NO_MMAP
+    // like stbi_load, but decodes straight from a read-only mapping of the file instead
+    // of refilling a stdio buffer. Pipes, devices, empty files and files over 2GB can't
+    // be mapped and go through stbi_load. Define STBI_NO_MMAP to leave it out.
+    STBIDEF stbi_uc* stbi_load_mmap(char const* filename, int* x, int* y, int* channels_in_file, int desired_channels);
+#endif
 #endif
 
 #ifndef STBI_NO_GIF
@@ -523,6 +529,59 @@ extern "C" {
     STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
     STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+    ////////////////////////////////////
+    //
+    // reentrant interface
+    //
+    // every setting of a load in one object passed to the call, instead of the process-wide
+    // flags above : threads decoding with their own stbi_decoder never see each other's
+    // flags, allocator or failure reason. the calls without a decoder keep the old behaviour.
+    // relies on thread-locals, like the _thread setters.
+
+    typedef struct
+    {
+        void* (*malloc) (void* user, size_t size);
+        void* (*realloc)(void* user, void* p, size_t oldsize, size_t newsize);
+        void  (*free)   (void* user, void* p);
+        void* user;
+    } stbi_allocator;
+
+    typedef struct
+    {
+        int   flip_vertically;
+        int   unpremultiply;
+        int   convert_iphone_png_to_rgb;
+        float ldr_to_hdr_gamma, ldr_to_hdr_scale;
+        float hdr_to_ldr_gamma, hdr_to_ldr_scale;
+        stbi_allocator allocator;    // all three or none; none : STBI_MALLOC, STBI_REALLOC & STBI_FREE
+        const char* failure_reason;  // null after a call that succeeded
+        char failure_buffer[32];     // the reasons built at run time, failure_reason may point here
+    } stbi_decoder;
+
+    // the defaults of the process-wide flags
+    STBIDEF void     stbi_decoder_init(stbi_decoder* decoder);
+
+    STBIDEF stbi_uc* stbi_decoder_load_from_memory(stbi_decoder* decoder, stbi_uc const* buffer, int len, int* x, int* y, int* channels_in_file, int desired_channels);
+    STBIDEF stbi_uc* stbi_decoder_load_from_callbacks(stbi_decoder* decoder, stbi_io_callbacks const* clbk, void* user, int* x, int* y, int* channels_in_file, int desired_channels);
+    STBIDEF stbi_us* stbi_decoder_load_16_from_memory(stbi_decoder* decoder, stbi_uc const* buffer, int len, int* x, int* y, int* channels_in_file, int desired_channels);
+#ifndef STBI_NO_LINEAR
+    STBIDEF float*   stbi_decoder_loadf_from_memory(stbi_decoder* decoder, stbi_uc const* buffer, int len, int* x, int* y, int* channels_in_file, int desired_channels);
+#endif
+#ifndef STBI_NO_STDIO
+    STBIDEF stbi_uc* stbi_decoder_load(stbi_decoder* decoder, char const* filename, int* x, int* y, int* channels_in_file, int desired_channels);
+    STBIDEF stbi_uc* stbi_decoder_load_from_file(stbi_decoder* decoder, FILE* f, int* x, int* y, int* channels_in_file, int desired_channels);
+    STBIDEF stbi_us* stbi_decoder_load_16(stbi_decoder* decoder, char const* filename, int* x, int* y, int* channels_in_file, int desired_channels);
+#ifndef STBI_NO_LINEAR
+    STBIDEF float*   stbi_decoder_loadf(stbi_decoder* decoder, char const* filename, int* x, int* y, int* channels_in_file, int desired_channels);
+#endif
+#ifndef STBI_NO_MMAP
+    STBIDEF stbi_uc* stbi_decoder_load_mmap(stbi_decoder* decoder, char const* filename, int* x, int* y, int* channels_in_file, int desired_channels);
+#endif
+#endif
+
+    // with the decoder's allocator
+    STBIDEF void     stbi_decoder_image_free(stbi_decoder* decoder, void* retval_from_stbi_decoder_load);
+
     // ZLIB client - used by PNG, available for other purposes
 
     STBIDEF char* stbi_zlib_decode_malloc_guesssize(const char* buffer, int len, int initial_size, int* outlen);
@@ -595,6 +654,22 @@ extern "C" {
 
 #ifndef STBI_NO_STDIO
 #include <stdio.h>
+#ifndef STBI_NO_MMAP
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#endif
 #endif
 
 #ifndef STBI_ASSERT
@@ -642,12 +717,14 @@ typedef unsigned short stbi__uint16;
 typedef   signed short stbi__int16;
 typedef unsigned int   stbi__uint32;
 typedef   signed int   stbi__int32;
+typedef unsigned __int64 stbi__uint64;
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t  stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -749,7 +826,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
     int info3 = stbi__cpuid3();
@@ -760,7 +837,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
     // If we're even attempting to compile this on GCC/Clang, that means
@@ -962,6 +1039,13 @@ static int      stbi__pnm_info(stbi__context* s, int* x, int* y, int* comp);
 static int      stbi__pnm_is16(stbi__context* s);
 #endif
 
+// the decoder of the stbi_decoder_* call running on this thread, null in the other calls
+static
+#ifdef STBI_THREAD_LOCAL
+STBI_THREAD_LOCAL
+#endif
+stbi_decoder* stbi__decoder;
+
 static
 #ifdef STBI_THREAD_LOCAL
 STBI_THREAD_LOCAL
@@ -976,16 +1060,37 @@ STBIDEF const char* stbi_failure_reason(void)
 #ifndef STBI_NO_FAILURE_STRINGS
 static int stbi__err(const char* str)
 {
-    stbi__g_failure_reason = str;
+    if (stbi__decoder)
+        stbi__decoder->failure_reason = str;
+    else
+        stbi__g_failure_reason = str;
     return 0;
 }
 #endif
 
 static void* stbi__malloc(size_t size)
 {
+    if (stbi__decoder && stbi__decoder->allocator.malloc)
+        return stbi__decoder->allocator.malloc(stbi__decoder->allocator.user, size);
     return STBI_MALLOC(size);
 }
 
+static void* stbi__realloc_sized(void* p, size_t oldsize, size_t newsize)
+{
+    if (stbi__decoder && stbi__decoder->allocator.realloc)
+        return stbi__decoder->allocator.realloc(stbi__decoder->allocator.user, p, oldsize, newsize);
+    return STBI_REALLOC_SIZED(p, oldsize, newsize);
+}
+
+static void stbi__free(void* p)
+{
+    if (stbi__decoder && stbi__decoder->allocator.free) {
+        if (p) stbi__decoder->allocator.free(stbi__decoder->allocator.user, p);
+        return;
+    }
+    STBI_FREE(p);
+}
+
 // stb_image uses ints pervasively, including for offset calculations.
 // therefore the largest decoded image size we can support with the
 // current code, even on 64-bit targets, is INT_MAX. this is not a
@@ -1099,7 +1204,7 @@ static int stbi__mul2shorts_valid(short a, short b)
 
 STBIDEF void stbi_image_free(void* retval_from_stbi_load)
 {
-    STBI_FREE(retval_from_stbi_load);
+    stbi__free(retval_from_stbi_load);
 }
 
 #ifndef STBI_NO_LINEAR
@@ -1118,7 +1223,7 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
 }
 
 #ifndef STBI_THREAD_LOCAL
-#define stbi__vertically_flip_on_load  stbi__vertically_flip_on_load_global
+#define stbi__vertically_flip_on_load_default  stbi__vertically_flip_on_load_global
 #else
 static STBI_THREAD_LOCAL int stbi__vertically_flip_on_load_local, stbi__vertically_flip_on_load_set;
 
@@ -1128,11 +1233,14 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
     stbi__vertically_flip_on_load_set = 1;
 }
 
-#define stbi__vertically_flip_on_load  (stbi__vertically_flip_on_load_set       \
-                                         ? stbi__vertically_flip_on_load_local  \
-                                         : stbi__vertically_flip_on_load_global)
+#define stbi__vertically_flip_on_load_default  (stbi__vertically_flip_on_load_set       \
+                                                 ? stbi__vertically_flip_on_load_local  \
+                                                 : stbi__vertically_flip_on_load_global)
 #endif // STBI_THREAD_LOCAL
 
+#define stbi__vertically_flip_on_load  (stbi__decoder ? stbi__decoder->flip_vertically \
+                                                      : stbi__vertically_flip_on_load_default)
+
 static void* stbi__load_main(stbi__context* s, int* x, int* y, int* comp, int req_comp, stbi__result_info* ri, int bpc)
 {
     memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1198,7 +1306,7 @@ static stbi_uc* stbi__convert_16_to_8(stbi__uint16* orig, int w, int h, int chan
     for (i = 0; i < img_len; ++i)
         reduced[i] = (stbi_uc)((orig[i] >> 8) & 0xFF); // top half of each byte is sufficient approx of 16->8 bit scaling
 
-    STBI_FREE(orig);
+    stbi__free(orig);
     return reduced;
 }
 
@@ -1214,7 +1322,7 @@ static stbi__uint16* stbi__convert_8_to_16(stbi_uc* orig, int w, int h, int chan
     for (i = 0; i < img_len; ++i)
         enlarged[i] = (stbi__uint16)((orig[i] << 8) + orig[i]); // replicate to high and low byte, maps 0->0, 255->0xffff
 
-    STBI_FREE(orig);
+    stbi__free(orig);
     return enlarged;
 }
 
@@ -1408,6 +1516,89 @@ STBIDEF stbi_us* stbi_load_16(char const* filename, int* x, int* y, int* comp, i
     return result;
 }
 
+#ifndef STBI_NO_MMAP
+typedef struct
+{
+    stbi_uc const* data;
+    int len;
+} stbi__mapping;
+
+// regular files only, the others are left to stdio
+static int stbi__map_file(char const* filename, stbi__mapping* m)
+{
+#ifdef _WIN32
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+#if defined(STBI_WINDOWS_UTF8)
+    wchar_t wFilename[1024];
+    if (0 == MultiByteToWideChar(65001 /* UTF8 */, 0, filename, -1, wFilename, sizeof(wFilename) / sizeof(*wFilename)))
+        return 0;
+    file = CreateFileW(wFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+#else
+    file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+#endif
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
+    if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size) || size.QuadPart <= 0 || size.QuadPart > INT_MAX) {
+        CloseHandle(file);
+        return 0;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file); // the view keeps the file open
+    if (mapping == NULL)
+        return 0;
+    m->data = (stbi_uc const*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    m->len = (int)size.QuadPart;
+    return m->data != NULL;
+#else
+    struct stat info;
+    void* view;
+    int fd;
+    // checked before opening : opening a fifo would take the data from the stdio fallback
+    if (stat(filename, &info) != 0 || !S_ISREG(info.st_mode))
+        return 0;
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0 || info.st_size > INT_MAX) {
+        close(fd);
+        return 0;
+    }
+    view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (view == MAP_FAILED)
+        return 0;
+    madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL); // the decoders read front to back
+    m->data = (stbi_uc const*)view;
+    m->len = (int)info.st_size;
+    return 1;
+#endif
+}
+
+static void stbi__unmap_file(stbi__mapping* m)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(m->data);
+#else
+    munmap((void*)m->data, (size_t)m->len);
+#endif
+}
+
+STBIDEF stbi_uc* stbi_load_mmap(char const* filename, int* x, int* y, int* comp, int req_comp)
+{
+    stbi__mapping m;
+    stbi__context s;
+    stbi_uc* result;
+    if (!stbi__map_file(filename, &m))
+        return stbi_load(filename, x, y, comp, req_comp);
+    stbi__start_mem(&s, m.data, m.len);
+    result = stbi__load_and_postprocess_8bit(&s, x, y, comp, req_comp);
+    stbi__unmap_file(&m);
+    return result;
+}
+#endif // !STBI_NO_MMAP
+
 
 #endif //!STBI_NO_STDIO
 
@@ -1580,6 +1771,126 @@ static float stbi__h2l_gamma_i = 1.0f / 2.2f, stbi__h2l_scale_i = 1.0f;
 STBIDEF void   stbi_hdr_to_ldr_gamma(float gamma) { stbi__h2l_gamma_i = 1 / gamma; }
 STBIDEF void   stbi_hdr_to_ldr_scale(float scale) { stbi__h2l_scale_i = 1 / scale; }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+// reentrant interface : the plain calls, run with the decoder installed
+// as this thread's stbi__decoder
+//
+
+STBIDEF void stbi_decoder_init(stbi_decoder* decoder)
+{
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->ldr_to_hdr_gamma = 2.2f;
+    decoder->ldr_to_hdr_scale = 1.0f;
+    decoder->hdr_to_ldr_gamma = 2.2f;
+    decoder->hdr_to_ldr_scale = 1.0f;
+}
+
+// returns the decoder it replaces, a stbi_decoder_* call may nest another
+static stbi_decoder* stbi__decoder_enter(stbi_decoder* decoder)
+{
+    stbi_decoder* outer = stbi__decoder;
+    decoder->failure_reason = NULL;
+    stbi__decoder = decoder;
+    return outer;
+}
+
+// the format probes fail on the way to the right decoder, only a failed call keeps a reason
+static void stbi__decoder_leave(stbi_decoder* outer, void* result)
+{
+    if (result)
+        stbi__decoder->failure_reason = NULL;
+    stbi__decoder = outer;
+}
+
+STBIDEF stbi_uc* stbi_decoder_load_from_memory(stbi_decoder* decoder, stbi_uc const* buffer, int len, int* x, int* y, int* comp, int req_comp)
+{
+    stbi_decoder* outer = stbi__decoder_enter(decoder);
+    stbi_uc* result = stbi_load_from_memory(buffer, len, x, y, comp, req_comp);
+    stbi__decoder_leave(outer, result);
+    return result;
+}
+
+STBIDEF stbi_uc* stbi_decoder_load_from_callbacks(stbi_decoder* decoder, stbi_io_callbacks const* clbk, void* user, int* x, int* y, int* comp, int req_comp)
+{
+    stbi_decoder* outer = stbi__decoder_enter(decoder);
+    stbi_uc* result = stbi_load_from_callbacks(clbk, user, x, y, comp, req_comp);
+    stbi__decoder_leave(outer, result);
+    return result;
+}
+
+STBIDEF stbi_us* stbi_decoder_load_16_from_memory(stbi_decoder* decoder, stbi_uc const* buffer, int len, int* x, int* y, int* comp, int req_comp)
+{
+    stbi_decoder* outer = stbi__decoder_enter(decoder);
+    stbi_us* result = stbi_load_16_from_memory(buffer, len, x, y, comp, req_comp);
+    stbi__decoder_leave(outer, result);
+    return result;
+}
+
+#ifndef STBI_NO_LINEAR
+STBIDEF float* stbi_decoder_loadf_from_memory(stbi_decoder* decoder, stbi_uc const* buffer, int len, int* x, int* y, int* comp, int req_comp)
+{
+    stbi_decoder* outer = stbi__decoder_enter(decoder);
+    float* result = stbi_loadf_from_memory(buffer, len, x, y, comp, req_comp);
+    stbi__decoder_leave(outer, result);
+    return result;
+}
+#endif
+
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc* stbi_decoder_load(stbi_decoder* decoder, char const* filename, int* x, int* y, int* comp, int req_comp)
+{
+    stbi_decoder* outer = stbi__decoder_enter(decoder);
+    stbi_uc* result = stbi_load(filename, x, y, comp, req_comp);
+    stbi__decoder_leave(outer, result);
+    return result;
+}
+
+STBIDEF stbi_uc* stbi_decoder_load_from_file(stbi_decoder* decoder, FILE* f, int* x, int* y, int* comp, int req_comp)
+{
+    stbi_decoder* outer = stbi__decoder_enter(decoder);
+    stbi_uc* result = stbi_load_from_file(f, x, y, comp, req_comp);
+    stbi__decoder_leave(outer, result);
+    return result;
+}
+
+STBIDEF stbi_us* stbi_decoder_load_16(stbi_decoder* decoder, char const* filename, int* x, int* y, int* comp, int req_comp)
+{
+    stbi_decoder* outer = stbi__decoder_enter(decoder);
+    stbi_us* result = stbi_load_16(filename, x, y, comp, req_comp);
+    stbi__decoder_leave(outer, result);
+    return result;
+}
+
+#ifndef STBI_NO_LINEAR
+STBIDEF float* stbi_decoder_loadf(stbi_decoder* decoder, char const* filename, int* x, int* y, int* comp, int req_comp)
+{
+    stbi_decoder* outer = stbi__decoder_enter(decoder);
+    float* result = stbi_loadf(filename, x, y, comp, req_comp);
+    stbi__decoder_leave(outer, result);
+    return result;
+}
+#endif
+
+#ifndef STBI_NO_MMAP
+STBIDEF stbi_uc* stbi_decoder_load_mmap(stbi_decoder* decoder, char const* filename, int* x, int* y, int* comp, int req_comp)
+{
+    stbi_decoder* outer = stbi__decoder_enter(decoder);
+    stbi_uc* result = stbi_load_mmap(filename, x, y, comp, req_comp);
+    stbi__decoder_leave(outer, result);
+    return result;
+}
+#endif
+#endif // !STBI_NO_STDIO
+
+STBIDEF void stbi_decoder_image_free(stbi_decoder* decoder, void* retval_from_stbi_decoder_load)
+{
+    stbi_decoder* outer = stbi__decoder;
+    stbi__decoder = decoder;
+    stbi__free(retval_from_stbi_decoder_load);
+    stbi__decoder = outer;
+}
+
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -1763,7 +2074,7 @@ static unsigned char* stbi__convert_format(unsigned char* data, int img_n, int r
 
     good = (unsigned char*)stbi__malloc_mad3(req_comp, x, y, 0);
     if (good == NULL) {
-        STBI_FREE(data);
+        stbi__free(data);
         return stbi__errpuc("outofmem", "Out of memory");
     }
 
@@ -1788,12 +2099,12 @@ static unsigned char* stbi__convert_format(unsigned char* data, int img_n, int r
             STBI__CASE(4, 1) { dest[0] = stbi__compute_y(src[0], src[1], src[2]); } break;
             STBI__CASE(4, 2) { dest[0] = stbi__compute_y(src[0], src[1], src[2]); dest[1] = src[3]; } break;
             STBI__CASE(4, 3) { dest[0] = src[0]; dest[1] = src[1]; dest[2] = src[2]; } break;
-        default: STBI_ASSERT(0); STBI_FREE(data); STBI_FREE(good); return stbi__errpuc("unsupported", "Unsupported format conversion");
+        default: STBI_ASSERT(0); stbi__free(data); stbi__free(good); return stbi__errpuc("unsupported", "Unsupported format conversion");
         }
 #undef STBI__CASE
     }
 
-    STBI_FREE(data);
+    stbi__free(data);
     return good;
 }
 #endif
@@ -1820,7 +2131,7 @@ static stbi__uint16* stbi__convert_format16(stbi__uint16* data, int img_n, int r
 
     good = (stbi__uint16*)stbi__malloc(req_comp * x * y * 2);
     if (good == NULL) {
-        STBI_FREE(data);
+        stbi__free(data);
         return (stbi__uint16*)stbi__errpuc("outofmem", "Out of memory");
     }
 
@@ -1845,12 +2156,12 @@ static stbi__uint16* stbi__convert_format16(stbi__uint16* data, int img_n, int r
             STBI__CASE(4, 1) { dest[0] = stbi__compute_y_16(src[0], src[1], src[2]); } break;
             STBI__CASE(4, 2) { dest[0] = stbi__compute_y_16(src[0], src[1], src[2]); dest[1] = src[3]; } break;
             STBI__CASE(4, 3) { dest[0] = src[0]; dest[1] = src[1]; dest[2] = src[2]; } break;
-        default: STBI_ASSERT(0); STBI_FREE(data); STBI_FREE(good); return (stbi__uint16*)stbi__errpuc("unsupported", "Unsupported format conversion");
+        default: STBI_ASSERT(0); stbi__free(data); stbi__free(good); return (stbi__uint16*)stbi__errpuc("unsupported", "Unsupported format conversion");
         }
 #undef STBI__CASE
     }
 
-    STBI_FREE(data);
+    stbi__free(data);
     return good;
 }
 #endif
@@ -1860,14 +2171,16 @@ static float* stbi__ldr_to_hdr(stbi_uc* data, int x, int y, int comp)
 {
     int i, k, n;
     float* output;
+    float gamma = stbi__decoder ? stbi__decoder->ldr_to_hdr_gamma : stbi__l2h_gamma;
+    float scale = stbi__decoder ? stbi__decoder->ldr_to_hdr_scale : stbi__l2h_scale;
     if (!data) return NULL;
     output = (float*)stbi__malloc_mad4(x, y, comp, sizeof(float), 0);
-    if (output == NULL) { STBI_FREE(data); return stbi__errpf("outofmem", "Out of memory"); }
+    if (output == NULL) { stbi__free(data); return stbi__errpf("outofmem", "Out of memory"); }
     // compute number of non-alpha components
     if (comp & 1) n = comp; else n = comp - 1;
     for (i = 0; i < x * y; ++i) {
         for (k = 0; k < n; ++k) {
-            output[i * comp + k] = (float)(pow(data[i * comp + k] / 255.0f, stbi__l2h_gamma) * stbi__l2h_scale);
+            output[i * comp + k] = (float)(pow(data[i * comp + k] / 255.0f, gamma) * scale);
         }
     }
     if (n < comp) {
@@ -1875,7 +2188,7 @@ static float* stbi__ldr_to_hdr(stbi_uc* data, int x, int y, int comp)
             output[i * comp + n] = data[i * comp + n] / 255.0f;
         }
     }
-    STBI_FREE(data);
+    stbi__free(data);
     return output;
 }
 #endif
@@ -1886,14 +2199,16 @@ static stbi_uc* stbi__hdr_to_ldr(float* data, int x, int y, int comp)
 {
     int i, k, n;
     stbi_uc* output;
+    float gamma_i = stbi__decoder ? 1 / stbi__decoder->hdr_to_ldr_gamma : stbi__h2l_gamma_i;
+    float scale_i = stbi__decoder ? 1 / stbi__decoder->hdr_to_ldr_scale : stbi__h2l_scale_i;
     if (!data) return NULL;
     output = (stbi_uc*)stbi__malloc_mad3(x, y, comp, 0);
-    if (output == NULL) { STBI_FREE(data); return stbi__errpuc("outofmem", "Out of memory"); }
+    if (output == NULL) { stbi__free(data); return stbi__errpuc("outofmem", "Out of memory"); }
     // compute number of non-alpha components
     if (comp & 1) n = comp; else n = comp - 1;
     for (i = 0; i < x * y; ++i) {
         for (k = 0; k < n; ++k) {
-            float z = (float)pow(data[i * comp + k] * stbi__h2l_scale_i, stbi__h2l_gamma_i) * 255 + 0.5f;
+            float z = (float)pow(data[i * comp + k] * scale_i, gamma_i) * 255 + 0.5f;
             if (z < 0) z = 0;
             if (z > 255) z = 255;
             output[i * comp + k] = (stbi_uc)stbi__float2int(z);
@@ -1905,7 +2220,7 @@ static stbi_uc* stbi__hdr_to_ldr(float* data, int x, int y, int comp)
             output[i * comp + k] = (stbi_uc)stbi__float2int(z);
         }
     }
-    STBI_FREE(data);
+    stbi__free(data);
     return output;
 }
 #endif
@@ -3263,17 +3578,17 @@ static int stbi__free_jpeg_components(stbi__jpeg* z, int ncomp, int why)
     int i;
     for (i = 0; i < ncomp; ++i) {
         if (z->img_comp[i].raw_data) {
-            STBI_FREE(z->img_comp[i].raw_data);
+            stbi__free(z->img_comp[i].raw_data);
             z->img_comp[i].raw_data = NULL;
             z->img_comp[i].data = NULL;
         }
         if (z->img_comp[i].raw_coeff) {
-            STBI_FREE(z->img_comp[i].raw_coeff);
+            stbi__free(z->img_comp[i].raw_coeff);
             z->img_comp[i].raw_coeff = 0;
             z->img_comp[i].coeff = 0;
         }
         if (z->img_comp[i].linebuf) {
-            STBI_FREE(z->img_comp[i].linebuf);
+            stbi__free(z->img_comp[i].linebuf);
             z->img_comp[i].linebuf = NULL;
         }
     }
@@ -4065,7 +4380,7 @@ static void* stbi__jpeg_load(stbi__context* s, int* x, int* y, int* comp, int re
     j->s = s;
     stbi__setup_jpeg(j);
     result = load_jpeg_image(j, x, y, comp, req_comp);
-    STBI_FREE(j);
+    stbi__free(j);
     return result;
 }
 
@@ -4079,7 +4394,7 @@ static int stbi__jpeg_test(stbi__context* s)
     stbi__setup_jpeg(j);
     r = stbi__decode_jpeg_header(j, STBI__SCAN_type);
     stbi__rewind(s);
-    STBI_FREE(j);
+    stbi__free(j);
     return r;
 }
 
@@ -4103,7 +4418,7 @@ static int stbi__jpeg_info(stbi__context* s, int* x, int* y, int* comp)
     memset(j, 0, sizeof(stbi__jpeg));
     j->s = s;
     result = stbi__jpeg_info_raw(j, x, y, comp);
-    STBI_FREE(j);
+    stbi__free(j);
     return result;
 }
 #endif
@@ -4118,15 +4433,51 @@ static int stbi__jpeg_info(stbi__context* s, int* x, int* y, int* comp)
 #ifndef STBI_NO_ZLIB
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
-#define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
+#define STBI__ZFAST_BITS  11 // accelerate all cases in default tables, and most dynamic codes
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 #define STBI__ZNSYMS 288 // number of symbols in literal/length alphabet
 
+// fast table entry : 0 when the code is longer than STBI__ZFAST_BITS, else
+//    bits  0-4   bits taken by the whole entry : both codes of a pair, a length or distance
+//                code with its extra bits
+//    bits  5-6   symbols in the entry, 2 : two literals, from the literal/length tables only
+//    bits  8-16  first symbol
+//    bits 17-24  second literal
+//    bits 25-28  bits of the first code alone
+#define STBI__ZFAST_ENTRY(bits, count, sym, sym2, bits1) \
+    ((stbi__uint32)(bits) | ((stbi__uint32)(count) << 5) | ((stbi__uint32)(sym) << 8) | ((stbi__uint32)(sym2) << 17) | ((stbi__uint32)(bits1) << 25))
+#define STBI__ZFAST_TOTAL(e)   ((e) & 31)
+#define STBI__ZFAST_COUNT(e)   (((e) >> 5) & 3)
+#define STBI__ZFAST_SYMBOL(e)  (((e) >> 8) & 511)
+#define STBI__ZFAST_SYMBOL2(e) (((e) >> 17) & 255)
+#define STBI__ZFAST_BITS1(e)   (((e) >> 25) & 15)
+
+static const int stbi__zlength_base[31] = {
+   3,4,5,6,7,8,9,10,11,13,
+   15,17,19,23,27,31,35,43,51,59,
+   67,83,99,115,131,163,195,227,258,0,0 };
+
+static const int stbi__zlength_extra[31] =
+{ 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
+
+static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,
+257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0 };
+
+static const int stbi__zdist_extra[32] =
+{ 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+enum
+{
+    STBI__ZTABLE_CODELENGTH,
+    STBI__ZTABLE_LENGTH,   // literal/length : literal pairs, lengths with their extra bits
+    STBI__ZTABLE_DISTANCE  // distances with their extra bits
+};
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
 {
-    stbi__uint16 fast[1 << STBI__ZFAST_BITS];
+    stbi__uint32 fast[1 << STBI__ZFAST_BITS];
     stbi__uint16 firstcode[16];
     int maxcode[17];
     stbi__uint16 firstsymbol[16];
@@ -4151,7 +4502,7 @@ stbi_inline static int stbi__bit_reverse(int v, int bits)
     return stbi__bitreverse16(v) >> (16 - bits);
 }
 
-static int stbi__zbuild_huffman(stbi__zhuffman* z, const stbi_uc* sizelist, int num)
+static int stbi__zbuild_huffman(stbi__zhuffman* z, const stbi_uc* sizelist, int num, int table)
 {
     int i, k = 0;
     int code, next_code[16], sizes[17];
@@ -4182,7 +4533,9 @@ static int stbi__zbuild_huffman(stbi__zhuffman* z, const stbi_uc* sizelist, int
         int s = sizelist[i];
         if (s) {
             int c = next_code[s] - z->firstcode[s] + z->firstsymbol[s];
-            stbi__uint16 fastv = (stbi__uint16)((s << 9) | i);
+            int extra = table == STBI__ZTABLE_LENGTH && i > 256 ? stbi__zlength_extra[i - 257]
+                : table == STBI__ZTABLE_DISTANCE ? stbi__zdist_extra[i] : 0;
+            stbi__uint32 fastv = STBI__ZFAST_ENTRY(s + extra, 1, i, 0, s);
             z->size[c] = (stbi_uc)s;
             z->value[c] = (stbi__uint16)i;
             if (s <= STBI__ZFAST_BITS) {
@@ -4195,6 +4548,21 @@ static int stbi__zbuild_huffman(stbi__zhuffman* z, const stbi_uc* sizelist, int
             ++next_code[s];
         }
     }
+    if (table == STBI__ZTABLE_LENGTH) {
+        // the bits after a short literal index the table again : the entry there is a
+        // whole code when it is no longer than the bits left. from the top down, i >> s
+        // is below i and still holds a single symbol
+        for (i = (1 << STBI__ZFAST_BITS) - 1; i >= 0; --i) {
+            stbi__uint32 first = z->fast[i], second;
+            int s = STBI__ZFAST_TOTAL(first);
+            if (STBI__ZFAST_COUNT(first) != 1 || STBI__ZFAST_SYMBOL(first) >= 256 || s >= STBI__ZFAST_BITS)
+                continue;
+            second = z->fast[i >> s];
+            if (STBI__ZFAST_COUNT(second) != 1 || STBI__ZFAST_SYMBOL(second) >= 256 || s + STBI__ZFAST_TOTAL(second) > STBI__ZFAST_BITS)
+                continue;
+            z->fast[i] = STBI__ZFAST_ENTRY(s + STBI__ZFAST_TOTAL(second), 2, STBI__ZFAST_SYMBOL(first), STBI__ZFAST_SYMBOL(second), s);
+        }
+    }
     return 1;
 }
 
@@ -4208,7 +4576,8 @@ typedef struct
 {
     stbi_uc* zbuffer, * zbuffer_end;
     int num_bits;
-    stbi__uint32 code_buffer;
+    int num_padding; // zero bytes read past the end, still counted in num_bits
+    stbi__uint64 code_buffer; // may hold garbage above num_bits after the fast loop's refill
 
     char* zout;
     char* zout_start;
@@ -4228,23 +4597,30 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf* z)
     return stbi__zeof(z) ? 0 : *z->zbuffer++;
 }
 
+// byte at a time, reads zeros past the end
 static void stbi__fill_bits(stbi__zbuf* z)
 {
+    z->code_buffer &= ((stbi__uint64)1 << z->num_bits) - 1;
     do {
-        if (z->code_buffer >= (1U << z->num_bits)) {
-            z->zbuffer = z->zbuffer_end;  /* treat this as EOF so we fail. */
-            return;
-        }
-        z->code_buffer |= (unsigned int)stbi__zget8(z) << z->num_bits;
+        if (stbi__zeof(z))
+            ++z->num_padding;
+        z->code_buffer |= (stbi__uint64)stbi__zget8(z) << z->num_bits;
         z->num_bits += 8;
-    } while (z->num_bits <= 24);
+    } while (z->num_bits <= 56);
 }
 
+#if defined(STBI__X86_TARGET) || defined(STBI__X64_TARGET) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define STBI__ZLOAD64(v, p)  memcpy(&(v), p, 8)
+#else
+#define STBI__ZLOAD64(v, p)  ((v) = (stbi__uint64)(p)[0] | (stbi__uint64)(p)[1] << 8 | (stbi__uint64)(p)[2] << 16 | (stbi__uint64)(p)[3] << 24 \
+                                   | (stbi__uint64)(p)[4] << 32 | (stbi__uint64)(p)[5] << 40 | (stbi__uint64)(p)[6] << 48 | (stbi__uint64)(p)[7] << 56)
+#endif
+
 stbi_inline static unsigned int stbi__zreceive(stbi__zbuf* z, int n)
 {
     unsigned int k;
     if (z->num_bits < n) stbi__fill_bits(z);
-    k = z->code_buffer & ((1 << n) - 1);
+    k = (unsigned int)(z->code_buffer & ((1 << n) - 1));
     z->code_buffer >>= n;
     z->num_bits -= n;
     return k;
@@ -4255,7 +4631,7 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf* a, stbi__zhuffman* z)
     int b, s, k;
     // not resolved by fast table, so compute it the slow way
     // use jpeg approach, which requires MSbits at top
-    k = stbi__bit_reverse(a->code_buffer, 16);
+    k = stbi__bit_reverse((int)(a->code_buffer & 0xffff), 16);
     for (s = STBI__ZFAST_BITS + 1; ; ++s)
         if (k < z->maxcode[s])
             break;
@@ -4269,21 +4645,25 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf* a, stbi__zhuffman* z)
     return z->value[b];
 }
 
+// one symbol, from an entry's first symbol when it holds two
 stbi_inline static int stbi__zhuffman_decode(stbi__zbuf* a, stbi__zhuffman* z)
 {
-    int b, s;
+    stbi__uint32 b;
+    int s;
     if (a->num_bits < 16) {
-        if (stbi__zeof(a)) {
+        // a stream may end right after its last code : the zeros read past the end only fill the
+        // lookup. once one of them has been decoded the data is truncated, the next call stops it
+        if (stbi__zeof(a) && a->num_bits < a->num_padding * 8) {
             return -1;   /* report error for unexpected end of data. */
         }
         stbi__fill_bits(a);
     }
     b = z->fast[a->code_buffer & STBI__ZFAST_MASK];
     if (b) {
-        s = b >> 9;
+        s = STBI__ZFAST_BITS1(b);
         a->code_buffer >>= s;
         a->num_bits -= s;
-        return b & 511;
+        return STBI__ZFAST_SYMBOL(b);
     }
     return stbi__zhuffman_decode_slowpath(a, z);
 }
@@ -4301,7 +4681,7 @@ static int stbi__zexpand(stbi__zbuf* z, char* zout, int n)  // need to make room
         if (limit > UINT_MAX / 2) return stbi__err("outofmem", "Out of memory");
         limit *= 2;
     }
-    q = (char*)STBI_REALLOC_SIZED(z->zout_start, old_limit, limit);
+    q = (char*)stbi__realloc_sized(z->zout_start, old_limit, limit);
     STBI_NOTUSED(old_limit);
     if (q == NULL) return stbi__err("outofmem", "Out of memory");
     z->zout_start = q;
@@ -4310,25 +4690,122 @@ static int stbi__zexpand(stbi__zbuf* z, char* zout, int n)  // need to make room
     return 1;
 }
 
-static const int stbi__zlength_base[31] = {
-   3,4,5,6,7,8,9,10,11,13,
-   15,17,19,23,27,31,35,43,51,59,
-   67,83,99,115,131,163,195,227,258,0,0 };
+// the longest match, plus what the wide copies write past it
+#define STBI__ZFAST_OUT_MARGIN  (258 + 16)
 
-static const int stbi__zlength_extra[31] =
-{ 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
-
-static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,
-257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0 };
-
-static const int stbi__zdist_extra[32] =
-{ 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+stbi_inline static void stbi__zcopy_match(char* zout, int dist, int len)
+{
+    stbi_uc* p = (stbi_uc*)(zout - dist);
+    char* end = zout + len;
+    if (dist >= 16) { // 16 bytes at a time, the last copy runs past the match
+        do { memcpy(zout, p, 16); zout += 16; p += 16; } while (zout < end);
+    }
+    else if (dist >= 8) { // each copy reads bytes written at least one copy before
+        do { memcpy(zout, p, 8); zout += 8; p += 8; } while (zout < end);
+    }
+    else if (dist == 1) { // run of one byte; common in images.
+        memset(zout, *p, len);
+    }
+    else {
+        do *zout++ = *p++; while (zout < end);
+    }
+}
 
 static int stbi__parse_huffman_block(stbi__zbuf* a)
 {
     char* zout = a->zout;
     for (;;) {
-        int z = stbi__zhuffman_decode(a, &a->z_length);
+        int z;
+        // fast loop : whole input words and room for any match, so no bounds check per symbol.
+        // one refill covers the longest length + distance pair, 48 bits. the bit state lives
+        // in locals here, the output stores would make the compiler reload it from a
+        const stbi_uc* in = a->zbuffer, * in_end = a->zbuffer_end;
+        char* out_end = a->zout_end;
+        stbi__uint64 bits = a->code_buffer;
+        int num_bits = a->num_bits;
+        const stbi__uint32* lfast = a->z_length.fast, * dfast = a->z_distance.fast;
+        while (in_end - in >= 8 && out_end - zout >= STBI__ZFAST_OUT_MARGIN) {
+            stbi__uint64 next;
+            stbi__uint32 e;
+            int len, dist, s, extra = 0;
+            // at least 56 bits, no branch : 8 bytes are read, the whole bytes that fit are kept.
+            // the one cut short lands above num_bits, the next refill ors in the same bits
+            STBI__ZLOAD64(next, in);
+            bits |= next << num_bits;
+            in += (63 - num_bits) >> 3;
+            num_bits |= 56;
+
+            e = lfast[bits & STBI__ZFAST_MASK];
+            if (STBI__ZFAST_COUNT(e) == 2) {
+                s = STBI__ZFAST_TOTAL(e);
+                bits >>= s;
+                num_bits -= s;
+                zout[0] = (char)STBI__ZFAST_SYMBOL(e);
+                zout[1] = (char)STBI__ZFAST_SYMBOL2(e);
+                zout += 2;
+                continue;
+            }
+            if (e) {
+                // a length takes its extra bits along, they sit right above the code
+                s = STBI__ZFAST_TOTAL(e);
+                extra = (int)(bits >> STBI__ZFAST_BITS1(e)) & ((1 << (s - STBI__ZFAST_BITS1(e))) - 1);
+                bits >>= s;
+                num_bits -= s;
+                z = STBI__ZFAST_SYMBOL(e);
+            }
+            else {
+                a->code_buffer = bits;
+                a->num_bits = num_bits;
+                z = stbi__zhuffman_decode_slowpath(a, &a->z_length);
+                if (z > 256 && z < 286)
+                    extra = (int)stbi__zreceive(a, stbi__zlength_extra[z - 257]); // no refill, 56 - 15 bits left
+                bits = a->code_buffer;
+                num_bits = a->num_bits;
+                if (z < 0) return stbi__err("bad huffman code", "Corrupt PNG");
+            }
+            if (z < 256) {
+                *zout++ = (char)z;
+                continue;
+            }
+            if (z == 256) {
+                a->zbuffer = (stbi_uc*)in;
+                a->code_buffer = bits;
+                a->num_bits = num_bits;
+                a->zout = zout;
+                return 1;
+            }
+            if (z >= 286) return stbi__err("bad huffman code", "Corrupt PNG"); // per DEFLATE, length codes 286 and 287 must not appear in compressed data
+            len = stbi__zlength_base[z - 257] + extra;
+
+            e = dfast[bits & STBI__ZFAST_MASK];
+            if (e) {
+                s = STBI__ZFAST_TOTAL(e);
+                extra = (int)(bits >> STBI__ZFAST_BITS1(e)) & ((1 << (s - STBI__ZFAST_BITS1(e))) - 1);
+                bits >>= s;
+                num_bits -= s;
+                z = STBI__ZFAST_SYMBOL(e);
+            }
+            else {
+                a->code_buffer = bits;
+                a->num_bits = num_bits;
+                z = stbi__zhuffman_decode_slowpath(a, &a->z_distance);
+                if (z >= 0 && z < 30)
+                    extra = (int)stbi__zreceive(a, stbi__zdist_extra[z]);
+                bits = a->code_buffer;
+                num_bits = a->num_bits;
+            }
+            if (z < 0 || z >= 30) return stbi__err("bad huffman code", "Corrupt PNG"); // per DEFLATE, distance codes 30 and 31 must not appear in compressed data
+            dist = stbi__zdist_base[z] + extra;
+            if (zout - a->zout_start < dist) return stbi__err("bad dist", "Corrupt PNG");
+            stbi__zcopy_match(zout, dist, len);
+            zout += len;
+        }
+        a->zbuffer = (stbi_uc*)in;
+        a->code_buffer = bits;
+        a->num_bits = num_bits;
+
+        // near either end : one symbol with every check
+        z = stbi__zhuffman_decode(a, &a->z_length);
         if (z < 256) {
             if (z < 0) return stbi__err("bad huffman code", "Corrupt PNG"); // error in huffman codes
             if (zout >= a->zout_end) {
@@ -4387,7 +4864,7 @@ static int stbi__compute_huffman_codes(stbi__zbuf* a)
         int s = stbi__zreceive(a, 3);
         codelength_sizes[length_dezigzag[i]] = (stbi_uc)s;
     }
-    if (!stbi__zbuild_huffman(&z_codelength, codelength_sizes, 19)) return 0;
+    if (!stbi__zbuild_huffman(&z_codelength, codelength_sizes, 19, STBI__ZTABLE_CODELENGTH)) return 0;
 
     n = 0;
     while (n < ntot) {
@@ -4417,28 +4894,31 @@ static int stbi__compute_huffman_codes(stbi__zbuf* a)
         }
     }
     if (n != ntot) return stbi__err("bad codelengths", "Corrupt PNG");
-    if (!stbi__zbuild_huffman(&a->z_length, lencodes, hlit)) return 0;
-    if (!stbi__zbuild_huffman(&a->z_distance, lencodes + hlit, hdist)) return 0;
+    if (!stbi__zbuild_huffman(&a->z_length, lencodes, hlit, STBI__ZTABLE_LENGTH)) return 0;
+    if (!stbi__zbuild_huffman(&a->z_distance, lencodes + hlit, hdist, STBI__ZTABLE_DISTANCE)) return 0;
     return 1;
 }
 
 static int stbi__parse_uncompressed_block(stbi__zbuf* a)
 {
     stbi_uc header[4];
-    int len, nlen, k;
+    int len, nlen, k, unread;
     if (a->num_bits & 7)
         stbi__zreceive(a, a->num_bits & 7); // discard
-    // drain the bit-packed data into header
-    k = 0;
-    while (a->num_bits > 0) {
-        header[k++] = (stbi_uc)(a->code_buffer & 255); // suppress MSVC run-time check
-        a->code_buffer >>= 8;
-        a->num_bits -= 8;
-    }
+    // hand the whole bytes still in the bit buffer back to the input, the past-the-end zeros first
     if (a->num_bits < 0) return stbi__err("zlib corrupt", "Corrupt PNG");
+    unread = a->num_bits >> 3;
+    if (unread > a->num_padding) {
+        a->zbuffer -= unread - a->num_padding;
+        a->num_padding = 0;
+    }
+    else
+        a->num_padding -= unread;
+    a->code_buffer = 0;
+    a->num_bits = 0;
     // now fill header the normal way
-    while (k < 4)
-        header[k++] = stbi__zget8(a);
+    for (k = 0; k < 4; ++k)
+        header[k] = stbi__zget8(a);
     len = header[1] * 256 + header[0];
     nlen = header[3] * 256 + header[2];
     if (nlen != (len ^ 0xffff)) return stbi__err("zlib corrupt", "Corrupt PNG");
@@ -4500,6 +4980,7 @@ static int stbi__parse_zlib(stbi__zbuf* a, int parse_header)
     if (parse_header)
         if (!stbi__parse_zlib_header(a)) return 0;
     a->num_bits = 0;
+    a->num_padding = 0;
     a->code_buffer = 0;
     do {
         final = stbi__zreceive(a, 1);
@@ -4513,13 +4994,15 @@ static int stbi__parse_zlib(stbi__zbuf* a, int parse_header)
         else {
             if (type == 1) {
                 // use fixed code lengths
-                if (!stbi__zbuild_huffman(&a->z_length, stbi__zdefault_length, STBI__ZNSYMS)) return 0;
-                if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance, 32)) return 0;
+                if (!stbi__zbuild_huffman(&a->z_length, stbi__zdefault_length, STBI__ZNSYMS, STBI__ZTABLE_LENGTH)) return 0;
+                if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance, 32, STBI__ZTABLE_DISTANCE)) return 0;
             }
             else {
                 if (!stbi__compute_huffman_codes(a)) return 0;
             }
             if (!stbi__parse_huffman_block(a)) return 0;
+            // decoded from the zeros read past the end : a truncated stream
+            if (a->num_bits < a->num_padding * 8) return stbi__err("unexpected end", "Corrupt PNG");
         }
     } while (!final);
     return 1;
@@ -4547,7 +5030,7 @@ STBIDEF char* stbi_zlib_decode_malloc_guesssize(const char* buffer, int len, int
         return a.zout_start;
     }
     else {
-        STBI_FREE(a.zout_start);
+        stbi__free(a.zout_start);
         return NULL;
     }
 }
@@ -4569,7 +5052,7 @@ STBIDEF char* stbi_zlib_decode_malloc_guesssize_headerflag(const char* buffer, i
         return a.zout_start;
     }
     else {
-        STBI_FREE(a.zout_start);
+        stbi__free(a.zout_start);
         return NULL;
     }
 }
@@ -4597,7 +5080,7 @@ STBIDEF char* stbi_zlib_decode_noheader_malloc(char const* buffer, int len, int*
         return a.zout_start;
     }
     else {
-        STBI_FREE(a.zout_start);
+        stbi__free(a.zout_start);
         return NULL;
     }
 }
@@ -4689,6 +5172,232 @@ static int stbi__paeth(int a, int b, int c)
 
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
+// unfilter the w pixels after the first one of a row. filter_bytes of each pixel are filtered,
+// output_bytes is the pixel size in cur and prior : one more sample when an opaque alpha is added
+static void stbi__unfilter_row(stbi_uc* cur, const stbi_uc* prior, const stbi_uc* raw, int w, int filter, int filter_bytes, int output_bytes)
+{
+    int i, k;
+    // this is a little gross, so that we don't switch per-pixel or per-component
+    if (filter_bytes == output_bytes) {
+        int nk = w * filter_bytes;
+#define STBI__CASE(f) \
+         case f:     \
+            for (k=0; k < nk; ++k)
+        switch (filter) {
+            // "none" filter turns into a memcpy here; make that explicit.
+        case STBI__F_none:         memcpy(cur, raw, nk); break;
+            STBI__CASE(STBI__F_sub) { cur[k] = STBI__BYTECAST(raw[k] + cur[k - filter_bytes]); } break;
+            STBI__CASE(STBI__F_up) { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
+            STBI__CASE(STBI__F_avg) { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k - filter_bytes]) >> 1)); } break;
+            STBI__CASE(STBI__F_paeth) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], prior[k], prior[k - filter_bytes])); } break;
+            STBI__CASE(STBI__F_avg_first) { cur[k] = STBI__BYTECAST(raw[k] + (cur[k - filter_bytes] >> 1)); } break;
+            STBI__CASE(STBI__F_paeth_first) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], 0, 0)); } break;
+        }
+#undef STBI__CASE
+    }
+    else {
+        STBI_ASSERT(filter_bytes < output_bytes);
+#define STBI__CASE(f) \
+         case f:     \
+            for (i=w; i >= 1; --i, cur[filter_bytes]=255,raw+=filter_bytes,cur+=output_bytes,prior+=output_bytes) \
+               for (k=0; k < filter_bytes; ++k)
+        switch (filter) {
+            STBI__CASE(STBI__F_none) { cur[k] = raw[k]; } break;
+            STBI__CASE(STBI__F_sub) { cur[k] = STBI__BYTECAST(raw[k] + cur[k - output_bytes]); } break;
+            STBI__CASE(STBI__F_up) { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
+            STBI__CASE(STBI__F_avg) { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k - output_bytes]) >> 1)); } break;
+            STBI__CASE(STBI__F_paeth) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - output_bytes], prior[k], prior[k - output_bytes])); } break;
+            STBI__CASE(STBI__F_avg_first) { cur[k] = STBI__BYTECAST(raw[k] + (cur[k - output_bytes] >> 1)); } break;
+            STBI__CASE(STBI__F_paeth_first) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - output_bytes], 0, 0)); } break;
+        }
+#undef STBI__CASE
+    }
+}
+
+#if defined(STBI_SSE2) || defined(STBI_NEON)
+// a pixel of 3, 4, 6 or 8 bytes : 8 byte loads and stores while they stay inside the row,
+// exact copies for the last pixels
+static void stbi__png_load_px(stbi_uc* px, const stbi_uc* p, int n)
+{
+    memset(px, 0, 8);
+    memcpy(px, p, n);
+}
+
+// the pixels from which 8 byte accesses stay inside the row
+static int stbi__png_wide_pixels(int w, int filter_bytes)
+{
+    return w - (8 + filter_bytes - 1) / filter_bytes + 1;
+}
+#endif
+
+#ifdef STBI_SSE2
+// same result as stbi__unfilter_row. sub, avg and paeth need the pixel on the left, so they run a
+// pixel per step, all its bytes at once : paeth without branches, in 16 bit lanes. up runs 16 bytes
+// at a time when there is no alpha to add
+static void stbi__unfilter_row_simd(stbi_uc* cur, const stbi_uc* prior, const stbi_uc* raw, int w, int filter, int filter_bytes, int output_bytes)
+{
+    STBI_SIMD_ALIGN(stbi_uc, px[8]);
+    __m128i zero = _mm_setzero_si128();
+    __m128i ones = _mm_set1_epi8(1), low7 = _mm_set1_epi8(0x7f);
+    __m128i alpha, a, b, c, x, d;
+    int i, k, wide;
+
+    if (filter == STBI__F_up && filter_bytes == output_bytes) {
+        int nk = w * filter_bytes;
+        for (k = 0; k + 16 <= nk; k += 16) {
+            x = _mm_loadu_si128((const __m128i*)(raw + k));
+            b = _mm_loadu_si128((const __m128i*)(prior + k));
+            _mm_storeu_si128((__m128i*)(cur + k), _mm_add_epi8(x, b));
+        }
+        for (; k < nk; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+        return;
+    }
+    if ((filter_bytes != 3 && filter_bytes != 4 && filter_bytes != 6 && filter_bytes != 8) || (filter == STBI__F_none && filter_bytes == output_bytes)) {
+        stbi__unfilter_row(cur, prior, raw, w, filter, filter_bytes, output_bytes);
+        return;
+    }
+
+    // ff in the added alpha bytes
+    memset(px, 0, 8);
+    memset(px + filter_bytes, 255, output_bytes - filter_bytes);
+    alpha = _mm_loadl_epi64((const __m128i*)px);
+    wide = stbi__png_wide_pixels(w, filter_bytes);
+    stbi__png_load_px(px, cur - output_bytes, filter_bytes);
+    a = _mm_loadl_epi64((const __m128i*)px);
+    c = zero;
+    if (filter == STBI__F_paeth) {
+        stbi__png_load_px(px, prior - output_bytes, filter_bytes);
+        c = _mm_loadl_epi64((const __m128i*)px);
+    }
+
+#define STBI__LOAD(p) \
+        (i < wide ? _mm_loadl_epi64((const __m128i*)(p)) : (stbi__png_load_px(px, p, filter_bytes), _mm_loadl_epi64((const __m128i*)px)))
+#define STBI__CASE(f) \
+     case f:     \
+        for (i=0; i < w; ++i, a=d, raw+=filter_bytes, cur+=output_bytes, prior+=output_bytes)
+#define STBI__STORE(v) \
+        if (i < wide) _mm_storel_epi64((__m128i*)cur, _mm_or_si128(v, alpha)); \
+        else { _mm_storel_epi64((__m128i*)px, _mm_or_si128(v, alpha)); memcpy(cur, px, output_bytes); }
+    switch (filter) {
+        STBI__CASE(STBI__F_none) { d = STBI__LOAD(raw); STBI__STORE(d); } break;
+        // paeth(a, 0, 0) is a
+    case STBI__F_paeth_first:
+        STBI__CASE(STBI__F_sub) { d = _mm_add_epi8(STBI__LOAD(raw), a); STBI__STORE(d); } break;
+        STBI__CASE(STBI__F_up) { d = _mm_add_epi8(STBI__LOAD(raw), STBI__LOAD(prior)); STBI__STORE(d); } break;
+        // avg rounds up, the average has to round down
+        STBI__CASE(STBI__F_avg) { b = STBI__LOAD(prior); d = _mm_add_epi8(STBI__LOAD(raw), _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), ones))); STBI__STORE(d); } break;
+        STBI__CASE(STBI__F_avg_first) { d = _mm_add_epi8(STBI__LOAD(raw), _mm_and_si128(_mm_srli_epi16(a, 1), low7)); STBI__STORE(d); } break;
+        STBI__CASE(STBI__F_paeth) {
+            __m128i a16, b16, c16, pa, pb, pc, smallest, nearest, is_b;
+            b = STBI__LOAD(prior);
+            x = STBI__LOAD(raw);
+            a16 = _mm_unpacklo_epi8(a, zero);
+            b16 = _mm_unpacklo_epi8(b, zero);
+            c16 = _mm_unpacklo_epi8(c, zero);
+            // p = a + b - c : pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|
+            pa = _mm_sub_epi16(b16, c16);
+            pb = _mm_sub_epi16(a16, c16);
+            pc = _mm_add_epi16(pa, pb);
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            // ties go to a, then b
+            smallest = _mm_min_epi16(pa, _mm_min_epi16(pb, pc));
+            is_b = _mm_cmpeq_epi16(pb, smallest);
+            nearest = _mm_or_si128(_mm_and_si128(is_b, b16), _mm_andnot_si128(is_b, c16));
+            is_b = _mm_cmpeq_epi16(pa, smallest);
+            nearest = _mm_or_si128(_mm_and_si128(is_b, a16), _mm_andnot_si128(is_b, nearest));
+            d = _mm_add_epi8(x, _mm_packus_epi16(nearest, nearest));
+            c = b;
+            STBI__STORE(d);
+        } break;
+    }
+#undef STBI__STORE
+#undef STBI__CASE
+#undef STBI__LOAD
+}
+#endif // STBI_SSE2
+
+#ifdef STBI_NEON
+// same result as stbi__unfilter_row, see the SSE2 version
+static void stbi__unfilter_row_simd(stbi_uc* cur, const stbi_uc* prior, const stbi_uc* raw, int w, int filter, int filter_bytes, int output_bytes)
+{
+    STBI_SIMD_ALIGN(stbi_uc, px[8]);
+    uint8x8_t alpha, a, b, c, x, d;
+    int i, k, wide;
+
+    if (filter == STBI__F_up && filter_bytes == output_bytes) {
+        int nk = w * filter_bytes;
+        for (k = 0; k + 16 <= nk; k += 16)
+            vst1q_u8(cur + k, vaddq_u8(vld1q_u8(raw + k), vld1q_u8(prior + k)));
+        for (; k < nk; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+        return;
+    }
+    if ((filter_bytes != 3 && filter_bytes != 4 && filter_bytes != 6 && filter_bytes != 8) || (filter == STBI__F_none && filter_bytes == output_bytes)) {
+        stbi__unfilter_row(cur, prior, raw, w, filter, filter_bytes, output_bytes);
+        return;
+    }
+
+    // ff in the added alpha bytes
+    memset(px, 0, 8);
+    memset(px + filter_bytes, 255, output_bytes - filter_bytes);
+    alpha = vld1_u8(px);
+    wide = stbi__png_wide_pixels(w, filter_bytes);
+    stbi__png_load_px(px, cur - output_bytes, filter_bytes);
+    a = vld1_u8(px);
+    c = vdup_n_u8(0);
+    if (filter == STBI__F_paeth) {
+        stbi__png_load_px(px, prior - output_bytes, filter_bytes);
+        c = vld1_u8(px);
+    }
+
+#define STBI__LOAD(p) \
+        (i < wide ? vld1_u8(p) : (stbi__png_load_px(px, p, filter_bytes), vld1_u8(px)))
+#define STBI__CASE(f) \
+     case f:     \
+        for (i=0; i < w; ++i, a=d, raw+=filter_bytes, cur+=output_bytes, prior+=output_bytes)
+#define STBI__STORE(v) \
+        if (i < wide) vst1_u8(cur, vorr_u8(v, alpha)); \
+        else { vst1_u8(px, vorr_u8(v, alpha)); memcpy(cur, px, output_bytes); }
+    switch (filter) {
+        STBI__CASE(STBI__F_none) { d = STBI__LOAD(raw); STBI__STORE(d); } break;
+        // paeth(a, 0, 0) is a
+    case STBI__F_paeth_first:
+        STBI__CASE(STBI__F_sub) { d = vadd_u8(STBI__LOAD(raw), a); STBI__STORE(d); } break;
+        STBI__CASE(STBI__F_up) { d = vadd_u8(STBI__LOAD(raw), STBI__LOAD(prior)); STBI__STORE(d); } break;
+        STBI__CASE(STBI__F_avg) { b = STBI__LOAD(prior); d = vadd_u8(STBI__LOAD(raw), vhadd_u8(a, b)); STBI__STORE(d); } break;
+        STBI__CASE(STBI__F_avg_first) { d = vadd_u8(STBI__LOAD(raw), vshr_n_u8(a, 1)); STBI__STORE(d); } break;
+        STBI__CASE(STBI__F_paeth) {
+            uint16x8_t a16, b16, c16, nearest;
+            int16x8_t pa, pb, pc, smallest;
+            b = STBI__LOAD(prior);
+            x = STBI__LOAD(raw);
+            a16 = vmovl_u8(a);
+            b16 = vmovl_u8(b);
+            c16 = vmovl_u8(c);
+            // p = a + b - c : pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|
+            pa = vreinterpretq_s16_u16(vsubq_u16(b16, c16));
+            pb = vreinterpretq_s16_u16(vsubq_u16(a16, c16));
+            pc = vabsq_s16(vaddq_s16(pa, pb));
+            pa = vabsq_s16(pa);
+            pb = vabsq_s16(pb);
+            // ties go to a, then b
+            smallest = vminq_s16(pa, vminq_s16(pb, pc));
+            nearest = vbslq_u16(vceqq_s16(pb, smallest), b16, c16);
+            nearest = vbslq_u16(vceqq_s16(pa, smallest), a16, nearest);
+            d = vadd_u8(x, vmovn_u16(nearest));
+            c = b;
+            STBI__STORE(d);
+        } break;
+    }
+#undef STBI__STORE
+#undef STBI__CASE
+#undef STBI__LOAD
+}
+#endif // STBI_NEON
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -4702,6 +5411,16 @@ static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 r
     int output_bytes = out_n * bytes;
     int filter_bytes = img_n * bytes;
     int width = x;
+    void (*unfilter_row)(stbi_uc* cur, const stbi_uc* prior, const stbi_uc* raw, int w, int filter, int filter_bytes, int output_bytes) = stbi__unfilter_row;
+
+#ifdef STBI_SSE2
+    if (stbi__sse2_available())
+        unfilter_row = stbi__unfilter_row_simd;
+#endif
+
+#ifdef STBI_NEON
+    unfilter_row = stbi__unfilter_row_simd;
+#endif
 
     STBI_ASSERT(out_n == s->img_n || out_n == s->img_n + 1);
     a->out = (stbi_uc*)stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4770,43 +5489,16 @@ static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 r
             prior += 1;
         }
 
-        // this is a little gross, so that we don't switch per-pixel or per-component
         if (depth < 8 || img_n == out_n) {
-            int nk = (width - 1) * filter_bytes;
-#define STBI__CASE(f) \
-             case f:     \
-                for (k=0; k < nk; ++k)
-            switch (filter) {
-                // "none" filter turns into a memcpy here; make that explicit.
-            case STBI__F_none:         memcpy(cur, raw, nk); break;
-                STBI__CASE(STBI__F_sub) { cur[k] = STBI__BYTECAST(raw[k] + cur[k - filter_bytes]); } break;
-                STBI__CASE(STBI__F_up) { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
-                STBI__CASE(STBI__F_avg) { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k - filter_bytes]) >> 1)); } break;
-                STBI__CASE(STBI__F_paeth) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], prior[k], prior[k - filter_bytes])); } break;
-                STBI__CASE(STBI__F_avg_first) { cur[k] = STBI__BYTECAST(raw[k] + (cur[k - filter_bytes] >> 1)); } break;
-                STBI__CASE(STBI__F_paeth_first) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], 0, 0)); } break;
-            }
-#undef STBI__CASE
-            raw += nk;
+            unfilter_row(cur, prior, raw, width - 1, filter, filter_bytes, filter_bytes);
+            raw += (width - 1) * filter_bytes;
         }
         else {
             STBI_ASSERT(img_n + 1 == out_n);
-#define STBI__CASE(f) \
-             case f:     \
-                for (i=x-1; i >= 1; --i, cur[filter_bytes]=255,raw+=filter_bytes,cur+=output_bytes,prior+=output_bytes) \
-                   for (k=0; k < filter_bytes; ++k)
-            switch (filter) {
-                STBI__CASE(STBI__F_none) { cur[k] = raw[k]; } break;
-                STBI__CASE(STBI__F_sub) { cur[k] = STBI__BYTECAST(raw[k] + cur[k - output_bytes]); } break;
-                STBI__CASE(STBI__F_up) { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
-                STBI__CASE(STBI__F_avg) { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k - output_bytes]) >> 1)); } break;
-                STBI__CASE(STBI__F_paeth) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - output_bytes], prior[k], prior[k - output_bytes])); } break;
-                STBI__CASE(STBI__F_avg_first) { cur[k] = STBI__BYTECAST(raw[k] + (cur[k - output_bytes] >> 1)); } break;
-                STBI__CASE(STBI__F_paeth_first) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - output_bytes], 0, 0)); } break;
-            }
-#undef STBI__CASE
+            unfilter_row(cur, prior, raw, x - 1, filter, filter_bytes, output_bytes);
+            raw += (x - 1) * filter_bytes;
 
-            // the loop above sets the high byte of the pixels' alpha, but for
+            // the unfilter above sets the high byte of the pixels' alpha, but for
             // 16 bit png files we also need the low byte set. we'll do that here.
             if (depth == 16) {
                 cur = a->out + stride * j; // start at the beginning of the row again
@@ -4933,7 +5625,7 @@ static int stbi__create_png_image(stbi__png* a, stbi_uc* image_data, stbi__uint3
         if (x && y) {
             stbi__uint32 img_len = ((((a->s->img_n * x * depth) + 7) >> 3) + 1) * y;
             if (!stbi__create_png_image_raw(a, image_data, image_data_len, out_n, x, y, depth, color)) {
-                STBI_FREE(final);
+                stbi__free(final);
                 return 0;
             }
             for (j = 0; j < y; ++j) {
@@ -4944,7 +5636,7 @@ static int stbi__create_png_image(stbi__png* a, stbi_uc* image_data, stbi__uint3
                         a->out + (j * x + i) * out_bytes, out_bytes);
                 }
             }
-            STBI_FREE(a->out);
+            stbi__free(a->out);
             image_data += img_len;
             image_data_len -= img_len;
         }
@@ -5036,7 +5728,7 @@ static int stbi__expand_png_palette(stbi__png* a, stbi_uc* palette, int len, int
             p += 4;
         }
     }
-    STBI_FREE(a->out);
+    stbi__free(a->out);
     a->out = temp_out;
 
     STBI_NOTUSED(len);
@@ -5058,8 +5750,8 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert)
 }
 
 #ifndef STBI_THREAD_LOCAL
-#define stbi__unpremultiply_on_load  stbi__unpremultiply_on_load_global
-#define stbi__de_iphone_flag  stbi__de_iphone_flag_global
+#define stbi__unpremultiply_on_load_default  stbi__unpremultiply_on_load_global
+#define stbi__de_iphone_flag_default  stbi__de_iphone_flag_global
 #else
 static STBI_THREAD_LOCAL int stbi__unpremultiply_on_load_local, stbi__unpremultiply_on_load_set;
 static STBI_THREAD_LOCAL int stbi__de_iphone_flag_local, stbi__de_iphone_flag_set;
@@ -5076,14 +5768,19 @@ STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_conve
     stbi__de_iphone_flag_set = 1;
 }
 
-#define stbi__unpremultiply_on_load  (stbi__unpremultiply_on_load_set           \
-                                       ? stbi__unpremultiply_on_load_local      \
-                                       : stbi__unpremultiply_on_load_global)
-#define stbi__de_iphone_flag  (stbi__de_iphone_flag_set                         \
-                                ? stbi__de_iphone_flag_local                    \
-                                : stbi__de_iphone_flag_global)
+#define stbi__unpremultiply_on_load_default  (stbi__unpremultiply_on_load_set           \
+                                               ? stbi__unpremultiply_on_load_local      \
+                                               : stbi__unpremultiply_on_load_global)
+#define stbi__de_iphone_flag_default  (stbi__de_iphone_flag_set                         \
+                                        ? stbi__de_iphone_flag_local                    \
+                                        : stbi__de_iphone_flag_global)
 #endif // STBI_THREAD_LOCAL
 
+#define stbi__unpremultiply_on_load  (stbi__decoder ? stbi__decoder->unpremultiply \
+                                                    : stbi__unpremultiply_on_load_default)
+#define stbi__de_iphone_flag  (stbi__decoder ? stbi__decoder->convert_iphone_png_to_rgb \
+                                             : stbi__de_iphone_flag_default)
+
 static void stbi__de_iphone(stbi__png* z)
 {
     stbi__context* s = z->s;
@@ -5246,7 +5943,7 @@ static int stbi__parse_png_file(stbi__png* z, int scan, int req_comp)
                 while (ioff + c.length > idata_limit)
                     idata_limit *= 2;
                 STBI_NOTUSED(idata_limit_old);
-                p = (stbi_uc*)STBI_REALLOC_SIZED(z->idata, idata_limit_old, idata_limit); if (p == NULL) return stbi__err("outofmem", "Out of memory");
+                p = (stbi_uc*)stbi__realloc_sized(z->idata, idata_limit_old, idata_limit); if (p == NULL) return stbi__err("outofmem", "Out of memory");
                 z->idata = p;
             }
             if (!stbi__getn(s, z->idata + ioff, c.length)) return stbi__err("outofdata", "Corrupt PNG");
@@ -5262,9 +5959,24 @@ static int stbi__parse_png_file(stbi__png* z, int scan, int req_comp)
             // initial guess for decoded data size to avoid unnecessary reallocs
             bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
             raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
+            if (interlace) {
+                // the exact size : every adam7 pass has its own rows, with a filter byte each
+                int p;
+                raw_len = 0;
+                for (p = 0; p < 7; ++p) {
+                    static const int xorig[] = { 0,4,0,2,0,1,0 };
+                    static const int yorig[] = { 0,0,4,0,2,0,1 };
+                    static const int xspc[] = { 8,8,4,4,2,2,1 };
+                    static const int yspc[] = { 8,8,8,4,4,2,2 };
+                    stbi__uint32 x = (s->img_x - xorig[p] + xspc[p] - 1) / xspc[p];
+                    stbi__uint32 y = (s->img_y - yorig[p] + yspc[p] - 1) / yspc[p];
+                    if (x && y)
+                        raw_len += ((((s->img_n * x * z->depth) + 7) >> 3) + 1) * y;
+                }
+            }
             z->expanded = (stbi_uc*)stbi_zlib_decode_malloc_guesssize_headerflag((char*)z->idata, ioff, raw_len, (int*)&raw_len, !is_iphone);
             if (z->expanded == NULL) return 0; // zlib should set error
-            STBI_FREE(z->idata); z->idata = NULL;
+            stbi__free(z->idata); z->idata = NULL;
             if ((req_comp == s->img_n + 1 && req_comp != 3 && !pal_img_n) || has_trans)
                 s->img_out_n = s->img_n + 1;
             else
@@ -5292,7 +6004,7 @@ static int stbi__parse_png_file(stbi__png* z, int scan, int req_comp)
                 // non-paletted image with tRNS -> source image has (constant) alpha
                 ++s->img_n;
             }
-            STBI_FREE(z->expanded); z->expanded = NULL;
+            stbi__free(z->expanded); z->expanded = NULL;
             // end of PNG chunk, read and skip CRC
             stbi__get32be(s);
             return 1;
@@ -5303,8 +6015,17 @@ static int stbi__parse_png_file(stbi__png* z, int scan, int req_comp)
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if ((c.type & (1 << 29)) == 0) {
 #ifndef STBI_NO_FAILURE_STRINGS
-                // not threadsafe
-                static char invalid_chunk[] = "XXXX PNG chunk not known";
+                // in the decoder's buffer, or per thread : not threadsafe without thread-locals
+                static
+#ifdef STBI_THREAD_LOCAL
+                STBI_THREAD_LOCAL
+#endif
+                char invalid_chunk_local[] = "XXXX PNG chunk not known";
+                char* invalid_chunk = invalid_chunk_local;
+                if (stbi__decoder) {
+                    invalid_chunk = stbi__decoder->failure_buffer;
+                    memcpy(invalid_chunk, invalid_chunk_local, sizeof(invalid_chunk_local));
+                }
                 invalid_chunk[0] = STBI__BYTECAST(c.type >> 24);
                 invalid_chunk[1] = STBI__BYTECAST(c.type >> 16);
                 invalid_chunk[2] = STBI__BYTECAST(c.type >> 8);
@@ -5345,9 +6066,9 @@ static void* stbi__do_png(stbi__png* p, int* x, int* y, int* n, int req_comp, st
         *y = p->s->img_y;
         if (n) *n = p->s->img_n;
     }
-    STBI_FREE(p->out);      p->out = NULL;
-    STBI_FREE(p->expanded); p->expanded = NULL;
-    STBI_FREE(p->idata);    p->idata = NULL;
+    stbi__free(p->out);      p->out = NULL;
+    stbi__free(p->expanded); p->expanded = NULL;
+    stbi__free(p->idata);    p->idata = NULL;
 
     return result;
 }
@@ -5666,7 +6387,7 @@ static void* stbi__bmp_load(stbi__context* s, int* x, int* y, int* comp, int req
     if (!out) return stbi__errpuc("outofmem", "Out of memory");
     if (info.bpp < 16) {
         int z = 0;
-        if (psize == 0 || psize > 256) { STBI_FREE(out); return stbi__errpuc("invalid", "Corrupt BMP"); }
+        if (psize == 0 || psize > 256) { stbi__free(out); return stbi__errpuc("invalid", "Corrupt BMP"); }
         for (i = 0; i < psize; ++i) {
             pal[i][2] = stbi__get8(s);
             pal[i][1] = stbi__get8(s);
@@ -5678,7 +6399,7 @@ static void* stbi__bmp_load(stbi__context* s, int* x, int* y, int* comp, int req
         if (info.bpp == 1) width = (s->img_x + 7) >> 3;
         else if (info.bpp == 4) width = (s->img_x + 1) >> 1;
         else if (info.bpp == 8) width = s->img_x;
-        else { STBI_FREE(out); return stbi__errpuc("bad bpp", "Corrupt BMP"); }
+        else { stbi__free(out); return stbi__errpuc("bad bpp", "Corrupt BMP"); }
         pad = (-width) & 3;
         if (info.bpp == 1) {
             for (j = 0; j < (int)s->img_y; ++j) {
@@ -5738,13 +6459,13 @@ static void* stbi__bmp_load(stbi__context* s, int* x, int* y, int* comp, int req
                 easy = 2;
         }
         if (!easy) {
-            if (!mr || !mg || !mb) { STBI_FREE(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
+            if (!mr || !mg || !mb) { stbi__free(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
             // right shift amt to put high bit in position #7
             rshift = stbi__high_bit(mr) - 7; rcount = stbi__bitcount(mr);
             gshift = stbi__high_bit(mg) - 7; gcount = stbi__bitcount(mg);
             bshift = stbi__high_bit(mb) - 7; bcount = stbi__bitcount(mb);
             ashift = stbi__high_bit(ma) - 7; acount = stbi__bitcount(ma);
-            if (rcount > 8 || gcount > 8 || bcount > 8 || acount > 8) { STBI_FREE(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
+            if (rcount > 8 || gcount > 8 || bcount > 8 || acount > 8) { stbi__free(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
         }
         for (j = 0; j < (int)s->img_y; ++j) {
             if (easy) {
@@ -6017,7 +6738,7 @@ static void* stbi__tga_load(stbi__context* s, int* x, int* y, int* comp, int req
         if (tga_indexed)
         {
             if (tga_palette_len == 0) {  /* you have to have at least one entry! */
-                STBI_FREE(tga_data);
+                stbi__free(tga_data);
                 return stbi__errpuc("bad palette", "Corrupt TGA");
             }
 
@@ -6026,7 +6747,7 @@ static void* stbi__tga_load(stbi__context* s, int* x, int* y, int* comp, int req
             //   load the palette
             tga_palette = (unsigned char*)stbi__malloc_mad2(tga_palette_len, tga_comp, 0);
             if (!tga_palette) {
-                STBI_FREE(tga_data);
+                stbi__free(tga_data);
                 return stbi__errpuc("outofmem", "Out of memory");
             }
             if (tga_rgb16) {
@@ -6038,8 +6759,8 @@ static void* stbi__tga_load(stbi__context* s, int* x, int* y, int* comp, int req
                 }
             }
             else if (!stbi__getn(s, tga_palette, tga_palette_len * tga_comp)) {
-                STBI_FREE(tga_data);
-                STBI_FREE(tga_palette);
+                stbi__free(tga_data);
+                stbi__free(tga_palette);
                 return stbi__errpuc("bad palette", "Corrupt TGA");
             }
         }
@@ -6124,7 +6845,7 @@ static void* stbi__tga_load(stbi__context* s, int* x, int* y, int* comp, int req
         //   clear my palette, if I had one
         if (tga_palette != NULL)
         {
-            STBI_FREE(tga_palette);
+            stbi__free(tga_palette);
         }
     }
 
@@ -6320,7 +7041,7 @@ static void* stbi__psd_load(stbi__context* s, int* x, int* y, int* comp, int req
             else {
                 // Read the RLE data.
                 if (!stbi__psd_decode_rle(s, p, pixelCount)) {
-                    STBI_FREE(out);
+                    stbi__free(out);
                     return stbi__errpuc("corrupt", "bad RLE data");
                 }
             }
@@ -6619,7 +7340,7 @@ static void* stbi__pic_load(stbi__context* s, int* px, int* py, int* comp, int r
     memset(result, 0xff, x * y * 4);
 
     if (!stbi__pic_load_core(s, x, y, comp, result)) {
-        STBI_FREE(result);
+        stbi__free(result);
         result = 0;
     }
     *px = x;
@@ -6733,13 +7454,13 @@ static int stbi__gif_info_raw(stbi__context* s, int* x, int* y, int* comp)
     stbi__gif* g = (stbi__gif*)stbi__malloc(sizeof(stbi__gif));
     if (!g) return stbi__err("outofmem", "Out of memory");
     if (!stbi__gif_header(s, g, comp, 1)) {
-        STBI_FREE(g);
+        stbi__free(g);
         stbi__rewind(s);
         return 0;
     }
     if (x) *x = g->w;
     if (y) *y = g->h;
-    STBI_FREE(g);
+    stbi__free(g);
     return 1;
 }
 
@@ -7056,12 +7777,12 @@ static stbi_uc* stbi__gif_load_next(stbi__context* s, stbi__gif* g, int* comp, i
 
 static void* stbi__load_gif_main_outofmem(stbi__gif* g, stbi_uc* out, int** delays)
 {
-    STBI_FREE(g->out);
-    STBI_FREE(g->history);
-    STBI_FREE(g->background);
+    stbi__free(g->out);
+    stbi__free(g->history);
+    stbi__free(g->background);
 
-    if (out) STBI_FREE(out);
-    if (delays && *delays) STBI_FREE(*delays);
+    if (out) stbi__free(out);
+    if (delays && *delays) stbi__free(*delays);
     return stbi__errpuc("outofmem", "Out of memory");
 }
 
@@ -7096,7 +7817,7 @@ static void* stbi__load_gif_main(stbi__context* s, int** delays, int* x, int* y,
                 stride = g.w * g.h * 4;
 
                 if (out) {
-                    void* tmp = (stbi_uc*)STBI_REALLOC_SIZED(out, out_size, layers * stride);
+                    void* tmp = (stbi_uc*)stbi__realloc_sized(out, out_size, layers * stride);
                     if (!tmp)
                         return stbi__load_gif_main_outofmem(&g, out, delays);
                     else {
@@ -7105,7 +7826,7 @@ static void* stbi__load_gif_main(stbi__context* s, int** delays, int* x, int* y,
                     }
 
                     if (delays) {
-                        int* new_delays = (int*)STBI_REALLOC_SIZED(*delays, delays_size, sizeof(int) * layers);
+                        int* new_delays = (int*)stbi__realloc_sized(*delays, delays_size, sizeof(int) * layers);
                         if (!new_delays)
                             return stbi__load_gif_main_outofmem(&g, out, delays);
                         *delays = new_delays;
@@ -7136,9 +7857,9 @@ static void* stbi__load_gif_main(stbi__context* s, int** delays, int* x, int* y,
         } while (u != 0);
 
         // free temp buffer;
-        STBI_FREE(g.out);
-        STBI_FREE(g.history);
-        STBI_FREE(g.background);
+        stbi__free(g.out);
+        stbi__free(g.history);
+        stbi__free(g.background);
 
         // do the final conversion after loading everything;
         if (req_comp && req_comp != 4)
@@ -7172,12 +7893,12 @@ static void* stbi__gif_load(stbi__context* s, int* x, int* y, int* comp, int req
     }
     else if (g.out) {
         // if there was an error and we allocated an image buffer, free it!
-        STBI_FREE(g.out);
+        stbi__free(g.out);
     }
 
     // free buffers needed for multiple frame loading;
-    STBI_FREE(g.history);
-    STBI_FREE(g.background);
+    stbi__free(g.history);
+    stbi__free(g.background);
 
     return u;
 }
@@ -7352,16 +8073,16 @@ static float* stbi__hdr_load(stbi__context* s, int* x, int* y, int* comp, int re
                 stbi__hdr_convert(hdr_data, rgbe, req_comp);
                 i = 1;
                 j = 0;
-                STBI_FREE(scanline);
+                stbi__free(scanline);
                 goto main_decode_loop; // yes, this makes no sense
             }
             len <<= 8;
             len |= stbi__get8(s);
-            if (len != width) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("invalid decoded scanline length", "corrupt HDR"); }
+            if (len != width) { stbi__free(hdr_data); stbi__free(scanline); return stbi__errpf("invalid decoded scanline length", "corrupt HDR"); }
             if (scanline == NULL) {
                 scanline = (stbi_uc*)stbi__malloc_mad2(width, 4, 0);
                 if (!scanline) {
-                    STBI_FREE(hdr_data);
+                    stbi__free(hdr_data);
                     return stbi__errpf("outofmem", "Out of memory");
                 }
             }
@@ -7375,13 +8096,13 @@ static float* stbi__hdr_load(stbi__context* s, int* x, int* y, int* comp, int re
                         // Run
                         value = stbi__get8(s);
                         count -= 128;
-                        if ((count == 0) || (count > nleft)) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
+                        if ((count == 0) || (count > nleft)) { stbi__free(hdr_data); stbi__free(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
                         for (z = 0; z < count; ++z)
                             scanline[i++ * 4 + k] = value;
                     }
                     else {
                         // Dump
-                        if ((count == 0) || (count > nleft)) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
+                        if ((count == 0) || (count > nleft)) { stbi__free(hdr_data); stbi__free(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
                         for (z = 0; z < count; ++z)
                             scanline[i++ * 4 + k] = stbi__get8(s);
                     }
@@ -7391,7 +8112,7 @@ static float* stbi__hdr_load(stbi__context* s, int* x, int* y, int* comp, int re
                 stbi__hdr_convert(hdr_data + (j * width + i) * req_comp, scanline + i * 4, req_comp);
         }
         if (scanline)
-            STBI_FREE(scanline);
+            stbi__free(scanline);
     }
 
     return hdr_data;
@@ -7636,7 +8357,7 @@ static void* stbi__pnm_load(stbi__context* s, int* x, int* y, int* comp, int req
     out = (stbi_uc*)stbi__malloc_mad4(s->img_n, s->img_x, s->img_y, ri->bits_per_channel / 8, 0);
     if (!out) return stbi__errpuc("outofmem", "Out of memory");
     if (!stbi__getn(s, out, s->img_n * s->img_x * s->img_y * (ri->bits_per_channel / 8))) {
-        STBI_FREE(out);
+        stbi__free(out);
         return stbi__errpuc("bad PNM", "PNM file truncated");
     }
 